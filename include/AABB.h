@@ -2,7 +2,7 @@
 #define __AABB_H__
 
 #include <Structures.h>
-#include <Triangle.h>
+#include <cfloat>
 
 class AABB
 {
@@ -10,18 +10,18 @@ private:
 
 public:
 
-    float xmin;
-    float ymin;
-    float zmin;
-    float xmax;
-    float ymax;
-    float zmax;
-
+    // bounds[0] holds the minimum corner, bounds[1] the maximum corner
     glm::vec3 bounds[2];
-    
-    AABB(const std::vector<Triangle>& triangleList);
-    bool Intersect(const Ray& r);
-    bool Intersect2(const Ray& r, float t0, float t1);
+
+    AABB();
+
+    void Extend(const glm::vec3& point);
+    void Extend(const AABB& box);
+
+    float SurfaceArea() const;
+
+    bool Intersect(const Ray& r) const;
+    bool Intersect2(const Ray& r, float t0, float t1) const;
 };
 
 
@@ -2,64 +2,62 @@
 #define __BVH_H__
 
 #include <AABB.h>
+#include <BVHNodeBuilder.h>
+#include <SBVHBuilder.h>
+#include <BVHStats.h>
+#include <TraversalStats.h>
 #include <Structures.h>
+#include <MeshGeometry.h>
+#include <WideBVH.h>
+#include <TriangleBlock.h>
+#include <RayPacket.h>
 #include <vector>
-#include <Triangle.h>
+#include <chrono>
 
-struct VertexIndex
+// Per-mesh BVH, leaves hold face indices into the shared mesh geometry. With
+// spatial splits a face may be referenced from several leaves.
+class BVH
 {
-    alignas(16) glm::vec3 vertex;
-    int index;
-};
+private:
+    const MeshGeometry* geometry;
+    BVHSettings settings;
+    int width;
+    WideBVH<4> wideBVH4;
+    WideBVH<8> wideBVH8;
 
-struct SplittedTriangles
-{
-    std::vector<Triangle> p1;
-    std::vector<Triangle> p2;
-};
+    // Leaf triangles packed into SIMD blocks, a leaf starting at primitive
+    // offset i owns the blocks from leafBlockOffsets[i] on
+    std::vector<TriangleBlock> triangleBlocks;
+    std::vector<int> leafBlockOffsets;
 
-// Comparator functions
-struct CompareX
-{
-    inline bool operator() (const VertexIndex& lhs, const VertexIndex& rhs) const
-    {
-        return lhs.vertex.x < rhs.vertex.x;
-    }
-};
+    void buildTriangleBlocks();
+    void buildTraversalData();
+    void intersectLeaf(int offset, int count, const Ray& ray, const WatertightRay& watertightRay, float tmin, float& closest, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling, TriangleHit& hit) const;
+    bool occludedLeaf(int offset, int count, const Ray& ray, const WatertightRay& watertightRay, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const;
 
-struct CompareY
-{
-    inline bool operator() (const VertexIndex& lhs, const VertexIndex& rhs) const
-    {
-        return lhs.vertex.y < rhs.vertex.y;
-    }
-};
-
-struct CompareZ
-{
-    inline bool operator() (const VertexIndex& lhs, const VertexIndex& rhs) const
-    {
-        return lhs.vertex.z < rhs.vertex.z;
-    }
-};
+    template<int N>
+    bool intersectWide(const WideBVH<N>& wideBVH, const Ray& ray, TriangleHit& hit, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const;
+    template<int N>
+    bool occludedWide(const WideBVH<N>& wideBVH, const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const;
+public:
+    std::vector<BVHNode> nodes;
+    std::vector<int> primitiveIndices;
+    double buildTime;   // milliseconds
 
-class BVH
-{
-private:
-    AABB box;
-    BVH* leftChild;
-    BVH* rightChild;
-    std::vector<Triangle> primitives;
+    BVH(const MeshGeometry* geometry, const BVHSettings& settings);
+    // Takes over a binary tree built earlier, e.g. one read from the BVH cache
+    BVH(const MeshGeometry* geometry, const BVHSettings& settings, std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices);
 
-    int splitAxis;
+    AABB Bounds() const;
+    BVHStats Stats() const;
 
-    SplittedTriangles splitMidpoint(const std::vector<Triangle>& triangleList);
-    SplittedTriangles splitMidpoint(const std::vector<Triangle>& triangleList, int axis);
-public:
-    BVH(const std::vector<Triangle>& triangleList, int depth, int maxdepth);
-    BVH(const std::vector<Triangle>& triangleList, int depth, int maxdepth, int axis);
-    
-    bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, const glm::mat4& transformationMatrixTransposed, bool backfaceCulling);
+    // Closest hit face, shading data is left to MeshGeometry::ComputeHit
+    bool Intersect(const Ray& ray, TriangleHit& hit, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const;
+    // Closest hit faces of the packet rays from first on, hits[i] is set for
+    // rays that hit closer than both tmax and their record in the packet.
+    // Incoherent packets and wide trees are traced one ray at a time.
+    void IntersectPacket(const RayPacket& packet, int first, TriangleHit* hits, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const;
+    bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const;
 };
 
 
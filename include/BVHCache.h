@@ -0,0 +1,47 @@
+#ifndef __BVH_CACHE_H__
+#define __BVH_CACHE_H__
+
+#include <BVHNodeBuilder.h>
+#include <MeshGeometry.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Bumped whenever the layout of a cache entry or of its arrays changes, or a
+// builder makes a different tree from the same input
+const uint32_t BVH_CACHE_VERSION = 2;
+const uint64_t BVH_CACHE_HASH_SEED = 0xcbf29ce484222325ull;
+
+// A cache entry is this header followed by the vertex positions, normals and
+// texture coordinates, the faces and face normals, the BVH nodes and the
+// primitive indices, all stored as raw arrays
+struct BVHCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t vertexCount;
+    uint64_t faceCount;
+    uint64_t nodeCount;
+    uint64_t indexCount;
+};
+
+// 64-bit FNV-1a style hash, consumed a word at a time
+uint64_t BVHCacheHash(const void* data, size_t size, uint64_t hash = BVH_CACHE_HASH_SEED);
+// Hash of a file's contents, 0 when it cannot be read
+uint64_t BVHCacheFileHash(const std::string& path);
+uint64_t BVHCacheGeometryHash(const MeshGeometry& geometry);
+
+// Combines the source hash with every setting that changes the binary tree.
+// Traversal width and thread count are not part of the key.
+uint64_t BVHCacheKey(uint64_t sourceHash, const BVHSettings& settings);
+std::string BVHCachePath(const std::string& directory, uint64_t key);
+
+// Maps the entry into memory and copies its arrays out. Returns false when
+// the entry is missing, from another version or inconsistent.
+bool BVHCacheLoad(const std::string& path, uint64_t key, MeshGeometry& geometry, std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices);
+// Writes the entry through a temporary file, so readers never see a partial one
+void BVHCacheStore(const std::string& path, uint64_t key, const MeshGeometry& geometry, const std::vector<BVHNode>& nodes, const std::vector<int>& primitiveIndices);
+
+
+#endif
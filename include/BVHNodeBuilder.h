@@ -0,0 +1,137 @@
+#ifndef __BVH_NODE_BUILDER_H__
+#define __BVH_NODE_BUILDER_H__
+
+#include <AABB.h>
+#include <Structures.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <ThreadPool.h>
+
+// Flattened BVH node, stored depth-first so the left child of an interior
+// node always follows it directly in the node array.
+struct BVHNode
+{
+    AABB box;
+    union
+    {
+        int primitiveOffset;    // leaf: first entry in primitiveIndices
+        int secondChildOffset;  // interior: index of the right child
+    };
+    uint16_t primitiveCount;    // 0 for interior nodes
+    uint8_t axis;
+    uint8_t pad;
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode should occupy 32 bytes");
+
+// Traversal stacks are fixed size, the builder keeps trees shallower than this
+const int BVH_STACK_SIZE = 256;
+
+// Subtrees with at least this many primitives are built on their own task
+const int BVH_PARALLEL_BUILD_THRESHOLD = 4096;
+// Centroid binning is split over tasks for ranges with at least this many primitives
+const int BVH_PARALLEL_BINNING_THRESHOLD = 65536;
+
+enum BVHBuilder
+{
+    MIDPOINT   = 0,
+    BINNED_SAH = 1,
+    LBVH       = 2,
+    SBVH       = 3
+};
+
+struct BVHSettings
+{
+    BVHBuilder builder = BVHBuilder::BINNED_SAH;
+
+    // Binned SAH parameters, leafCost is the cost of one primitive test
+    // relative to traversalCost for visiting a node
+    int binCount          = 16;
+    float traversalCost   = 1.0f;
+    float leafCost        = 4.0f;
+    int maxLeafSize       = 4;
+
+    int maxDepth = 200;
+
+    // Tasks large ranges are split into during construction, 0 matches the
+    // size of the pool. Without a pool the build runs on the calling thread.
+    int buildThreads = 0;
+    ThreadPool* pool = nullptr;
+
+    // Linear BVH parameters. Morton codes use 30 or 63 bits, treelets of up
+    // to treeletSize leaves are restructured afterwards, 0 disables it.
+    int mortonBits  = 63;
+    int treeletSize = 0;
+
+    // Spatial split BVH parameters. Spatial splits are tried where the object
+    // split children overlap by more than spatialSplitAlpha of the root area,
+    // until the references grow by duplicationBudget times the triangle count.
+    float spatialSplitAlpha = 1e-5f;
+    float duplicationBudget = 0.3f;
+
+    // Mesh geometry and BVHs are cached on disk and reused while the source
+    // data and the settings above stay the same
+    bool cache = false;
+    std::string cacheDirectory;
+
+    // Mesh leaves use the watertight triangle test instead of the epsilon
+    // tolerant one. Only traversal changes, the tree is the same.
+    bool watertight = false;
+
+    // Static meshes and triangles are moved to world space while loading and
+    // traced without a model transform. Instanced meshes, moving objects and
+    // light meshes keep theirs.
+    bool bakeTransforms = false;
+
+    // Branching factor used for traversal. 4 and 8 collapse the binary tree
+    // into a wide BVH whose child boxes are tested with SIMD.
+    int width = 2;
+};
+
+// Number of tasks a build with these settings splits work into
+int BVHBuildThreadCount(const BVHSettings& settings);
+
+// Recursion depth down to which subtrees are built on their own tasks. A few
+// more tasks than threads keep every core busy when splits are uneven.
+int BVHParallelDepth(int threadCount);
+
+struct BVHBin
+{
+    AABB box;
+    int count = 0;
+};
+
+// Builds the flattened node array over a set of primitive bounds. Primitives
+// are only referenced through their index, so the same builder serves the
+// per-mesh triangle BVH and the top-level BVH over scene objects.
+// Large subtrees are built in parallel, each task partitions its own range of
+// primitiveIndices in place and the result matches a serial build.
+class BVHNodeBuilder
+{
+private:
+    const std::vector<AABB>& primitiveBounds;
+    const std::vector<glm::vec3>& centroids;
+    BVHSettings settings;
+
+    std::vector<BVHNode>& nodes;
+    std::vector<int>& primitiveIndices;
+
+    int threadCount;
+    int parallelDepth;
+
+    void computeBounds(AABB& box, int start, int end) const;
+    void binPrimitives(const AABB& centroidBox, int start, int end, std::vector<BVHBin>& bins) const;
+    int splitMidpoint(const AABB& box, int start, int end, int& axis);
+    int splitBinnedSAH(const AABB& box, int start, int end, int& axis);
+    void build(int start, int end, int depth, std::vector<BVHNode>& out);
+
+public:
+    BVHNodeBuilder(const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids, const BVHSettings& settings,
+                   std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices);
+
+    void Build();
+};
+
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __BVH_STATS_H__
+#define __BVH_STATS_H__
+
+#include <BVHNodeBuilder.h>
+#include <vector>
+#include <string>
+#include <ostream>
+
+// Quality and size figures of a binary BVH, or totals over several of them
+struct BVHStats
+{
+    size_t nodeCount      = 0;
+    size_t leafCount      = 0;
+    size_t primitiveCount = 0;      // triangles or scene objects
+    size_t referenceCount = 0;      // leaf entries, more than primitives with spatial splits
+
+    int maxDepth = 0;
+    double averageLeafDepth = 0.0;
+    double averageLeafSize  = 0.0;
+    std::vector<size_t> leafSizeHistogram;  // number of leaves holding i primitives
+
+    // Leaves above MaxLeafSize and leaves cut off at MaxDepth, both mark
+    // ranges the builder could not split
+    size_t oversizedLeafCount = 0;
+    size_t depthLimitLeafCount = 0;
+
+    // Surface area heuristic cost relative to the root box area
+    double sahCost = 0.0;
+    // Mean share of an interior node's volume outside both children, and
+    // inside both of them
+    double emptySpaceRatio = 0.0;
+    double overlapRatio    = 0.0;
+
+    size_t memoryBytes = 0;
+
+    // Accumulates scene totals, ratios become means weighted by node count
+    // and the SAH cost a mean weighted by primitive count
+    void Add(const BVHStats& other);
+
+    void Print(std::ostream& stream, const std::string& name) const;
+    void WriteJSON(std::ostream& stream) const;
+};
+
+BVHStats ComputeBVHStats(const std::vector<BVHNode>& nodes, size_t primitiveCount, size_t referenceCount, const BVHSettings& settings);
+
+
+#endif
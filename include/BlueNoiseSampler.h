@@ -0,0 +1,28 @@
+#ifndef __BLUE_NOISE_SAMPLER_H__
+#define __BLUE_NOISE_SAMPLER_H__
+
+#include <Sampler.h>
+#include <vector>
+
+const int BLUE_NOISE_MASK_SIZE = 64;
+
+// Every pixel takes the same scrambled Sobol sequence, toroidally shifted by
+// a blue noise mask tiled over the image. Neighbouring pixels get shifts far
+// apart, so what error is left spreads as high frequency noise. Each
+// dimension reads the mask at its own offset.
+class BlueNoiseSampler : public Sampler
+{
+private:
+    std::vector<float> mask;
+
+    // Void and cluster ranking of the mask pixels
+    void generateMask();
+
+public:
+    BlueNoiseSampler();
+
+    virtual float Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const;
+};
+
+
+#endif
@@ -27,8 +27,8 @@ public:
     // Directions similar to normal are more likely to be generated
     glm::vec3 importanceSample(glm::vec3 normal)
     {
-        float randomNumber1 = randomGenerator->Generate();
-        float randomNumber2 = randomGenerator->Generate();
+        float randomNumber1, randomNumber2;
+        randomGenerator->Generate2D(randomNumber1, randomNumber2);
 
         OrthonormalBasis basis = GiveOrthonormalBasis(normal);
         
@@ -45,8 +45,8 @@ public:
     // Every direction on the hemisphere has equal probability
     glm::vec3 uniformSample(glm::vec3 normal)
     {
-        float randomNumber1 = randomGenerator->Generate();
-        float randomNumber2 = randomGenerator->Generate();
+        float randomNumber1, randomNumber2;
+        randomGenerator->Generate2D(randomNumber1, randomNumber2);
 
         OrthonormalBasis basis = GiveOrthonormalBasis(normal);
         
@@ -11,12 +11,12 @@ public:
 
     bool ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                const IntersectionReport& report, bool backfaceCulling,
-                               float time, std::vector<Object *>& objectPointerVector);
+                               float time, TopLevelBVH& topLevelBVH) const;
 
     glm::vec3 ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                      const float& phongExponent, const IntersectionReport& report,
                                      float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                     bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex);
+                                     bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const;
 };
 
 #endif
\ No newline at end of file
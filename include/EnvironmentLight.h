@@ -8,22 +8,21 @@
 class EnvironmentLight : public Light
 {
 private:
-    void RejectionSampling(glm::vec3 normal);
+    glm::vec3 RejectionSampling(glm::vec3 normal) const;
 public:
     Texture hdrTexture;
     RandomGenerator* randomNumberGenerator;
-    glm::vec3 randomDirection;
 
     EnvironmentLight();
 
-    bool ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
+    bool ShadowRayIntersection(const glm::vec3& direction, float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                const IntersectionReport& report, bool backfaceCulling,
-                               float time, std::vector<Object *>& objectPointerVector);
+                               float time, TopLevelBVH& topLevelBVH) const;
 
     glm::vec3 ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                      const float& phongExponent, const IntersectionReport& report,
                                      float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                     bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex);     
+                                     bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const;     
 
 };
 
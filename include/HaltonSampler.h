@@ -0,0 +1,27 @@
+#ifndef __HALTON_SAMPLER_H__
+#define __HALTON_SAMPLER_H__
+
+#include <Sampler.h>
+#include <vector>
+
+const int HALTON_PRIME_COUNT = 256;
+
+// Radical inverse of the sample index in the dimension-th prime base with
+// nested (Owen) scrambling. Every digit goes through a permutation hashed from
+// the pixel, the dimension and the digits before it, which decorrelates the
+// pixels and the higher bases. Dimensions past the prime table reuse the
+// bases under other permutations.
+class HaltonSampler : public Sampler
+{
+private:
+    std::vector<uint32_t> primes;
+    std::vector<int> digitCounts;   // digits needed for 24 bits of precision
+
+public:
+    HaltonSampler();
+
+    virtual float Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const;
+};
+
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef __INTERSECTION_BENCHMARK_H__
+#define __INTERSECTION_BENCHMARK_H__
+
+#include <ostream>
+
+// Times the previous determinant based triangle test against the
+// precomputed and watertight ones, scalar and in triangle blocks, then counts
+// the rays that slip through shared edges of a closed grid of triangles
+void RunIntersectionBenchmark(std::ostream& stream);
+
+
+#endif
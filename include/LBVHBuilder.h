@@ -0,0 +1,59 @@
+#ifndef __LBVH_BUILDER_H__
+#define __LBVH_BUILDER_H__
+
+#include <BVHNodeBuilder.h>
+#include <vector>
+#include <cstdint>
+
+// Node of the intermediate pointer tree, children index the same array
+struct LBVHNode
+{
+    AABB box;
+    int child[2] = {-1, -1};    // -1 for leaves
+    int start = 0;              // leaf: first entry in primitiveIndices
+    int count = 0;              // primitives in the subtree
+    float cost = 0.0f;          // surface area heuristic cost of the subtree
+};
+
+// Linear BVH builder. Primitives are sorted along a Morton curve over their
+// centroids with a parallel radix sort and the hierarchy is emitted top-down
+// by splitting sorted ranges at the highest differing code bit, which is much
+// faster than binning but gives worse trees. Small treelets can afterwards be
+// restructured for the lowest surface area heuristic cost to recover quality,
+// subtrees are collapsed into leaves wherever that is cheaper.
+class LBVHBuilder
+{
+private:
+    const std::vector<AABB>& primitiveBounds;
+    const std::vector<glm::vec3>& centroids;
+    BVHSettings settings;
+
+    std::vector<BVHNode>& nodes;
+    std::vector<int>& primitiveIndices;
+
+    int threadCount;
+    int parallelDepth;
+
+    std::vector<uint64_t> mortonCodes;
+    std::vector<LBVHNode> tree;
+
+    float leafCost(int count, const AABB& box) const;
+    void computeMortonCodes();
+    void sortMortonCodes();
+    int emit(int start, int end, int bit, int depth, std::vector<LBVHNode>& out);
+    void emitTree();
+    void restructure(int nodeIndex, int depth);
+    void restructureTreelet(int root);
+    int treeDepth(int nodeIndex) const;
+    void gatherPrimitives(int nodeIndex, std::vector<int>& out) const;
+    void flatten(int nodeIndex, std::vector<int>& orderedIndices);
+
+public:
+    LBVHBuilder(const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids, const BVHSettings& settings,
+                std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices);
+
+    void Build();
+};
+
+
+#endif
@@ -3,22 +3,21 @@
 
 #include <Structures.h>
 #include <Object.h>
+#include <TopLevelBVH.h>
 
 class Light
 {
 public:
 
-    virtual bool ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
-                                       const IntersectionReport& report, bool backfaceCulling,
-                                       float time, std::vector<Object *>& objectPointerVector) = 0;
-    
+    // Every render thread shades with the same lights, so a light keeps
+    // the position or direction it samples local to the call
     virtual glm::vec3 ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                              const float& phongExponent, const IntersectionReport& report,
                                              float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                             bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) = 0;
+                                             bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const = 0;
 
     glm::vec3 computeF(const Ray& ray, glm::vec3& wi, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance, const float& phongExponent, const IntersectionReport& report,
-                   bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                   bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
     {
 
         glm::vec3 result(0.0);
@@ -106,7 +105,7 @@ public:
         return result;
     }                   
 
-    int ApplyTextures(const IntersectionReport& report, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance)
+    int ApplyTextures(const IntersectionReport& report, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance) const
     {
             if(report.diffuseActive)
             {
@@ -13,27 +13,33 @@ class LightMesh : public Light , public Mesh
 public:
     glm::vec3 radiance;
     float totalArea;
-    std::vector<Triangle> triangleList;
+    std::vector<int> facesByArea;
     RandomGenerator* randomGenerator;
-    glm::vec3 randomPosition;
-    glm::vec3 randomNormal;
 
-    LightMesh(const std::vector<Triangle>& triangleList, size_t materialId, bool softShadingFlag);
+    LightMesh(MeshGeometry* geometry, BVH* bvh, size_t materialId, bool softShadingFlag);
     ~LightMesh();
 
 
-    bool ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
+    bool ShadowRayIntersection(const glm::vec3& lightPosition, float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                        const IntersectionReport& report, bool backfaceCulling,
-                                       float time, std::vector<Object *>& objectPointerVector);
+                                       float time, TopLevelBVH& topLevelBVH) const;
 
     glm::vec3  ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                      const float& phongExponent, const IntersectionReport& report,
                                      float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                     bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex);                                       
+                                     bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const;                                       
 
-    void SampleRandomPosition(const Ray& ray, const IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    // World space point and face normal on the light, triangles are picked by area
+    void SampleRandomPosition(const Ray& ray, glm::vec3& position, glm::vec3& normal) const;
 
-    bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    bool Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    // Normal and texture coordinates only, lights are not textured
+    void ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report);
+
+    bool IsLight() const
+    {
+        return true;
+    }
 };
 
 #endif
\ No newline at end of file
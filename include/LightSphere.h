@@ -12,27 +12,33 @@ class LightSphere : public Light, public Sphere
 public:
     glm::vec3 radiance;
     RandomGenerator* randomGenerator;
-    glm::vec3 randomPosition;
-    float cosThetaMax;
 
     LightSphere(glm::vec3 center, float radius, size_t materialId);
     ~LightSphere();
 
 
-    bool ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
+    bool ShadowRayIntersection(const glm::vec3& lightPosition, float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                        const IntersectionReport& report, bool backfaceCulling,
-                                       float time, std::vector<Object *>& objectPointerVector);
+                                       float time, TopLevelBVH& topLevelBVH) const;
 
     glm::vec3  ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                      const float& phongExponent, const IntersectionReport& report,
                                      float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                     bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex);                                       
+                                     bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const;                                       
 
-    bool SampleRandomPosition(const Ray& ray, const IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    // Point on the part of the sphere visible from the shading point, false
+    // when the sampled direction misses it
+    bool SampleRandomPosition(const Ray& ray, const IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, glm::vec3& position) const;
 
-    bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    // Radiance, normal and texture coordinates, lights are not textured
+    void ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report);
 
-    OrthonormalBasis GiveOrthonormalBasis(glm::vec3 direction);
+    bool IsLight() const
+    {
+        return true;
+    }
+
+    OrthonormalBasis GiveOrthonormalBasis(glm::vec3 direction) const;
 };
 
 #endif
\ No newline at end of file
@@ -2,8 +2,8 @@
 #define __MESH_H__
 
 #include <BVH.h>
+#include <MeshGeometry.h>
 #include <vector>
-#include <Triangle.h>
 #include <Structures.h>
 #include <Object.h>
 
@@ -12,10 +12,15 @@ class Mesh : public Object
 private:
 
 public:
+    MeshGeometry* geometry;
     BVH* bvhRoot;
     bool softShadingFlag;
-    Mesh(const std::vector<Triangle>& triangleList, size_t materialId, bool softShadingFlag);
-    virtual bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    Mesh(MeshGeometry* geometry, BVH* bvh, size_t materialId, bool softShadingFlag);
+    virtual bool Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    virtual void IntersectPacket(RayPacket& packet, int first, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    virtual void ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report);
+    virtual bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    virtual AABB WorldBounds();
 };
 
 
@@ -0,0 +1,42 @@
+#ifndef __MESH_GEOMETRY_H__
+#define __MESH_GEOMETRY_H__
+
+#include <AABB.h>
+#include <Structures.h>
+#include <vector>
+
+// Indexed triangle storage of a mesh. Positions, shading normals and texture
+// coordinates are stored once per vertex and faces refer to them by index,
+// so the mesh BVH only has to keep face indices in its leaves.
+class MeshGeometry
+{
+public:
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+
+    std::vector<Indices> faces;
+    std::vector<glm::vec3> faceNormals;
+
+    // Vertex attributes have to be added before the faces referencing them
+    int AddVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoord);
+    void AddFace(int a, int b, int c);
+
+    // Moves the geometry into the space of matrix, normals are transformed by
+    // its inverse transpose the same way hit normals are
+    void Transform(const glm::mat4& matrix);
+
+    size_t FaceCount() const;
+    AABB FaceBounds(int face) const;
+    glm::vec3 FaceCenter(int face) const;
+    float FaceArea(int face) const;
+
+    // beta and gamma are the barycentric weights of the second and third vertex
+    bool IsBackfacing(int face, const Ray& ray, float beta, float gamma, bool softShadingFlag) const;
+
+    // Interpolates normal and texture coordinates, only done for the closest hit
+    void ComputeHit(int face, float beta, float gamma, bool softShadingFlag, const glm::mat3& normalToWorldMatrix, IntersectionReport& report) const;
+};
+
+
+#endif
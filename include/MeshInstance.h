@@ -10,7 +10,11 @@ private:
 public:
     Mesh* mesh;
     MeshInstance();
-    bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);    
+    bool Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);    
+    void IntersectPacket(RayPacket& packet, int first, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    void ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report);
+    bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    AABB WorldBounds();
 
 };
 
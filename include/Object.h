@@ -6,6 +6,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <Texture.h>
+#include <AABB.h>
+#include <RayPacket.h>
 
 class Object
 {
@@ -17,6 +19,17 @@ public:
 
     glm::vec3 translationVector;
 
+    // Affine parts of the matrices above, filled by PrecomputeTransforms once
+    // the object is loaded. Static objects with an identity transform skip
+    // the matrix work, moving ones undo the motion blur translation directly.
+    glm::mat3 objectToWorldLinear   = glm::mat3(1.0f);
+    glm::vec3 objectToWorldOffset   = glm::vec3(0.0f);
+    glm::mat3 worldToObjectLinear   = glm::mat3(1.0f);
+    glm::vec3 worldToObjectOffset   = glm::vec3(0.0f);
+    glm::mat3 normalToWorldMatrix   = glm::mat3(1.0f);
+    bool identityTransform = false;
+    bool moving = false;
+
     Texture *diffuseMap = nullptr;
     Texture *specularMap = nullptr;
     Texture *normalMap = nullptr;
@@ -26,31 +39,133 @@ public:
 
     size_t materialId;
 
-    virtual bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling) = 0;
+    // Closest hit query, no shading data is computed
+    virtual bool Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling) = 0;
+
+    // Expands a hit this object returned from Intersect with the same ray.
+    // Distance, point and hit object are already set in the report, this adds
+    // material, normal, texture coordinates and texture lookups.
+    virtual void ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report) = 0;
+
+    // Closest hit query for the rays of a packet from first on, a hit only
+    // replaces a ray's record when it is closer. Objects without a packet
+    // traversal of their own test the rays one by one.
+    virtual void IntersectPacket(RayPacket& packet, int first, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+    {
+        for(int i=first; i<packet.count; i++)
+        {
+            HitRecord candidate;
+            float closest = std::min(tmax, packet.hits[i].t);
+            if(Intersect(packet.rays[i], candidate, tmin, closest, intersectionEpsilon, backfaceCulling) && candidate.t < packet.hits[i].t)
+                packet.hits[i] = candidate;
+        }
+    }
+
+    // Any hit query for shadow rays, true if the ray hits in (tmin, tmax).
+    // Stops at the first hit and never evaluates shading data.
+    virtual bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling) = 0;
+
+    // World space bounds covering the whole motion blur interval
+    virtual AABB WorldBounds() = 0;
+
+    virtual bool IsLight() const
+    {
+        return false;
+    }
+
+    void PrecomputeTransforms()
+    {
+        objectToWorldLinear = glm::mat3(transformationMatrix);
+        objectToWorldOffset = glm::vec3(transformationMatrix[3]);
+        worldToObjectLinear = glm::mat3(transformationMatrixInversed);
+        worldToObjectOffset = glm::vec3(transformationMatrixInversed[3]);
+        normalToWorldMatrix = glm::mat3(transformationMatrixInverseTransposed);
+
+        identityTransform = transformationMatrix == glm::mat4(1.0f);
+        moving = translationVector != glm::vec3(0.0f);
+    }
+
+    // For geometry already moved to world space
+    void ClearTransform()
+    {
+        transformationMatrix                  = glm::mat4(1.0f);
+        transformationMatrixTransposed        = glm::mat4(1.0f);
+        transformationMatrixInversed          = glm::mat4(1.0f);
+        transformationMatrixInverseTransposed = glm::mat4(1.0f);
+    }
+
+    // At ray.time the object is moved by time * translationVector, the ray is
+    // moved back by it before the static inverse transform
+    Ray RayToObjectSpace(const Ray& ray) const
+    {
+        glm::vec3 origin    = PointToObjectSpace(ray.origin, ray.time);
+        glm::vec3 direction = identityTransform ? ray.direction : worldToObjectLinear * ray.direction;
+
+        return Ray(origin, direction);
+    }
 
-    glm::mat4 MotionBlurTranslate(float time)
+    // Object space copy of the rays from first on, with their current hits
+    RayPacket PacketToObjectSpace(const RayPacket& packet, int first) const
     {
-        if(translationVector.x == 0 &&
-           translationVector.y == 0 &&
-           translationVector.z == 0)
-           return glm::mat4(1.0f);
+        RayPacket result;
+        result.count = packet.count;
+        for(int i=first; i<packet.count; i++)
+        {
+            result.rays[i] = RayToObjectSpace(packet.rays[i]);
+            result.hits[i] = packet.hits[i];
+        }
+        result.Finalize(first);
 
-        glm::vec3 currentTranslation = time * translationVector;
+        return result;
+    }
 
-        return glm::inverse(glm::translate(glm::mat4(1.0f),currentTranslation));
+    glm::vec3 PointToObjectSpace(const glm::vec3& point, float time) const
+    {
+        glm::vec3 result = moving ? point - time * translationVector : point;
+        if(identityTransform)
+            return result;
 
+        return worldToObjectLinear * result + worldToObjectOffset;
     }
 
-    glm::mat4 MotionBlurTranslate2(float time)
+    glm::vec3 PointToWorldSpace(const glm::vec3& point, float time) const
     {
-        if(translationVector.x == 0 &&
-           translationVector.y == 0 &&
-           translationVector.z == 0)
-           return glm::mat4(1.0f);
+        glm::vec3 result = identityTransform ? point : objectToWorldLinear * point + objectToWorldOffset;
+        if(moving)
+            result += time * translationVector;
 
-        glm::vec3 currentTranslation = time * translationVector;
+        return result;
+    }
+
+    glm::vec3 DirectionToWorldSpace(const glm::vec3& direction) const
+    {
+        return identityTransform ? direction : objectToWorldLinear * direction;
+    }
 
-        return glm::translate(glm::mat4(1.0f),currentTranslation);        
+    // Not normalized, translation leaves normals unchanged
+    glm::vec3 NormalToWorldSpace(const glm::vec3& normal) const
+    {
+        return identityTransform ? normal : normalToWorldMatrix * normal;
+    }
+
+    // Transforms object space bounds to world space and sweeps them along the
+    // motion blur translation, which is applied after the model transform
+    AABB TransformBounds(const AABB& box)
+    {
+        AABB result;
+        if(box.bounds[0].x > box.bounds[1].x)
+            return result;
+
+        for(int i=0; i<8; i++)
+        {
+            glm::vec3 corner(box.bounds[i & 1].x, box.bounds[(i >> 1) & 1].y, box.bounds[(i >> 2) & 1].z);
+            glm::vec3 worldCorner = transformationMatrix * glm::vec4(corner, 1.0f);
+
+            result.Extend(worldCorner);
+            result.Extend(worldCorner + translationVector);
+        }
+
+        return result;
     }
 
     float ColorDistance(glm::vec3 c1, glm::vec3 c2)
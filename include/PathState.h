@@ -0,0 +1,39 @@
+#ifndef __PATH_STATE_H__
+#define __PATH_STATE_H__
+
+#include <Ray.h>
+#include <Structures.h>
+
+// A continuation ray leaving a path vertex, weight scales the radiance it
+// brings back. Under next event estimation the vertex has already added its
+// direct lighting, so a bounce that hits a light is dropped and the direct
+// term that counts depends on whether it does.
+struct PathBranch
+{
+    Ray ray;
+    glm::vec3 weight = glm::vec3(0.0f);
+
+    bool nextEvent = false;
+    glm::vec3 directIfLight   = glm::vec3(0.0f);
+    glm::vec3 directOtherwise = glm::vec3(0.0f);
+};
+
+// A live path of the wavefront integrator. The direct terms are already
+// scaled by the throughput of the vertex that emitted the ray.
+struct PathState
+{
+    Ray ray;
+    glm::vec3 throughput;
+    int sample;     // primary sample the path adds its radiance to
+    int depth;
+    RandomStream stream;
+
+    bool nextEvent;
+    glm::vec3 directIfLight;
+    glm::vec3 directOtherwise;
+
+    HitRecord hit;
+};
+
+
+#endif
@@ -1,30 +1,133 @@
 #ifndef __RANDOM_GENERATOR_H__
 #define __RANDOM_GENERATOR_H__
 
-#include<random>
+#include <cstdint>
+#include <Sampler.h>
 
+// Every path vertex has its own range of dimensions, the camera is vertex 0.
+// Draws past the range of a vertex are independent numbers.
+const uint32_t VERTEX_SAMPLE_DIMENSIONS = 16;
+
+// Dimensions of the camera vertex, the pixel position takes two
+const uint32_t CAMERA_PIXEL_DIMENSION = 0;
+const uint32_t CAMERA_LENS_DIMENSION  = 2;
+const uint32_t CAMERA_TIME_DIMENSION  = 3;
+
+// Dimensions of the other vertices. Light and material sampling start after
+// Russian roulette, in the order they draw.
+const uint32_t ROULETTE_DIMENSION = 0;
+const uint32_t SHADING_DIMENSION  = 2;
+
+// Render wide seed, set once before rendering
+inline uint32_t randomSeed = 0;
+// Low discrepancy sampler of the render, independent numbers without one
+inline const Sampler* randomSampler = nullptr;
+
+// PCG output permutation, a well mixed 32 bit hash
+inline uint32_t RandomHash(uint32_t value)
+{
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Random numbers of one pixel sample. Every value is a function of the
+// pixel, the sample, the path branch, the vertex, the dimension and the seed,
+// so it is the same whichever thread draws it and whatever was drawn
+// elsewhere.
+struct RandomStream
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t sample = 0;
+    uint32_t branch = 0;
+    uint32_t vertex = 0;
+    uint32_t dimension = 0;
+
+    RandomStream()
+    {
+
+    }
+
+    RandomStream(uint32_t x, uint32_t y, uint32_t sample) : x(x), y(y), sample(sample)
+    {
+
+    }
+
+    // Stream of the index-th ray a path splits into. The first ray keeps
+    // drawing from this one, the others start their own sequence.
+    RandomStream Branch(int index) const
+    {
+        RandomStream result = *this;
+        if(index > 0)
+            result.branch = RandomHash(branch ^ RandomHash(index));
+        return result;
+    }
+
+    void StartVertex(uint32_t index)
+    {
+        vertex    = index;
+        dimension = 0;
+    }
+
+    void Seek(uint32_t index)
+    {
+        dimension = index;
+    }
+
+    // Uniform in [0, 1)
+    float Next()
+    {
+        uint32_t current = dimension++;
+        if(randomSampler && current < VERTEX_SAMPLE_DIMENSIONS)
+            return randomSampler->Sample(x, y, sample, vertex * VERTEX_SAMPLE_DIMENSIONS + current, RandomHash(branch ^ RandomHash(randomSeed)));
+
+        uint32_t hash = RandomHash(x ^ RandomHash(y ^ RandomHash(sample ^ RandomHash(branch ^ RandomHash(vertex ^ RandomHash(current))))));
+        hash = RandomHash(randomSeed ^ hash);
+        return (hash >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Two dimensions of one pair, the pattern of the sampler holds for them
+    void Next2D(float& u, float& v)
+    {
+        dimension += dimension & 1;
+        u = Next();
+        v = Next();
+    }
+};
+
+// Stream the generators of the calling thread draw from. The render loop
+// points it at the sample being traced, threads never share it.
+inline RandomStream& CurrentRandomStream()
+{
+    static thread_local RandomStream stream;
+    return stream;
+}
+
+// Uniform numbers in a range, drawn from the stream of the current sample
 class RandomGenerator
 {
 private:
     float rangeFrom;
     float rangeTo;
-    std::random_device randomDevice;
-    std::mt19937       generator;
-    std::uniform_real_distribution<float> distr;
 
 public:
     RandomGenerator(float from, float to)
     {
         rangeFrom = from;
         rangeTo   = to;
-
-        generator = std::mt19937(randomDevice());
-        distr     = std::uniform_real_distribution<float>(rangeFrom, rangeTo);
     }
 
     float Generate()
     {
-        return distr(generator);
+        return rangeFrom + (rangeTo - rangeFrom) * CurrentRandomStream().Next();
+    }
+
+    void Generate2D(float& u, float& v)
+    {
+        CurrentRandomStream().Next2D(u, v);
+        u = rangeFrom + (rangeTo - rangeFrom) * u;
+        v = rangeFrom + (rangeTo - rangeFrom) * v;
     }
     
 };
@@ -27,6 +27,7 @@ public:
         mediumCoeffBefore = 1;
         mediumCoeffNow    = 1;
         rayEnergy         = 1;
+        rayThroughput     = 1;
 
         materialIdCurrentlyIn = -1;
     }
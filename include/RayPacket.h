@@ -0,0 +1,74 @@
+#ifndef __RAY_PACKET_H__
+#define __RAY_PACKET_H__
+
+#include <Ray.h>
+#include <Structures.h>
+#include <AABB.h>
+#include <cmath>
+
+const int RAY_PACKET_SIZE = 16;
+
+// Up to RAY_PACKET_SIZE rays traced together, each keeping its own closest
+// hit. A packet is coherent when its active rays share the origin and the
+// direction sign on every axis, the BVH can then reject a box for all of them
+// at once and visit children in the same order for the whole packet.
+struct RayPacket
+{
+    Ray rays[RAY_PACKET_SIZE];
+    HitRecord hits[RAY_PACKET_SIZE];
+    int count = 0;
+
+    bool coherent = false;
+    glm::vec3 origin;
+    int sign[3];
+    // Bounds of the inverse directions over the active rays
+    glm::vec3 invDirectionMin;
+    glm::vec3 invDirectionMax;
+
+    // Checks coherence of the rays from first on and sets the bounds above.
+    // Rays parallel to an axis make the packet incoherent.
+    void Finalize(int first = 0)
+    {
+        coherent = count - first > 1;
+        if(!coherent)
+            return;
+
+        origin = rays[first].origin;
+        invDirectionMin = invDirectionMax = rays[first].invDirection;
+        for(int axis=0; axis<3; axis++)
+            sign[axis] = rays[first].sign[axis];
+
+        for(int i=first; i<count && coherent; i++)
+        {
+            const Ray& ray = rays[i];
+            coherent = ray.origin == origin;
+            for(int axis=0; axis<3 && coherent; axis++)
+                coherent = ray.sign[axis] == sign[axis] && std::isfinite(ray.invDirection[axis]);
+
+            invDirectionMin = glm::min(invDirectionMin, ray.invDirection);
+            invDirectionMax = glm::max(invDirectionMax, ray.invDirection);
+        }
+    }
+
+    // Interval arithmetic slab test of a coherent packet. True when no ray of
+    // the packet can hit the box within (t0, t1).
+    bool Misses(const AABB& box, float t0, float t1) const
+    {
+        float near = t0;
+        float far  = t1;
+
+        for(int axis=0; axis<3; axis++)
+        {
+            float nearDistance = box.bounds[sign[axis]][axis] - origin[axis];
+            float farDistance  = box.bounds[1 - sign[axis]][axis] - origin[axis];
+
+            near = std::max(near, std::min(nearDistance * invDirectionMin[axis], nearDistance * invDirectionMax[axis]));
+            far  = std::min(far,  std::max(farDistance * invDirectionMin[axis], farDistance * invDirectionMax[axis]));
+        }
+
+        return near > far;
+    }
+};
+
+
+#endif
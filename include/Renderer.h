@@ -9,11 +9,18 @@
 #include <Utils.h>
 #include <math.h>
 #include <algorithm>
+#include <ThreadPool.h>
+
+// Pixels per task of the per-pixel passes. The split does not depend on the
+// thread count, so sums over the image come out the same for any of them.
+const int PIXEL_CHUNK_SIZE = 16384;
 
 class Renderer
 {
 private:
 
+    // Declared first, the scene loads on it
+    ThreadPool pool;
     Scene scene;
 
 
@@ -26,12 +33,13 @@ private:
     void Clamp0_255(float* pixels, int width, int height);
 
 public:
-    Renderer(const std::string& filepath);
+    Renderer(const std::string& filepath, const RenderOptions& options);
     ~Renderer();
 
     void RenderOneCamera();
     void Render();
-    void WriteExr(float* rgb);
+    void WriteExr(float* rgb, const std::string& outputPath, int pixelType = TINYEXR_PIXELTYPE_HALF);
+    void WriteHeatmap();
 
     void SetKeyValue(float val);
     void SetConstrast(float val);
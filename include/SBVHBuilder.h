@@ -0,0 +1,74 @@
+#ifndef __SBVH_BUILDER_H__
+#define __SBVH_BUILDER_H__
+
+#include <BVHNodeBuilder.h>
+#include <MeshGeometry.h>
+#include <vector>
+
+// Triangle reference, a spatial split clips the box to the part of the
+// triangle on one side of the plane
+struct SBVHReference
+{
+    AABB box;
+    int primitive;
+};
+
+struct SBVHSpatialBin
+{
+    AABB box;
+    int entries = 0;    // references starting in this bin
+    int exits   = 0;    // references ending in this bin
+};
+
+// Candidate split of a node's references, costs are left and right surface
+// area times reference count
+struct SBVHSplit
+{
+    float cost = FLT_MAX;
+    int axis   = -1;
+    int bin    = -1;
+    AABB leftBox;
+    AABB rightBox;
+    int leftCount  = 0;
+    int rightCount = 0;
+};
+
+// Spatial split BVH builder for triangle meshes. Besides binned object
+// splits it considers splitting the triangle references themselves at spatial
+// bin planes, so long thin triangles no longer force heavily overlapping
+// children. A triangle can end up in several leaves, primitiveIndices then
+// holds more entries than there are faces.
+class SBVHBuilder
+{
+private:
+    const MeshGeometry& geometry;
+    BVHSettings settings;
+
+    std::vector<BVHNode>& nodes;
+    std::vector<int>& primitiveIndices;
+
+    int threadCount;
+    int parallelDepth;
+
+    float minOverlapArea;
+    int duplicationLimit;   // references spatial splits may add over the whole tree
+
+    void splitReference(const SBVHReference& reference, int axis, float position, SBVHReference& left, SBVHReference& right) const;
+    SBVHSplit findObjectSplit(const std::vector<SBVHReference>& references) const;
+    SBVHSplit findSpatialSplit(const AABB& box, const std::vector<SBVHReference>& references) const;
+    void performObjectSplit(const SBVHSplit& split, std::vector<SBVHReference>& references, std::vector<SBVHReference>& left, std::vector<SBVHReference>& right) const;
+    void performSpatialSplit(const AABB& box, const SBVHSplit& split, std::vector<SBVHReference>& references, std::vector<SBVHReference>& left, std::vector<SBVHReference>& right) const;
+    // budget is the number of references spatial splits may still add below
+    // this node. Each split hands what is left to its children in proportion
+    // to their reference counts, so the tree does not depend on the order
+    // subtrees are built in.
+    void build(std::vector<SBVHReference>& references, int depth, int budget, std::vector<BVHNode>& outNodes, std::vector<int>& outIndices);
+
+public:
+    SBVHBuilder(const MeshGeometry& geometry, const BVHSettings& settings, std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices);
+
+    void Build();
+};
+
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <cstdint>
+
+enum SamplerType
+{
+    INDEPENDENT = 0,    // hashed uniform numbers, no sampler
+    HALTON = 1,
+    SOBOL = 2,
+    BLUE_NOISE = 3      // one Sobol sequence for all pixels, shifted by a blue noise mask
+};
+
+// Source of the random numbers of a render. Sample returns dimension of the
+// index-th sample of pixel (x, y) in [0, 1). Dimensions 2k and 2k + 1 form
+// a well distributed 2D pattern over the samples of a pixel. key tells
+// apart renders with different seeds and the rays a path splits into.
+class Sampler
+{
+public:
+    virtual ~Sampler()
+    {
+
+    }
+
+    virtual float Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const = 0;
+};
+
+// nullptr for INDEPENDENT
+Sampler* CreateSampler(SamplerType type);
+
+
+#endif
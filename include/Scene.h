@@ -4,6 +4,7 @@
 #include <iostream>
 #include <RootDir.h>
 #include <vector>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -18,6 +19,11 @@
 #include <Mesh.h>
 #include <MeshInstance.h>
 #include <Object.h>
+#include <TopLevelBVH.h>
+#include <RayPacket.h>
+#include <PathState.h>
+#include <TileScheduler.h>
+#include <ThreadPool.h>
 
 #include <omp.h>
 #include <thread>
@@ -49,6 +55,13 @@ struct WorkGroup
     int end;
 };
 
+// Render threads take tiles of this many pixels squared unless --tile-size
+// says otherwise, the wavefront integrator traces a tile as one batch
+const int DEFAULT_TILE_SIZE = 16;
+// Primary ray packets are gathered from blocks of this many pixels squared
+const int PACKET_TILE_SIZE = 4;
+const int PROGRESS_INTERVAL_MS = 250;
+
 struct RayTraceResult
 {
     bool hit;
@@ -84,11 +97,8 @@ private:
 
     tinyxml2::XMLNode* inputRoot;
 
-    int worksize;
-    int coreSize;
-    std::atomic<int> count;
-    std::vector<std::future<void>> futureVector;
-    std::mutex progressLock;
+    // Owned by the renderer, shared by loading and rendering
+    ThreadPool& pool;
     std::mutex mutex;
     std::condition_variable waitResults;
 
@@ -111,6 +121,8 @@ private:
     std::vector<Object*> _objectPointerVector;
     std::vector<Object*> _lightObjectPointerVector;
 
+    TopLevelBVH* _topLevelBVH;
+
     std::vector<PointLight>       _pointLights;
     std::vector<AreaLight>        _areaLights;
     std::vector<EnvironmentLight> _environmentLights;
@@ -120,11 +132,19 @@ private:
     std::vector<LightMesh>        _lightMeshes;
     std::vector<LightSphere>      _lightSpheres;
 
-    std::vector<Light*> _lightPointerVector;
+    std::vector<const Light*> _lightPointerVector;
 
     std::vector<BRDF>       _brdfs;
     std::vector<Material>   _materials;
 
+    BVHSettings _bvhSettings;
+    bool _packetTracing = false;
+    bool _wavefront = false;
+    int _tileSize = DEFAULT_TILE_SIZE;
+    TileOrder _tileOrder = TileOrder::SCANLINE;
+    // Low discrepancy sampler the random streams draw from, null for independent numbers
+    Sampler* _sampler = nullptr;
+
     float _shadowRayEpsilon;
     float _intersectionTestEpsilon;    
     int   _maxRecursionDepth;
@@ -143,6 +163,9 @@ private:
                                float intersectionTestEpsilon,
                                bool backfaceCulling);
 
+    // Fills the report for a hit found by the top-level BVH, false for a miss
+    bool ExpandHit(const Ray& ray, const HitRecord& hit, IntersectionReport& report);
+
     bool ShadowRayIntersection(
                                float tmin,
                                float tmax,
@@ -158,26 +181,52 @@ private:
     glm::vec3 ComputeDiffuseSpecular(const IntersectionReport& report, const Ray& ray);
     glm::vec3 ComputeSpecularComponent(const IntersectionReport& report, const PointLight& light, const Ray& ray);
 
-    RayTraceResult RayTrace(const Ray& ray, bool backfaceCulling);
-    RayTraceResult PathTrace(const Ray& ray, bool backfaceCulling, int recursionDepth);
+    // primaryHit, when given, is the closest hit of ray found beforehand by a
+    // packet traversal and replaces the first intersection test
+    RayTraceResult RayTrace(const Ray& ray, bool backfaceCulling, const HitRecord* primaryHit = nullptr);
+    RayTraceResult PathTrace(const Ray& ray, bool backfaceCulling, int recursionDepth, const HitRecord* primaryHit = nullptr);
+
+    // Material part of a path vertex that is neither a light nor a replace
+    // all texture. Writes up to two continuation rays, rrProb is already
+    // divided into their weights and direct terms. Returns their number.
+    int ScatterPath(const Ray& ray, const IntersectionReport& r, float rrProb, PathBranch* branches);
+
+    // Path traces a batch of primary rays bounce by bounce, each path draws
+    // from the stream of its sample. primaryHits may hold their closest hits
+    // from a packet traversal.
+    void WavefrontPathTrace(const std::vector<Ray>& rays, const std::vector<RandomStream>& streams, const HitRecord* primaryHits, std::vector<RayTraceResult>& results);
 
     glm::vec3 RecursiveTrace(const Ray& ray, const IntersectionReport& iR, int bounce, bool backfaceCulling);
 
-    glm::vec3 TraceAndFilter(std::vector<RayWithWeigth> rwwVector, int x, int y);
+    glm::vec3 TraceAndFilter(std::vector<RayWithWeigth> rwwVector, int x, int y, const HitRecord* primaryHits = nullptr);
+    // Gaussian filter over the traced samples of a pixel, misses take the background
+    glm::vec3 FilterSamples(const std::vector<RayWithWeigth>& rwwVector, const RayTraceResult* results, int x, int y);
+
+    // Renders a tile into buffer, rows of tile.Width() pixels. With packets
+    // the primary rays are intersected in packets first, with wavefront the
+    // whole tile is path traced as one batch.
+    void TraceTile(const Tile& tile, bool packets, bool wavefront, float* buffer);
+    // Copies a rendered tile into the image
+    void CommitTile(const Tile& tile, const float* buffer);
 
     void RenderThread();
 
+    // Prints the mesh and top-level BVH statistics and/or writes them as JSON
+    void ReportBVHStats(const RenderOptions& options);
+
 public:
 
     int _imageWidth;
     int _imageHeight;
     float* _image;
+    float* _heatmap = nullptr;      // nodes visited and primitives tested per pixel, when enabled
+    bool _heatmapShadowRays = false;
     std::string _imageName;
     std::vector<Camera> _cameras;    
     Camera _activeCamera;
     RandomGenerator* cameraVariableGenerator;    
 
-    Scene(const std::string& filepath);
+    Scene(const std::string& filepath, const RenderOptions& options, ThreadPool& pool);
     ~Scene();
 
     glm::vec2 GiveCoords(int index, int width);
@@ -186,6 +235,7 @@ public:
     void ClearImage();
 
     void WritePixelCoord(int i, int j, const glm::vec3& color);
+    void WriteHeatmapPixel(int i, int j, float nodesVisited, float primitivesTested);
 };
 
 
@@ -0,0 +1,20 @@
+#ifndef __SOBOL_SAMPLER_H__
+#define __SOBOL_SAMPLER_H__
+
+#include <Sampler.h>
+
+// Padded 2D Sobol sampler. Each pair of dimensions takes the first two
+// Sobol dimensions, a (0, 2)-sequence, Owen scrambled with hashes of the
+// pixel and the pair. The sample index is shuffled per pair the same way,
+// so different pairs are not correlated.
+class SobolSampler : public Sampler
+{
+public:
+    virtual float Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const;
+
+    // Scrambled point of the sequence for a pair seed, pixel independent
+    static uint32_t ScrambledSobol(uint32_t index, uint32_t dimension, uint32_t seed);
+};
+
+
+#endif
@@ -13,7 +13,15 @@
 
 class Sphere : public Object
 {
-private:
+protected:
+    // Sets normal and texture coordinates of a hit at hit.t along r, returns
+    // the object space hit point relative to the center along with its
+    // spherical angles
+    glm::vec3 computeHit(const Ray& r, const HitRecord& hit, IntersectionReport& report, float& theta, float& phi) const;
+
+    // Distance along r to the surface, the far side when r starts inside.
+    // False when r misses the sphere.
+    bool surfaceDistance(const Ray& r, float& t) const;
 
 public:
     glm::vec3 center;
@@ -21,7 +29,10 @@ public:
 
     bool solveQuadratic(const float &a, const float &b, const float &c, float &x0, float& x1);
     Sphere(glm::vec3 center, float radius, size_t materialId);
-    virtual bool Intersect(const Ray& r, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    virtual bool Intersect(const Ray& r, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    virtual void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, IntersectionReport& report);
+    virtual bool Occluded(const Ray& r, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    virtual AABB WorldBounds();
 
 };
 
@@ -6,7 +6,7 @@
 class SpotLight : public Light
 {
 private:
-    float GetFollowFactor(float theta);
+    float GetFollowFactor(float theta) const;
 
 public:
     alignas(16) glm::vec3 position;
@@ -21,12 +21,12 @@ public:
 
     bool ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                const IntersectionReport& report, bool backfaceCulling,
-                               float time, std::vector<Object *>& objectPointerVector);
+                               float time, TopLevelBVH& topLevelBVH) const;
 
     glm::vec3 ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                      const float& phongExponent, const IntersectionReport& report,
                                      float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                     bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex);
+                                     bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const;
 
     
 };
@@ -8,8 +8,10 @@
 #include <algorithm>
 #include <list>
 #include <stack>
+#include <cfloat>
 #include <Ray.h>
 #include <Texture.h>
+#include <RandomGenerator.h>
 
 enum TMO
 {
@@ -111,6 +113,19 @@ struct Indices
     int c;
 };
 
+class Object;
+
+// Closest hit kept during traversal. Only the final one is expanded into an
+// IntersectionReport by Object::ComputeSurfaceInteraction.
+struct HitRecord
+{
+    float t = FLT_MAX;
+    int primitiveId;    // face of a mesh
+    float beta;         // weights of the second and third triangle vertex
+    float gamma;
+    Object* object = nullptr;
+};
+
 struct IntersectionReport
 {
     alignas(16) glm::vec3 intersection;
@@ -158,7 +173,7 @@ struct IntersectionReport
 
     float throughput;
 
-    void* hitObject;
+    Object* hitObject;
 
 };
 
@@ -174,6 +189,7 @@ struct RayWithWeigth
     Ray r;
     float distX;
     float distY;
+    RandomStream stream;    // where tracing the sample continues the random sequence
 };
 
 struct OrthonormalBasis
@@ -182,4 +198,25 @@ struct OrthonormalBasis
     alignas(16) glm::vec3 v;
 };
 
+// Command line overrides of scene file settings
+struct RenderOptions
+{
+    int bvhWidth = 0;   // 0 keeps the width given in the scene file
+    bool bvhCache = false;
+    std::string bvhCacheDir;        // directory of the BVH cache, empty uses bvhcache in the build directory
+    bool bvhStats = false;          // print BVH statistics after loading
+    std::string bvhStatsPath;       // write them as JSON when not empty
+    bool heatmap = false;           // write per-pixel traversal cost next to the image
+    bool heatmapShadowRays = false; // include the shadow rays of the shading in it
+    bool watertight = false;        // watertight triangle test for meshes and triangles
+    bool bakeTransforms = false;    // move static geometry to world space while loading
+    bool packets = false;           // trace primary rays in packets over pixel tiles
+    bool wavefront = false;         // path trace tiles bounce by bounce instead of sample by sample
+    int tileSize = 0;               // 0 keeps the default tile size
+    std::string tileOrder;          // scanline, morton or spiral, empty keeps scanline
+    int threads = 0;                // worker threads of the render pool, 0 uses every core
+    unsigned seed = 0;              // random sequence of the render, same seed gives the same image
+    std::string sampler;            // random, halton, sobol or bluenoise, empty draws independent numbers
+};
+
 #endif
\ No newline at end of file
@@ -127,7 +127,7 @@ public:
         return noiseGenerator.GenerateNoise(scaledPoint);
     }
 
-    glm::vec3 Fetch(float u, float v)
+    glm::vec3 Fetch(float u, float v) const
     {
         glm::vec3 result(0.0,0.0,0.0);
         if(type == TextureType::IMAGE)
@@ -0,0 +1,104 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+class ThreadPool;
+
+// Tasks started together and waited for together. Wait runs queued tasks of
+// any group on the calling thread meanwhile, so a task can wait on a group of
+// its own without holding a worker idle.
+class TaskGroup
+{
+private:
+    ThreadPool& pool;
+    std::atomic<int> pendingCount;
+
+    std::mutex errorLock;
+    std::exception_ptr error;
+
+    void drain();
+
+public:
+    TaskGroup(ThreadPool& pool);
+    ~TaskGroup();
+
+    void Run(std::function<void()> task);
+    // Returns once every task has finished, rethrows the first exception
+    // one of them threw
+    void Wait();
+};
+
+// Worker threads that live as long as the renderer. Every worker has its own
+// deque, tasks it submits go to the back and it takes work from the back too,
+// an idle worker steals from the front of the others. Tasks from threads
+// outside the pool are dealt to the workers in turn.
+class ThreadPool
+{
+private:
+    struct Worker
+    {
+        std::deque<std::function<void()>> tasks;
+        std::mutex lock;
+    };
+
+    std::vector<Worker*> workers;
+    std::vector<std::thread> threads;
+
+    std::atomic<int> queuedCount;
+    std::atomic<unsigned> nextWorker;
+
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+    bool stopping;
+
+    bool takeTask(int worker, std::function<void()>& task);
+    void workerLoop(int index);
+
+public:
+    // 0 threads starts one per core
+    ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    int Size() const;
+
+    void Submit(std::function<void()> task);
+    // Runs one queued task on the calling thread, false if none was queued
+    bool RunPendingTask();
+
+    // Calls body(start, end) for the ranges of grainSize items [begin, end)
+    // splits into and waits for all of them
+    template<typename Body>
+    void ParallelFor(int begin, int end, int grainSize, const Body& body)
+    {
+        grainSize = std::max(1, grainSize);
+        if(end - begin <= grainSize)
+        {
+            if(begin < end)
+                body(begin, end);
+            return;
+        }
+
+        TaskGroup group(*this);
+        for(int start=begin; start<end; start+=grainSize)
+        {
+            int stop = std::min(end, start + grainSize);
+            group.Run([&body, start, stop]()
+            {
+                body(start, stop);
+            });
+        }
+        group.Wait();
+    }
+};
+
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __TILE_SCHEDULER_H__
+#define __TILE_SCHEDULER_H__
+
+#include <vector>
+#include <atomic>
+
+enum TileOrder
+{
+    SCANLINE = 0,
+    MORTON = 1,     // Z-order over the tile grid, neighbouring tiles run close in time
+    SPIRAL = 2      // rings around the image center, the center finishes first
+};
+
+// Pixel range [startX, endX) x [startY, endY)
+struct Tile
+{
+    int startX;
+    int startY;
+    int endX;
+    int endY;
+
+    int Width() const
+    {
+        return endX - startX;
+    }
+
+    int Height() const
+    {
+        return endY - startY;
+    }
+};
+
+// Splits the image into square tiles and hands them out to the render
+// threads one at a time. Workers take tiles with Next and report them with
+// Finish, progress can be read from any thread meanwhile.
+class TileScheduler
+{
+private:
+    std::vector<Tile> tiles;
+    std::atomic<int> nextTile;
+    std::atomic<int> finishedPixels;
+    int pixelCount;
+
+public:
+    TileScheduler(int width, int height, int tileSize, TileOrder order);
+
+    // False once every tile has been handed out
+    bool Next(Tile& tile);
+    void Finish(const Tile& tile);
+
+    // Share of the pixels in finished tiles
+    float Progress() const;
+    bool Done() const;
+};
+
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __TOP_LEVEL_BVH_H__
+#define __TOP_LEVEL_BVH_H__
+
+#include <AABB.h>
+#include <BVHNodeBuilder.h>
+#include <BVHStats.h>
+#include <TraversalStats.h>
+#include <Structures.h>
+#include <Object.h>
+#include <RayPacket.h>
+#include <vector>
+#include <chrono>
+
+// Acceleration structure over the world space bounds of every scene object.
+// Leaves dispatch into Object::Intersect, so meshes continue into their own BVH.
+class TopLevelBVH
+{
+private:
+    std::vector<Object*> objects;
+    BVHSettings settings;
+
+public:
+    std::vector<BVHNode> nodes;
+    std::vector<int> primitiveIndices;
+    double buildTime;   // milliseconds
+
+    TopLevelBVH(const std::vector<Object*>& objects, const BVHSettings& settings, float intersectionTestEpsilon);
+
+    BVHStats Stats() const;
+
+    bool Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling);
+
+    // Closest hits of all rays of the packet, written to packet.hits. Rays
+    // that miss keep a record without an object.
+    void IntersectPacket(RayPacket& packet, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling);
+
+    // True if any object is hit in (tmin, tmax). ignoreObject and, when
+    // ignoreLights is set, all light objects never occlude.
+    bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling,
+                  const Object* ignoreObject = nullptr, bool ignoreLights = false);
+};
+
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __TRAVERSAL_STATS_H__
+#define __TRAVERSAL_STATS_H__
+
+#include <cstdint>
+
+// Work done by ray queries. Top-level leaves count every object they test as
+// a primitive, mesh leaves count every triangle.
+struct TraversalStats
+{
+    uint64_t nodesVisited = 0;
+    uint64_t primitivesTested = 0;
+};
+
+// Counters of the calling thread, closest hit and shadow queries are kept
+// apart so the heatmap can leave shadow rays out
+struct TraversalCounters
+{
+    TraversalStats closestHit;
+    TraversalStats shadow;
+
+    void Reset()
+    {
+        closestHit = TraversalStats();
+        shadow     = TraversalStats();
+    }
+};
+
+extern thread_local TraversalCounters traversalCounters;
+
+// Counts one traversal in locals and adds them to the thread's counters when
+// the traversal returns
+class TraversalCounter
+{
+private:
+    TraversalStats& stats;
+
+public:
+    int nodes = 0;
+    int primitives = 0;
+
+    TraversalCounter(TraversalStats& stats) : stats(stats)
+    {
+    }
+
+    ~TraversalCounter()
+    {
+        stats.nodesVisited     += nodes;
+        stats.primitivesTested += primitives;
+    }
+};
+
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <Structures.h>
 #include <Object.h>
+#include <TriangleIntersection.h>
 
 class Triangle : public Object
 {
@@ -25,14 +26,30 @@ public:
 
     glm::vec3 normal;
     float area;
+
+    // b - a and c - a, computed once for the intersection test
+    glm::vec3 edge1;
+    glm::vec3 edge2;
+
+    // Use the watertight test instead of the epsilon tolerant one
+    bool watertight = false;
     
     Triangle(glm::vec3 a, glm::vec3 b, glm::vec3 c);
     Triangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 aNormal, glm::vec3 bNormal, glm::vec3 cNormal);
     
     //Triangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, size_t materialId);
-    bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);    
-    bool Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool softShadingFlag, const glm::mat4& transformationMatrixTransposed, bool backfaceCulling);
+    bool Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);    
+    void ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report);
+    bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling);
+    bool Occluded(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, bool softShadingFlag, bool backfaceCulling) const;
+    AABB WorldBounds();
     bool FasterIntersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon);
+
+    // Object space hit test shared by Intersect and Occluded
+    bool IntersectLocal(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, float& t, float& beta, float& gamma) const;
+
+    // Moves the vertices and normals to world space and drops the transform
+    void BakeTransform();
     
     glm::vec3 GiveCenter() const;
 };
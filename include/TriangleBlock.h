@@ -0,0 +1,50 @@
+#ifndef __TRIANGLE_BLOCK_H__
+#define __TRIANGLE_BLOCK_H__
+
+#include <MeshGeometry.h>
+#include <Structures.h>
+#include <TriangleIntersection.h>
+
+// One block fills a SIMD register, 8 lanes with AVX and 4 otherwise
+#if defined(__AVX__)
+const int TRIANGLE_BLOCK_WIDTH = 8;
+#else
+const int TRIANGLE_BLOCK_WIDTH = 4;
+#endif
+
+// Up to TRIANGLE_BLOCK_WIDTH triangles of a BVH leaf in structure of arrays
+// layout. The vertices are kept as they are, the watertight test needs the
+// exact positions shared with neighbouring triangles.
+struct alignas(32) TriangleBlock
+{
+    float v0[3][TRIANGLE_BLOCK_WIDTH];
+    float v1[3][TRIANGLE_BLOCK_WIDTH];
+    float v2[3][TRIANGLE_BLOCK_WIDTH];
+    int face[TRIANGLE_BLOCK_WIDTH];     // -1 for unused lanes
+    int laneMask;
+
+    TriangleBlock();
+
+    void SetLane(int lane, const MeshGeometry& geometry, int face);
+
+    // Tests all lanes at once. Returns the mask of lanes hit in (tmin, tmax)
+    // with barycentrics inside [-intersectionTestEpsilon, 1 + intersectionTestEpsilon],
+    // t and the barycentrics of b and c are written per lane.
+    int Intersect(const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, float* t, float* beta, float* gamma) const;
+
+    // Same outputs with the watertight test, which takes no epsilon
+    int IntersectWatertight(const WatertightRay& ray, float tmin, float tmax, float* t, float* beta, float* gamma) const;
+};
+
+// Closest accepted triangle of a traversal, shading data is computed from it
+// once traversal is done
+struct TriangleHit
+{
+    int face = -1;
+    float t;
+    float beta;
+    float gamma;
+};
+
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __TRIANGLE_INTERSECTION_H__
+#define __TRIANGLE_INTERSECTION_H__
+
+#include <Ray.h>
+#include <glm/glm.hpp>
+
+// Per-ray data of the watertight test of Woop, Benthin and Wald. Vertices are
+// translated to the ray origin and sheared so the ray runs along +z, the 2D
+// edge functions then agree in sign on edges shared by two triangles and no
+// ray passes between them.
+struct WatertightRay
+{
+    glm::vec3 origin;
+    int kx;
+    int ky;
+    int kz;
+    float shearX;
+    float shearY;
+    float shearZ;
+
+    WatertightRay(const Ray& ray);
+};
+
+// Moller-Trumbore test with the edges b - a and c - a precomputed. Accepts
+// barycentrics inside [-intersectionTestEpsilon, 1 + intersectionTestEpsilon],
+// beta and gamma are the weights of b and c.
+bool IntersectTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& edge1, const glm::vec3& edge2,
+                       float tmin, float tmax, float intersectionTestEpsilon, float& t, float& beta, float& gamma);
+
+// Watertight test without an epsilon, edge functions that come out as
+// exactly zero are recomputed in double precision
+bool IntersectTriangleWatertight(const WatertightRay& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                                 float tmin, float tmax, float& t, float& beta, float& gamma);
+
+
+#endif
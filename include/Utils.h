@@ -3,6 +3,9 @@
 
 #include <Structures.h>
 #include <Mesh.h>
+#include <BVHCache.h>
+#include <TileScheduler.h>
+#include <Sampler.h>
 #include <Triangle.h>
 #include <MeshInstance.h>
 #include <Sphere.h>
@@ -111,6 +114,153 @@ inline void SceneReadConstants(tinyxml2::XMLNode* root, glm::vec3& _backgroundCo
     stream.clear();    
 }
 
+inline BVHBuilder ParseBVHBuilder(const char* name)
+{
+    if(std::strcmp(name, "sah") == 0)
+        return BVHBuilder::BINNED_SAH;
+    else if(std::strcmp(name, "midpoint") == 0)
+        return BVHBuilder::MIDPOINT;
+    else if(std::strcmp(name, "lbvh") == 0)
+        return BVHBuilder::LBVH;
+    else if(std::strcmp(name, "sbvh") == 0)
+        return BVHBuilder::SBVH;
+
+    throw std::runtime_error("Error: Unknown BVH builder.");
+}
+
+inline TileOrder ParseTileOrder(const char* name)
+{
+    if(std::strcmp(name, "scanline") == 0)
+        return TileOrder::SCANLINE;
+    else if(std::strcmp(name, "morton") == 0)
+        return TileOrder::MORTON;
+    else if(std::strcmp(name, "spiral") == 0)
+        return TileOrder::SPIRAL;
+
+    throw std::runtime_error("Error: Unknown tile order.");
+}
+
+inline SamplerType ParseSamplerType(const char* name)
+{
+    if(std::strcmp(name, "random") == 0)
+        return SamplerType::INDEPENDENT;
+    else if(std::strcmp(name, "halton") == 0)
+        return SamplerType::HALTON;
+    else if(std::strcmp(name, "sobol") == 0)
+        return SamplerType::SOBOL;
+    else if(std::strcmp(name, "bluenoise") == 0)
+        return SamplerType::BLUE_NOISE;
+
+    throw std::runtime_error("Error: Unknown sampler.");
+}
+
+inline int ParseTileSize(int size)
+{
+    if(size >= 1)
+        return size;
+
+    throw std::runtime_error("Error: Tile size must be positive.");
+}
+
+// 0 is kept, the pool then starts a thread per core
+inline int ParseThreadCount(int count)
+{
+    if(count >= 0)
+        return count;
+
+    throw std::runtime_error("Error: Thread count cannot be negative.");
+}
+
+inline int ParseBVHWidth(int width)
+{
+    if(width == 2 || width == 4 || width == 8)
+        return width;
+
+    throw std::runtime_error("Error: BVH width must be 2, 4 or 8.");
+}
+
+inline int ParseMortonBits(int bits)
+{
+    if(bits == 30 || bits == 63)
+        return bits;
+
+    throw std::runtime_error("Error: Morton code bits must be 30 or 63.");
+}
+
+// Scene-wide BVH construction settings, e.g.
+// <BVH builder="sah" width="4" cache="true"><BinCount>16</BinCount><MaxLeafSize>4</MaxLeafSize></BVH>
+// <BVH builder="lbvh"><MortonBits>30</MortonBits><TreeletSize>7</TreeletSize></BVH>
+// <BVH builder="sbvh"><DuplicationBudget>0.3</DuplicationBudget></BVH>
+inline void SceneReadBVHSettings(tinyxml2::XMLNode* root, BVHSettings& _bvhSettings)
+{
+    auto element = root->FirstChildElement("BVH");
+    if(!element)
+        return;
+
+    if(element->Attribute("builder"))
+        _bvhSettings.builder = ParseBVHBuilder(element->Attribute("builder"));
+
+    if(element->Attribute("width"))
+        _bvhSettings.width = ParseBVHWidth(element->IntAttribute("width"));
+
+    _bvhSettings.cache = element->BoolAttribute("cache", _bvhSettings.cache);
+    _bvhSettings.watertight = element->BoolAttribute("watertight", _bvhSettings.watertight);
+    _bvhSettings.bakeTransforms = element->BoolAttribute("bakeTransforms", _bvhSettings.bakeTransforms);
+
+    auto child = element->FirstChildElement("BinCount");
+    if(child)
+        child->QueryIntText(&_bvhSettings.binCount);
+
+    child = element->FirstChildElement("TraversalCost");
+    if(child)
+        child->QueryFloatText(&_bvhSettings.traversalCost);
+
+    child = element->FirstChildElement("LeafCost");
+    if(child)
+        child->QueryFloatText(&_bvhSettings.leafCost);
+
+    child = element->FirstChildElement("MaxLeafSize");
+    if(child)
+        child->QueryIntText(&_bvhSettings.maxLeafSize);
+
+    child = element->FirstChildElement("MaxDepth");
+    if(child)
+        child->QueryIntText(&_bvhSettings.maxDepth);
+
+    child = element->FirstChildElement("BuildThreads");
+    if(child)
+        child->QueryIntText(&_bvhSettings.buildThreads);
+
+    child = element->FirstChildElement("MortonBits");
+    if(child)
+        _bvhSettings.mortonBits = ParseMortonBits(child->IntText());
+
+    child = element->FirstChildElement("TreeletSize");
+    if(child)
+        child->QueryIntText(&_bvhSettings.treeletSize);
+
+    child = element->FirstChildElement("SpatialSplitAlpha");
+    if(child)
+        child->QueryFloatText(&_bvhSettings.spatialSplitAlpha);
+
+    child = element->FirstChildElement("DuplicationBudget");
+    if(child)
+        child->QueryFloatText(&_bvhSettings.duplicationBudget);
+}
+
+// A mesh may override the scene builder with a bvhBuilder="midpoint|sah|lbvh|sbvh"
+// attribute and the traversal width with bvhWidth="2|4|8"
+inline BVHSettings SceneReadMeshBVHSettings(tinyxml2::XMLElement* element, const BVHSettings& _bvhSettings)
+{
+    BVHSettings settings = _bvhSettings;
+    if(element->Attribute("bvhBuilder"))
+        settings.builder = ParseBVHBuilder(element->Attribute("bvhBuilder"));
+    if(element->Attribute("bvhWidth"))
+        settings.width = ParseBVHWidth(element->IntAttribute("bvhWidth"));
+
+    return settings;
+}
+
 inline void SceneReadCameras(tinyxml2::XMLNode* root, std::vector<Camera>& _cameras, std::vector<std::string>& imageNames, std::string& _imageName)
 {
     std::stringstream stream;    
@@ -986,399 +1136,289 @@ inline void SceneReadTexCoordData(tinyxml2::XMLNode* root, std::vector<glm::vec2
     };
 }
 
-inline void SceneReadMeshes(tinyxml2::XMLNode* root, std::vector<Mesh>& _meshes, std::vector<Texture*>& _textures, std::vector<glm::vec3>& _vertexData, std::vector<glm::vec2>& _texCoordData, std::vector<glm::mat4>& _rotationMatrices, std::vector<glm::mat4>& _scalingMatrices, std::vector<glm::mat4>& _translationMatrices, std::vector<glm::mat4>& _compositeMatrices)
+// Reads the Faces element of a mesh into indexed storage. Vertices are
+// shared between the faces of the mesh instead of being copied per triangle.
+// A worldTransform other than identity bakes the mesh transform into the geometry
+inline MeshGeometry* SceneReadMeshGeometry(tinyxml2::XMLElement* facesElement, const std::vector<glm::vec3>& _vertexData, const std::vector<glm::vec2>& _texCoordData, const glm::mat4& worldTransform)
 {
-    std::stringstream stream;
-    // Get Meshes
-    auto element = root->FirstChildElement("Objects");
-    element = element->FirstChildElement("Mesh");
-    
+    MeshGeometry* geometry = new MeshGeometry();
 
-    while(element)
+    if(facesElement->Attribute("plyFile"))
     {
-        bool softShading = false;
-
-        if(element->Attribute("shadingMode"))
-        {
-            if(std::strcmp(element->Attribute("shadingMode"), "smooth") == 0)
-                softShading = true;
-        }
+        bool normalsExist = false;
+        bool textureCoordsExist = false;
 
-        size_t materialId;
-        auto child = element->FirstChildElement("Material");
-        stream << child->GetText() << std::endl;
-        stream >> materialId;
+        const char* localPath = facesElement->Attribute("plyFile");
+        std::string path = std::string(ROOT_DIR) + "assets/scenes/" + std::string(localPath);
 
+        happly::PLYData plyIn(path);
 
-        stream.clear();
-        
-        child = element->FirstChildElement("Faces");
-        stream << child->GetText() << std::endl;
+        std::vector<std::array<double, 3>> vPos = plyIn.getVertexPositions();
 
-        std::vector<Triangle> triangleList;
-        std::vector<glm::vec3> normals;
-        std::vector<int> neighborCount;
+        std::vector<float> nx,ny,nz,u,v;
 
-        if(child->Attribute("plyFile"))
+        if(plyIn.getElement("vertex").hasProperty("nx") && plyIn.getElement("vertex").hasProperty("ny") && plyIn.getElement("vertex").hasProperty("nz"))
         {
-            bool normalsExist = false;
-            bool textureCoordsExist = false;
-
-            const char* localPath = child->Attribute("plyFile");
-            std::string path = std::string(ROOT_DIR) + "assets/scenes/" + std::string(localPath);
+            nx = plyIn.getElement("vertex").getProperty<float>(std::string("nx"));
+            ny = plyIn.getElement("vertex").getProperty<float>(std::string("ny"));
+            nz = plyIn.getElement("vertex").getProperty<float>(std::string("nz"));
+            normalsExist = true;
+        }
 
-            happly::PLYData plyIn(path);
+        if(plyIn.getElement("vertex").hasProperty("u") && plyIn.getElement("vertex").hasProperty("v"))
+        {
+            u = plyIn.getElement("vertex").getProperty<float>(std::string("u"));
+            v = plyIn.getElement("vertex").getProperty<float>(std::string("v"));
+            textureCoordsExist = true;
+        }
 
-            std::vector<std::array<double, 3>> vPos = plyIn.getVertexPositions();
-            std::vector<std::string> xasd = plyIn.getElement("vertex").getPropertyNames();
+        std::vector<std::vector<size_t>> fInd = plyIn.getFaceIndices<size_t>();
 
-            std::vector<float> nx,ny,nz,u,v;
+        std::vector<glm::vec3> normals;
+        std::vector<int> neighborCount;
 
-            if(plyIn.getElement("vertex").hasProperty("nx") && plyIn.getElement("vertex").hasProperty("ny") && plyIn.getElement("vertex").hasProperty("nz"))
-            {
-                nx = plyIn.getElement("vertex").getProperty<float>(std::string("nx"));
-                ny = plyIn.getElement("vertex").getProperty<float>(std::string("ny"));
-                nz = plyIn.getElement("vertex").getProperty<float>(std::string("nz"));
-                normalsExist = true;
-            }
-            else
+        if(!normalsExist)
+        {
+            for(size_t i=0; i<vPos.size(); i++)
             {
-                normalsExist = false;
+                normals.push_back(glm::vec3(0.0));
+                neighborCount.push_back(0);
             }
 
-            if(plyIn.getElement("vertex").hasProperty("u") && plyIn.getElement("vertex").hasProperty("v"))
-            {
-                u = plyIn.getElement("vertex").getProperty<float>(std::string("u"));
-                v = plyIn.getElement("vertex").getProperty<float>(std::string("v"));
-                textureCoordsExist = true;
-            }
-            else
+            for(size_t i=0; i<fInd.size(); i++)
             {
-                textureCoordsExist = false;
-            }
-            
-            
-            std::vector<std::vector<size_t>> fInd = plyIn.getFaceIndices<size_t>();
+                glm::vec3 a(vPos[fInd[i][0]][0], vPos[fInd[i][0]][1], vPos[fInd[i][0]][2]);
+                glm::vec3 b(vPos[fInd[i][1]][0], vPos[fInd[i][1]][1], vPos[fInd[i][1]][2]);
+                glm::vec3 c(vPos[fInd[i][2]][0], vPos[fInd[i][2]][1], vPos[fInd[i][2]][2]);
 
+                glm::vec3 normal = glm::normalize(glm::cross((b-a), (c-a)));
 
-            if(!normalsExist)
-            {
-                for(size_t i=0; i<vPos.size(); i++)
+                for(int k=0; k<3; k++)
                 {
-                    normals.push_back(glm::vec3(0.0));
-                    neighborCount.push_back(0);
+                    normals[fInd[i][k]] += normal;
+                    neighborCount[fInd[i][k]] += 1;
                 }
+            }
 
-                for(size_t i=0; i<fInd.size(); i++)
-                {
-                    glm::vec3 a,b,c;
-
-                    a.x = vPos[fInd[i][0]][0];
-                    a.y = vPos[fInd[i][0]][1];
-                    a.z = vPos[fInd[i][0]][2];
+            for(size_t i=0; i<normals.size(); i++)
+            {
+                normals[i] /= neighborCount[i];
+            }
+        }
 
-                    b.x = vPos[fInd[i][1]][0];
-                    b.y = vPos[fInd[i][1]][1];
-                    b.z = vPos[fInd[i][1]][2];                                
+        for(size_t i=0; i<vPos.size(); i++)
+        {
+            glm::vec3 position(vPos[i][0], vPos[i][1], vPos[i][2]);
+            glm::vec3 normal = normalsExist ? glm::vec3(nx[i], ny[i], nz[i]) : normals[i];
+            glm::vec2 texCoord = textureCoordsExist ? glm::vec2(u[i], v[i]) : glm::vec2(0.0f);
 
-                    c.x = vPos[fInd[i][2]][0];
-                    c.y = vPos[fInd[i][2]][1];
-                    c.z = vPos[fInd[i][2]][2];
+            geometry->AddVertex(position, normal, texCoord);
+        }
 
-                    glm::vec3 normal = glm::normalize(glm::cross((b-a), (c-a)));
+        // Quads are split into two triangles sharing the first vertex
+        for(size_t i=0; i<fInd.size(); i++)
+        {
+            if(fInd[i].size() == 3 || fInd[i].size() == 4)
+                geometry->AddFace(fInd[i][0], fInd[i][1], fInd[i][2]);
 
-                    normals[fInd[i][0]] += normal;
-                    neighborCount[fInd[i][0]] += 1;
+            if(fInd[i].size() == 4)
+                geometry->AddFace(fInd[i][0], fInd[i][2], fInd[i][3]);
+        }
+    }
+    else
+    {
+        std::stringstream stream;
+        stream << facesElement->GetText() << std::endl;
 
-                    normals[fInd[i][1]] += normal;
-                    neighborCount[fInd[i][1]] += 1;
+        Indices indices;
 
-                    normals[fInd[i][2]] += normal;
-                    neighborCount[fInd[i][2]] += 1;                                
+        std::vector<Indices> indexVector;
 
-                }
+        int vertexOffset = 0;
+        int textureOffset = 0;
+        
+        if(facesElement->Attribute("vertexOffset"))
+            vertexOffset = std::stoi(facesElement->Attribute("vertexOffset"));
+        if(facesElement->Attribute("textureOffset"))
+            textureOffset = std::stoi(facesElement->Attribute("textureOffset"));
 
-                for(size_t i=0; i<normals.size(); i++)
-                {
-                    normals[i] /= neighborCount[i];
-                }
-            }
+        std::unordered_map<int, glm::vec3> normal_map;
+        std::unordered_map<int, int> neighborCount_map;
 
+        while(!(stream >> indices.a).eof())
+        {
+            stream >> indices.b >> indices.c;
 
-            // TODO: SONRA BAK
+            normal_map[indices.a - 1] = glm::vec3(0.0f);
+            normal_map[indices.b - 1] = glm::vec3(0.0f);
+            normal_map[indices.c - 1] = glm::vec3(0.0f);
 
-            for(size_t i=0; i<fInd.size(); i++)
-            {
-                glm::vec3 a,b,c;
-
-                if(fInd[i].size() == 3)
-                {
-                    a.x = vPos[fInd[i][0]][0];
-                    a.y = vPos[fInd[i][0]][1];
-                    a.z = vPos[fInd[i][0]][2];
-
-                    b.x = vPos[fInd[i][1]][0];
-                    b.y = vPos[fInd[i][1]][1];
-                    b.z = vPos[fInd[i][1]][2];                                
-
-                    c.x = vPos[fInd[i][2]][0];
-                    c.y = vPos[fInd[i][2]][1];
-                    c.z = vPos[fInd[i][2]][2];
-
-                    if(!normalsExist)
-                    {
-                        Triangle tri(a, b, c, normals[fInd[i][0]], normals[fInd[i][1]], normals[fInd[i][2]]);
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }
-                    else
-                    {
-                        Triangle tri(a, b, c, glm::vec3(nx[fInd[i][0]], ny[fInd[i][0]], nz[fInd[i][0]]),
-                                              glm::vec3(nx[fInd[i][1]], ny[fInd[i][1]], nz[fInd[i][1]]),
-                                              glm::vec3(nx[fInd[i][2]], ny[fInd[i][2]], nz[fInd[i][2]]));
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }
-
-                    
-
-                }
-                else if(fInd[i].size() == 4)
-                {
-                    a.x = vPos[fInd[i][0]][0];
-                    a.y = vPos[fInd[i][0]][1];
-                    a.z = vPos[fInd[i][0]][2];
-
-                    b.x = vPos[fInd[i][1]][0];
-                    b.y = vPos[fInd[i][1]][1];
-                    b.z = vPos[fInd[i][1]][2];                                
-
-                    c.x = vPos[fInd[i][2]][0];
-                    c.y = vPos[fInd[i][2]][1];
-                    c.z = vPos[fInd[i][2]][2];
-
-                    if(!normalsExist)
-                    {
-                        Triangle tri(a, b, c, normals[fInd[i][0]], normals[fInd[i][1]], normals[fInd[i][2]]);
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }
-                    else
-                    {
-                        Triangle tri(a, b, c, glm::vec3(nx[fInd[i][0]], ny[fInd[i][0]], nz[fInd[i][0]]),
-                                              glm::vec3(nx[fInd[i][1]], ny[fInd[i][1]], nz[fInd[i][1]]),
-                                              glm::vec3(nx[fInd[i][2]], ny[fInd[i][2]], nz[fInd[i][2]]));
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }                    
-
-                    b.x = vPos[fInd[i][2]][0];
-                    b.y = vPos[fInd[i][2]][1];
-                    b.z = vPos[fInd[i][2]][2];                                
-
-                    c.x = vPos[fInd[i][3]][0];
-                    c.y = vPos[fInd[i][3]][1];
-                    c.z = vPos[fInd[i][3]][2];
-
-                    if(!normalsExist)
-                    {
-                        Triangle tri2(a, b, c, normals[fInd[i][0]], normals[fInd[i][2]], normals[fInd[i][3]]);
-                        if(textureCoordsExist)
-                        {
-                            tri2.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri2.texCoordB = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);
-                            tri2.texCoordC = glm::vec2(u[fInd[i][3]], v[fInd[i][3]]);                                                        
-                        }
-                        triangleList.push_back(tri2);                        
-                    }
-                    else
-                    {
-                        Triangle tri2(a, b, c, glm::vec3(nx[fInd[i][0]], ny[fInd[i][0]], nz[fInd[i][0]]),
-                                               glm::vec3(nx[fInd[i][2]], ny[fInd[i][2]], nz[fInd[i][2]]),
-                                               glm::vec3(nx[fInd[i][3]], ny[fInd[i][3]], nz[fInd[i][3]]));
-                        if(textureCoordsExist)
-                        {
-                            tri2.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri2.texCoordB = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);
-                            tri2.texCoordC = glm::vec2(u[fInd[i][3]], v[fInd[i][3]]);                                                        
-                        }
-                        triangleList.push_back(tri2);                        
-                    }
-
-                }              
-                
-            }
+            neighborCount_map[indices.a -1] = 1;
+            neighborCount_map[indices.b -1] = 1;
+            neighborCount_map[indices.c -1] = 1;
 
+            indexVector.push_back(indices);
         }
-        else
+
+        for(size_t i=0; i<indexVector.size(); i++)
         {
-            Indices indices;
+            glm::vec3 a = _vertexData[indexVector[i].a + vertexOffset - 1];
+            glm::vec3 b = _vertexData[indexVector[i].b + vertexOffset - 1];
+            glm::vec3 c = _vertexData[indexVector[i].c + vertexOffset - 1];            
 
-            std::vector<Indices> indexVector;
+            glm::vec3 ba = (b-a);
+            glm::vec3 ca = (c-a); 
 
-            int vertexOffset = 0;
-            int textureOffset = 0;
-            
-            if(child->Attribute("vertexOffset"))
-                vertexOffset = std::stoi(child->Attribute("vertexOffset"));
-            if(child->Attribute("textureOffset"))
-                textureOffset = std::stoi(child->Attribute("textureOffset"));
+            if(ba == glm::vec3(0.0))               
+                ba = glm::vec3(0.0001, 0.0001, 0.0001);
 
-            std::unordered_map<int, glm::vec3> normal_map;
-            std::unordered_map<int, int> neighborCount_map;
+            if(ca == glm::vec3(0.0))
+                ca = glm::vec3(-0.0001, 0.0001, 0.0001);
 
-            while(!(stream >> indices.a).eof())
-            {
-                stream >> indices.b >> indices.c;
+            if(ba == ca)
+                ca = glm::vec3(0.00001, 0.00001, 0.00001);
 
-                normal_map[indices.a - 1] = glm::vec3(0.0f);
-                normal_map[indices.b - 1] = glm::vec3(0.0f);
-                normal_map[indices.c - 1] = glm::vec3(0.0f);
+            glm::vec3 normal = glm::normalize(glm::cross((ba), (ca)));
 
-                neighborCount_map[indices.a -1] = 1;
-                neighborCount_map[indices.b -1] = 1;
-                neighborCount_map[indices.c -1] = 1;
+            normal_map[indexVector[i].a - 1] += normal;
+            normal_map[indexVector[i].b - 1] += normal;
+            normal_map[indexVector[i].c - 1] += normal;                
 
-                indexVector.push_back(indices);
-            }
+            neighborCount_map[indexVector[i].a - 1] += 1;
+            neighborCount_map[indexVector[i].b - 1] += 1;
+            neighborCount_map[indexVector[i].c - 1] += 1;                              
+        }
 
-            for(size_t i=0; i<_vertexData.size(); i++)
-            {
-                normals.push_back(glm::vec3(0.0));
-                neighborCount.push_back(1);
-            }
+        for(size_t i=0; i<indexVector.size(); i++)
+        {
+            normal_map[indexVector[i].a - 1] /= neighborCount_map[indexVector[i].a - 1];
+            normal_map[indexVector[i].b - 1] /= neighborCount_map[indexVector[i].b - 1];
+            normal_map[indexVector[i].c - 1] /= neighborCount_map[indexVector[i].c - 1];     
+        }
 
-            for(size_t i=0; i<indexVector.size(); i++)
-            {
-                glm::vec3 a = _vertexData[indexVector[i].a + vertexOffset - 1];
-                glm::vec3 b = _vertexData[indexVector[i].b + vertexOffset - 1];
-                glm::vec3 c = _vertexData[indexVector[i].c + vertexOffset - 1];            
+        // Scene vertex indices are remapped to a compact per mesh vertex buffer
+        std::unordered_map<int, int> localIndex_map;
+        auto localIndex = [&](int index) -> int
+        {
+            auto it = localIndex_map.find(index);
+            if(it != localIndex_map.end())
+                return it->second;
 
-                glm::vec3 ba = (b-a);
-                glm::vec3 ca = (c-a); 
+            glm::vec2 texCoord(0.0f);
+            if(_texCoordData.size() > index + textureOffset - 1)
+                texCoord = _texCoordData[index + textureOffset - 1];
 
-                
-                if(ba == glm::vec3(0.0))               
-                    ba = glm::vec3(0.0001, 0.0001, 0.0001);
+            int local = geometry->AddVertex(_vertexData[index + vertexOffset - 1], normal_map[index - 1], texCoord);
+            localIndex_map[index] = local;
+            return local;
+        };
 
-                if(ca == glm::vec3(0.0))
-                    ca = glm::vec3(-0.0001, 0.0001, 0.0001);
+        for(size_t i=0; i<indexVector.size(); i++)
+        {
+            int a = localIndex(indexVector[i].a);
+            int b = localIndex(indexVector[i].b);
+            int c = localIndex(indexVector[i].c);
 
-                if(ba == ca)
-                    ca = glm::vec3(0.00001, 0.00001, 0.00001);
+            geometry->AddFace(a, b, c);
+        }
+    }
 
-                glm::vec3 normal = glm::normalize(glm::cross((ba), (ca)));
+    if(worldTransform != glm::mat4(1.0f))
+        geometry->Transform(worldTransform);
 
+    return geometry;
+}
 
+// Reads the mesh geometry and builds its BVH. With the BVH cache enabled both
+// are looked up first, keyed by the PLY file contents or the inline geometry
+// and the build settings, so cached PLY files are not parsed at all. Baked
+// geometry is keyed by its world space vertices, or by the file and the
+// transform for PLY files.
+inline BVH* SceneReadMeshBVH(tinyxml2::XMLElement* facesElement, const std::vector<glm::vec3>& _vertexData, const std::vector<glm::vec2>& _texCoordData, const BVHSettings& settings, const glm::mat4& worldTransform, MeshGeometry*& geometry)
+{
+    if(!settings.cache)
+    {
+        geometry = SceneReadMeshGeometry(facesElement, _vertexData, _texCoordData, worldTransform);
+        return new BVH(geometry, settings);
+    }
 
-                normals[indexVector[i].a + vertexOffset - 1] += normal;
-                normals[indexVector[i].b + vertexOffset - 1] += normal;
-                normals[indexVector[i].c + vertexOffset - 1] += normal;
+    uint64_t sourceHash;
+    if(facesElement->Attribute("plyFile"))
+    {
+        geometry = nullptr;
+        sourceHash = BVHCacheFileHash(std::string(ROOT_DIR) + "assets/scenes/" + std::string(facesElement->Attribute("plyFile")));
+        if(worldTransform != glm::mat4(1.0f))
+            sourceHash = BVHCacheHash(&worldTransform, sizeof(glm::mat4), sourceHash);
+    }
+    else
+    {
+        geometry = SceneReadMeshGeometry(facesElement, _vertexData, _texCoordData, worldTransform);
+        sourceHash = BVHCacheGeometryHash(*geometry);
+    }
 
-                normal_map[indexVector[i].a - 1] += normal;
-                normal_map[indexVector[i].b - 1] += normal;
-                normal_map[indexVector[i].c - 1] += normal;                
+    uint64_t key = BVHCacheKey(sourceHash, settings);
+    std::string path = BVHCachePath(settings.cacheDirectory, key);
 
-                neighborCount[indexVector[i].a + vertexOffset - 1] += 1;
-                neighborCount[indexVector[i].b + vertexOffset - 1] += 1;
-                neighborCount[indexVector[i].c + vertexOffset - 1] += 1;
+    MeshGeometry* cachedGeometry = new MeshGeometry();
+    std::vector<BVHNode> nodes;
+    std::vector<int> primitiveIndices;
+    if(BVHCacheLoad(path, key, *cachedGeometry, nodes, primitiveIndices))
+    {
+        delete geometry;
+        geometry = cachedGeometry;
+        return new BVH(geometry, settings, nodes, primitiveIndices);
+    }
+    delete cachedGeometry;
 
-                neighborCount_map[indexVector[i].a - 1] += 1;
-                neighborCount_map[indexVector[i].b - 1] += 1;
-                neighborCount_map[indexVector[i].c - 1] += 1;                              
-            }
+    if(!geometry)
+        geometry = SceneReadMeshGeometry(facesElement, _vertexData, _texCoordData, worldTransform);
 
-            for(size_t i=0; i<indexVector.size(); i++)
-            {
-                normals[indexVector[i].a + vertexOffset - 1] /= neighborCount[indexVector[i].a + vertexOffset - 1];
-                normals[indexVector[i].b + vertexOffset - 1] /= neighborCount[indexVector[i].b + vertexOffset - 1];
-                normals[indexVector[i].c + vertexOffset - 1] /= neighborCount[indexVector[i].c + vertexOffset - 1];
-
-                normal_map[indexVector[i].a - 1] /= neighborCount_map[indexVector[i].a - 1];
-                normal_map[indexVector[i].b - 1] /= neighborCount_map[indexVector[i].b - 1];
-                normal_map[indexVector[i].c - 1] /= neighborCount_map[indexVector[i].c - 1];     
-      
-            }
+    BVH* bvh = new BVH(geometry, settings);
+    BVHCacheStore(path, key, *geometry, bvh->nodes, bvh->primitiveIndices);
 
+    return bvh;
+}
 
-            for(size_t i=0; i<indexVector.size(); i++)
-            {
+inline void SceneReadMeshes(tinyxml2::XMLNode* root, const BVHSettings& _bvhSettings, std::vector<Mesh>& _meshes, std::vector<Texture*>& _textures, std::vector<glm::vec3>& _vertexData, std::vector<glm::vec2>& _texCoordData, std::vector<glm::mat4>& _rotationMatrices, std::vector<glm::mat4>& _scalingMatrices, std::vector<glm::mat4>& _translationMatrices, std::vector<glm::mat4>& _compositeMatrices)
+{
+    std::stringstream stream;
+    // Get Meshes
+    auto element = root->FirstChildElement("Objects");
 
-                glm::vec3 a = _vertexData[indexVector[i].a + vertexOffset - 1];
-                glm::vec3 b = _vertexData[indexVector[i].b + vertexOffset - 1];                
-                glm::vec3 c = _vertexData[indexVector[i].c + vertexOffset - 1];                
+    std::set<int> instancedMeshIds;
+    auto instance = element->FirstChildElement("MeshInstance");
+    while(instance)
+    {
+        instancedMeshIds.insert(instance->IntAttribute("baseMeshId"));
+        instance = instance->NextSiblingElement("MeshInstance");
+    }
 
-                Triangle tri(a, b, c, normal_map[indexVector[i].a - 1], normal_map[indexVector[i].b - 1], normal_map[indexVector[i].c - 1]);
+    element = element->FirstChildElement("Mesh");
+    int meshId = 1;
 
-                if(_texCoordData.size() > indexVector[i].a + textureOffset - 1)
-                    tri.texCoordA = _texCoordData[indexVector[i].a + textureOffset - 1];
-                if(_texCoordData.size() > indexVector[i].b + textureOffset - 1)
-                    tri.texCoordB = _texCoordData[indexVector[i].b + textureOffset - 1];
-                if(_texCoordData.size() > indexVector[i].c + textureOffset - 1)
-                    tri.texCoordC = _texCoordData[indexVector[i].c + textureOffset - 1];
+    // Geometry and BVHs are read after the loop, a mesh per task on the pool
+    std::vector<tinyxml2::XMLElement*> facesElements;
+    std::vector<BVHSettings> meshSettings;
+    std::vector<glm::mat4> worldTransforms;
 
-                triangleList.push_back(tri);
-            }
-        }
-        stream.clear();
-        
-        Mesh m(triangleList, materialId - 1, softShading);
+    while(element)
+    {
+        bool softShading = false;
 
-        child = element->FirstChildElement("Textures");
-        if(child)
+        if(element->Attribute("shadingMode"))
         {
-            stream << child->GetText() << std::endl;
-            int texIndex;
-            while(!(stream >> texIndex).eof())
-            {
-                if(_textures[texIndex - 1]->mapType == MapType::BUMP_MAP)
-                {
-                    m.bumpMap = _textures[texIndex - 1];
-                }
-                else if(_textures[texIndex - 1]->mapType == MapType::DIFFUSE_MAP)
-                {
-                    m.diffuseMap = _textures[texIndex - 1];
-                }
-                else if(_textures[texIndex - 1]->mapType == MapType::EMISSION_MAP)
-                {
-                    m.emissionMap = _textures[texIndex - 1];
-                }
-                else if(_textures[texIndex - 1]->mapType == MapType::NORMAL_MAP)
-                {
-                    m.normalMap = _textures[texIndex - 1];
-                }
-                else if(_textures[texIndex - 1]->mapType == MapType::ROUGHNESS_MAP)
-                {
-                    m.roughnessMap = _textures[texIndex - 1];
-                }
-                else if(_textures[texIndex - 1]->mapType == MapType::SPECULAR_MAP)
-                {
-                    m.specularMap = _textures[texIndex - 1];
-                }
-            }
+            if(std::strcmp(element->Attribute("shadingMode"), "smooth") == 0)
+                softShading = true;
         }
-        stream.clear();
 
+        size_t materialId;
+        auto child = element->FirstChildElement("Material");
+        stream << child->GetText() << std::endl;
+        stream >> materialId;
+
+
+        stream.clear();
+        
         child = element->FirstChildElement("MotionBlur");
         glm::vec3 motionBlurTranslationVector(0.0f);
         if(child)
@@ -1386,9 +1426,7 @@ inline void SceneReadMeshes(tinyxml2::XMLNode* root, std::vector<Mesh>& _meshes,
             stream << child->GetText() << std::endl;
             stream >> motionBlurTranslationVector.x >> motionBlurTranslationVector.y >> motionBlurTranslationVector.z;
         }
-
-        m.translationVector = motionBlurTranslationVector;
-
+        stream.clear();
 
         child = element->FirstChildElement("Transformations");
         glm::mat4 model(1.0f);        
@@ -1423,6 +1461,58 @@ inline void SceneReadMeshes(tinyxml2::XMLNode* root, std::vector<Mesh>& _meshes,
                 }
             }
         }
+
+        // Static meshes no instance refers to can be moved to world space
+        // once, their rays and normals then skip the model transform
+        glm::mat4 worldTransform(1.0f);
+        if(_bvhSettings.bakeTransforms && motionBlurTranslationVector == glm::vec3(0.0f) && !instancedMeshIds.count(meshId))
+        {
+            worldTransform = model;
+            model = glm::mat4(1.0f);
+        }
+
+        facesElements.push_back(element->FirstChildElement("Faces"));
+        meshSettings.push_back(SceneReadMeshBVHSettings(element, _bvhSettings));
+        worldTransforms.push_back(worldTransform);
+
+        Mesh m(nullptr, nullptr, materialId - 1, softShading);
+
+        child = element->FirstChildElement("Textures");
+        if(child)
+        {
+            stream << child->GetText() << std::endl;
+            int texIndex;
+            while(!(stream >> texIndex).eof())
+            {
+                if(_textures[texIndex - 1]->mapType == MapType::BUMP_MAP)
+                {
+                    m.bumpMap = _textures[texIndex - 1];
+                }
+                else if(_textures[texIndex - 1]->mapType == MapType::DIFFUSE_MAP)
+                {
+                    m.diffuseMap = _textures[texIndex - 1];
+                }
+                else if(_textures[texIndex - 1]->mapType == MapType::EMISSION_MAP)
+                {
+                    m.emissionMap = _textures[texIndex - 1];
+                }
+                else if(_textures[texIndex - 1]->mapType == MapType::NORMAL_MAP)
+                {
+                    m.normalMap = _textures[texIndex - 1];
+                }
+                else if(_textures[texIndex - 1]->mapType == MapType::ROUGHNESS_MAP)
+                {
+                    m.roughnessMap = _textures[texIndex - 1];
+                }
+                else if(_textures[texIndex - 1]->mapType == MapType::SPECULAR_MAP)
+                {
+                    m.specularMap = _textures[texIndex - 1];
+                }
+            }
+        }
+        stream.clear();
+
+        m.translationVector = motionBlurTranslationVector;
         m.transformationMatrix = model;
         m.transformationMatrixTransposed = glm::transpose(model);
         m.transformationMatrixInversed = glm::inverse(model);
@@ -1431,8 +1521,22 @@ inline void SceneReadMeshes(tinyxml2::XMLNode* root, std::vector<Mesh>& _meshes,
 
         stream.clear();
         element = element->NextSiblingElement("Mesh");
+        meshId++;
     }
     stream.clear();
+
+    auto readMeshes = [&](int start, int end)
+    {
+        for(int i=start; i<end; i++)
+        {
+            _meshes[i].bvhRoot = SceneReadMeshBVH(facesElements[i], _vertexData, _texCoordData, meshSettings[i], worldTransforms[i], _meshes[i].geometry);
+        }
+    };
+
+    if(_bvhSettings.pool)
+        _bvhSettings.pool->ParallelFor(0, _meshes.size(), 1, readMeshes);
+    else
+        readMeshes(0, _meshes.size());
 }
 
 inline void SceneReadMeshInstances(tinyxml2::XMLNode* root, std::vector<Mesh>& _meshes, std::vector<Texture*>& _textures, std::vector<MeshInstance>& _meshInstances, std::vector<glm::mat4>& _rotationMatrices, std::vector<glm::mat4>& _scalingMatrices, std::vector<glm::mat4>& _translationMatrices, std::vector<glm::mat4>& _compositeMatrices)
@@ -1972,7 +2076,7 @@ inline void ScenePopulateObjects(std::vector<Object*>& _objects, std::vector<Obj
 
 }
 
-inline void ScenePopulateLights(std::vector<Light*>& _lights,
+inline void ScenePopulateLights(std::vector<const Light*>& _lights,
                                 std::vector<PointLight>& _pointLights,
                                 std::vector<AreaLight>& _areaLights,
                                 std::vector<DirectionalLight>& _directionalLights,
@@ -2046,7 +2150,7 @@ inline OrthonormalBasis GiveOrthonormalBasis(glm::vec3 vector)
 }
 
 
-inline void SceneReadLightMeshes(tinyxml2::XMLNode* root, std::vector<LightMesh>& _lightMeshes, std::vector<Texture*>& _textures, std::vector<glm::vec3>& _vertexData, std::vector<glm::vec2>& _texCoordData, std::vector<glm::mat4>& _rotationMatrices, std::vector<glm::mat4>& _scalingMatrices, std::vector<glm::mat4>& _translationMatrices, std::vector<glm::mat4>& _compositeMatrices)
+inline void SceneReadLightMeshes(tinyxml2::XMLNode* root, const BVHSettings& _bvhSettings, std::vector<LightMesh>& _lightMeshes, std::vector<Texture*>& _textures, std::vector<glm::vec3>& _vertexData, std::vector<glm::vec2>& _texCoordData, std::vector<glm::mat4>& _rotationMatrices, std::vector<glm::mat4>& _scalingMatrices, std::vector<glm::mat4>& _translationMatrices, std::vector<glm::mat4>& _compositeMatrices)
 {
     std::stringstream stream;
     // Get Meshes
@@ -2073,336 +2177,10 @@ inline void SceneReadLightMeshes(tinyxml2::XMLNode* root, std::vector<LightMesh>
         stream.clear();
         
         child = element->FirstChildElement("Faces");
-        stream << child->GetText() << std::endl;
-
-        std::vector<Triangle> triangleList;
-        std::vector<glm::vec3> normals;
-        std::vector<int> neighborCount;
-
-        if(child->Attribute("plyFile"))
-        {
-            bool normalsExist = false;
-            bool textureCoordsExist = false;
-
-            const char* localPath = child->Attribute("plyFile");
-            std::string path = std::string(ROOT_DIR) + "assets/scenes/" + std::string(localPath);
-
-            happly::PLYData plyIn(path);
-
-            std::vector<std::array<double, 3>> vPos = plyIn.getVertexPositions();
-            std::vector<std::string> xasd = plyIn.getElement("vertex").getPropertyNames();
-
-            std::vector<float> nx,ny,nz,u,v;
-
-            if(plyIn.getElement("vertex").hasProperty("nx") && plyIn.getElement("vertex").hasProperty("ny") && plyIn.getElement("vertex").hasProperty("nz"))
-            {
-                nx = plyIn.getElement("vertex").getProperty<float>(std::string("nx"));
-                ny = plyIn.getElement("vertex").getProperty<float>(std::string("ny"));
-                nz = plyIn.getElement("vertex").getProperty<float>(std::string("nz"));
-                normalsExist = true;
-            }
-            else
-            {
-                normalsExist = false;
-            }
-
-            if(plyIn.getElement("vertex").hasProperty("u") && plyIn.getElement("vertex").hasProperty("v"))
-            {
-                u = plyIn.getElement("vertex").getProperty<float>(std::string("u"));
-                v = plyIn.getElement("vertex").getProperty<float>(std::string("v"));
-                textureCoordsExist = true;
-            }
-            else
-            {
-                textureCoordsExist = false;
-            }
-            
-            
-            std::vector<std::vector<size_t>> fInd = plyIn.getFaceIndices<size_t>();
-
-
-            if(!normalsExist)
-            {
-                for(size_t i=0; i<vPos.size(); i++)
-                {
-                    normals.push_back(glm::vec3(0.0));
-                    neighborCount.push_back(0);
-                }
-
-                for(size_t i=0; i<fInd.size(); i++)
-                {
-                    glm::vec3 a,b,c;
-
-                    a.x = vPos[fInd[i][0]][0];
-                    a.y = vPos[fInd[i][0]][1];
-                    a.z = vPos[fInd[i][0]][2];
-
-                    b.x = vPos[fInd[i][1]][0];
-                    b.y = vPos[fInd[i][1]][1];
-                    b.z = vPos[fInd[i][1]][2];                                
-
-                    c.x = vPos[fInd[i][2]][0];
-                    c.y = vPos[fInd[i][2]][1];
-                    c.z = vPos[fInd[i][2]][2];
-
-                    glm::vec3 normal = glm::normalize(glm::cross((b-a), (c-a)));
-
-                    normals[fInd[i][0]] += normal;
-                    neighborCount[fInd[i][0]] += 1;
-
-                    normals[fInd[i][1]] += normal;
-                    neighborCount[fInd[i][1]] += 1;
-
-                    normals[fInd[i][2]] += normal;
-                    neighborCount[fInd[i][2]] += 1;                                
-
-                }
-
-                for(size_t i=0; i<normals.size(); i++)
-                {
-                    normals[i] /= neighborCount[i];
-                }
-            }
-
-
-            // TODO: SONRA BAK
-
-            for(size_t i=0; i<fInd.size(); i++)
-            {
-                glm::vec3 a,b,c;
-
-                if(fInd[i].size() == 3)
-                {
-                    a.x = vPos[fInd[i][0]][0];
-                    a.y = vPos[fInd[i][0]][1];
-                    a.z = vPos[fInd[i][0]][2];
-
-                    b.x = vPos[fInd[i][1]][0];
-                    b.y = vPos[fInd[i][1]][1];
-                    b.z = vPos[fInd[i][1]][2];                                
-
-                    c.x = vPos[fInd[i][2]][0];
-                    c.y = vPos[fInd[i][2]][1];
-                    c.z = vPos[fInd[i][2]][2];
-
-                    if(!normalsExist)
-                    {
-                        Triangle tri(a, b, c, normals[fInd[i][0]], normals[fInd[i][1]], normals[fInd[i][2]]);
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }
-                    else
-                    {
-                        Triangle tri(a, b, c, glm::vec3(nx[fInd[i][0]], ny[fInd[i][0]], nz[fInd[i][0]]),
-                                              glm::vec3(nx[fInd[i][1]], ny[fInd[i][1]], nz[fInd[i][1]]),
-                                              glm::vec3(nx[fInd[i][2]], ny[fInd[i][2]], nz[fInd[i][2]]));
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }
-
-                    
-
-                }
-                else if(fInd[i].size() == 4)
-                {
-                    a.x = vPos[fInd[i][0]][0];
-                    a.y = vPos[fInd[i][0]][1];
-                    a.z = vPos[fInd[i][0]][2];
-
-                    b.x = vPos[fInd[i][1]][0];
-                    b.y = vPos[fInd[i][1]][1];
-                    b.z = vPos[fInd[i][1]][2];                                
-
-                    c.x = vPos[fInd[i][2]][0];
-                    c.y = vPos[fInd[i][2]][1];
-                    c.z = vPos[fInd[i][2]][2];
-
-                    if(!normalsExist)
-                    {
-                        Triangle tri(a, b, c, normals[fInd[i][0]], normals[fInd[i][1]], normals[fInd[i][2]]);
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }
-                    else
-                    {
-                        Triangle tri(a, b, c, glm::vec3(nx[fInd[i][0]], ny[fInd[i][0]], nz[fInd[i][0]]),
-                                              glm::vec3(nx[fInd[i][1]], ny[fInd[i][1]], nz[fInd[i][1]]),
-                                              glm::vec3(nx[fInd[i][2]], ny[fInd[i][2]], nz[fInd[i][2]]));
-                        if(textureCoordsExist)
-                        {
-                            tri.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri.texCoordB = glm::vec2(u[fInd[i][1]], v[fInd[i][1]]);
-                            tri.texCoordC = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);                                                        
-                        }
-                        triangleList.push_back(tri);                        
-                    }                    
-
-                    b.x = vPos[fInd[i][2]][0];
-                    b.y = vPos[fInd[i][2]][1];
-                    b.z = vPos[fInd[i][2]][2];                                
-
-                    c.x = vPos[fInd[i][3]][0];
-                    c.y = vPos[fInd[i][3]][1];
-                    c.z = vPos[fInd[i][3]][2];
-
-                    if(!normalsExist)
-                    {
-                        Triangle tri2(a, b, c, normals[fInd[i][0]], normals[fInd[i][2]], normals[fInd[i][3]]);
-                        if(textureCoordsExist)
-                        {
-                            tri2.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri2.texCoordB = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);
-                            tri2.texCoordC = glm::vec2(u[fInd[i][3]], v[fInd[i][3]]);                                                        
-                        }
-                        triangleList.push_back(tri2);                        
-                    }
-                    else
-                    {
-                        Triangle tri2(a, b, c, glm::vec3(nx[fInd[i][0]], ny[fInd[i][0]], nz[fInd[i][0]]),
-                                               glm::vec3(nx[fInd[i][2]], ny[fInd[i][2]], nz[fInd[i][2]]),
-                                               glm::vec3(nx[fInd[i][3]], ny[fInd[i][3]], nz[fInd[i][3]]));
-                        if(textureCoordsExist)
-                        {
-                            tri2.texCoordA = glm::vec2(u[fInd[i][0]], v[fInd[i][0]]);
-                            tri2.texCoordB = glm::vec2(u[fInd[i][2]], v[fInd[i][2]]);
-                            tri2.texCoordC = glm::vec2(u[fInd[i][3]], v[fInd[i][3]]);                                                        
-                        }
-                        triangleList.push_back(tri2);                        
-                    }
-
-                }              
-                
-            }
-
-        }
-        else
-        {
-            Indices indices;
-
-            std::vector<Indices> indexVector;
-
-            int vertexOffset = 0;
-            int textureOffset = 0;
-            
-            if(child->Attribute("vertexOffset"))
-                vertexOffset = std::stoi(child->Attribute("vertexOffset"));
-            if(child->Attribute("textureOffset"))
-                textureOffset = std::stoi(child->Attribute("textureOffset"));
-
-            std::unordered_map<int, glm::vec3> normal_map;
-            std::unordered_map<int, int> neighborCount_map;
-
-            while(!(stream >> indices.a).eof())
-            {
-                stream >> indices.b >> indices.c;
-
-                normal_map[indices.a - 1] = glm::vec3(0.0f);
-                normal_map[indices.b - 1] = glm::vec3(0.0f);
-                normal_map[indices.c - 1] = glm::vec3(0.0f);
-
-                neighborCount_map[indices.a -1] = 1;
-                neighborCount_map[indices.b -1] = 1;
-                neighborCount_map[indices.c -1] = 1;
-
-                indexVector.push_back(indices);
-            }
-
-            for(size_t i=0; i<_vertexData.size(); i++)
-            {
-                normals.push_back(glm::vec3(0.0));
-                neighborCount.push_back(1);
-            }
-
-            for(size_t i=0; i<indexVector.size(); i++)
-            {
-                glm::vec3 a = _vertexData[indexVector[i].a + vertexOffset - 1];
-                glm::vec3 b = _vertexData[indexVector[i].b + vertexOffset - 1];
-                glm::vec3 c = _vertexData[indexVector[i].c + vertexOffset - 1];            
-
-                glm::vec3 ba = (b-a);
-                glm::vec3 ca = (c-a); 
-
-                
-                if(ba == glm::vec3(0.0))               
-                    ba = glm::vec3(0.0001, 0.0001, 0.0001);
-
-                if(ca == glm::vec3(0.0))
-                    ca = glm::vec3(-0.0001, 0.0001, 0.0001);
-
-                if(ba == ca)
-                    ca = glm::vec3(0.00001, 0.00001, 0.00001);
-
-                glm::vec3 normal = glm::normalize(glm::cross((ba), (ca)));
-
-
-
-                normals[indexVector[i].a + vertexOffset - 1] += normal;
-                normals[indexVector[i].b + vertexOffset - 1] += normal;
-                normals[indexVector[i].c + vertexOffset - 1] += normal;
-
-                normal_map[indexVector[i].a - 1] += normal;
-                normal_map[indexVector[i].b - 1] += normal;
-                normal_map[indexVector[i].c - 1] += normal;                
-
-                neighborCount[indexVector[i].a + vertexOffset - 1] += 1;
-                neighborCount[indexVector[i].b + vertexOffset - 1] += 1;
-                neighborCount[indexVector[i].c + vertexOffset - 1] += 1;
-
-                neighborCount_map[indexVector[i].a - 1] += 1;
-                neighborCount_map[indexVector[i].b - 1] += 1;
-                neighborCount_map[indexVector[i].c - 1] += 1;                              
-            }
-
-            for(size_t i=0; i<indexVector.size(); i++)
-            {
-                normals[indexVector[i].a + vertexOffset - 1] /= neighborCount[indexVector[i].a + vertexOffset - 1];
-                normals[indexVector[i].b + vertexOffset - 1] /= neighborCount[indexVector[i].b + vertexOffset - 1];
-                normals[indexVector[i].c + vertexOffset - 1] /= neighborCount[indexVector[i].c + vertexOffset - 1];
-
-                normal_map[indexVector[i].a - 1] /= neighborCount_map[indexVector[i].a - 1];
-                normal_map[indexVector[i].b - 1] /= neighborCount_map[indexVector[i].b - 1];
-                normal_map[indexVector[i].c - 1] /= neighborCount_map[indexVector[i].c - 1];     
-      
-            }
-
-
-            for(size_t i=0; i<indexVector.size(); i++)
-            {
-
-                glm::vec3 a = _vertexData[indexVector[i].a + vertexOffset - 1];
-                glm::vec3 b = _vertexData[indexVector[i].b + vertexOffset - 1];                
-                glm::vec3 c = _vertexData[indexVector[i].c + vertexOffset - 1];                
-
-                Triangle tri(a, b, c, normal_map[indexVector[i].a - 1], normal_map[indexVector[i].b - 1], normal_map[indexVector[i].c - 1]);
-
-                if(_texCoordData.size() > indexVector[i].a + textureOffset - 1)
-                    tri.texCoordA = _texCoordData[indexVector[i].a + textureOffset - 1];
-                if(_texCoordData.size() > indexVector[i].b + textureOffset - 1)
-                    tri.texCoordB = _texCoordData[indexVector[i].b + textureOffset - 1];
-                if(_texCoordData.size() > indexVector[i].c + textureOffset - 1)
-                    tri.texCoordC = _texCoordData[indexVector[i].c + textureOffset - 1];
-
-                triangleList.push_back(tri);
-            }
-        }
-        stream.clear();
+        MeshGeometry* geometry;
+        BVH* bvh = SceneReadMeshBVH(child, _vertexData, _texCoordData, SceneReadMeshBVHSettings(element, _bvhSettings), glm::mat4(1.0f), geometry);
         
-        LightMesh m(triangleList, materialId - 1, softShading);
+        LightMesh m(geometry, bvh, materialId - 1, softShading);
 
         child = element->FirstChildElement("Textures");
         if(child)
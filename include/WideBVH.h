@@ -0,0 +1,52 @@
+#ifndef __WIDE_BVH_H__
+#define __WIDE_BVH_H__
+
+#include <AABB.h>
+#include <BVHNodeBuilder.h>
+#include <Structures.h>
+#include <vector>
+#include <cstdint>
+
+// Node of an N-wide BVH. Child boxes are stored as structure of arrays so a
+// single SIMD slab test classifies all children of the node at once.
+template<int N>
+struct alignas(32) WideBVHNode
+{
+    float bounds[2][3][N];  // [min/max corner][axis][child]
+    int child[N];           // interior child: node index, leaf child: first entry in primitiveIndices
+    uint16_t count[N];      // primitives in a leaf child, 0 for interior and unused children
+    int childCount;
+};
+
+// Traversal stack entry, count > 0 marks a leaf
+struct WideBVHStackEntry
+{
+    int index;
+    int count;
+    float distance;
+};
+
+// Built by collapsing a binary BVH, leaves keep referencing the binary
+// BVH's primitiveIndices array.
+template<int N>
+class WideBVH
+{
+private:
+    int collapse(const std::vector<BVHNode>& binaryNodes, int binaryIndex);
+
+public:
+    std::vector<WideBVHNode<N>> nodes;
+
+    WideBVH();
+    WideBVH(const std::vector<BVHNode>& binaryNodes);
+
+    // Returns a bit mask of the children whose boxes are entered in (t0, t1),
+    // entry distances are written to distances
+    static int IntersectChildren(const WideBVHNode<N>& node, const Ray& ray, float t0, float t1, float* distances);
+
+    // Hit children of a node ordered by entry distance, nearest first
+    static int SortedHits(const WideBVHNode<N>& node, const Ray& ray, float t0, float t1, WideBVHStackEntry* hits);
+};
+
+
+#endif
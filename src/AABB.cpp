@@ -1,151 +1,68 @@
 #include <AABB.h>
 
 
-AABB::AABB(const std::vector<Triangle>& triangleList)
+AABB::AABB()
 {
+    bounds[0] = glm::vec3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+    bounds[1] = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+void AABB::Extend(const glm::vec3& point)
+{
+    bounds[0].x = std::min(bounds[0].x, point.x);
+    bounds[0].y = std::min(bounds[0].y, point.y);
+    bounds[0].z = std::min(bounds[0].z, point.z);
 
-    this->xmin = FLT_MAX;
-    this->ymin = FLT_MAX;
-    this->zmin = FLT_MAX;
-
-    this->xmax = -FLT_MAX;
-    this->ymax = -FLT_MAX;
-    this->zmax = -FLT_MAX;
-
-
-    for(size_t i=0; i<triangleList.size(); i++)
-    {
-        float ax = triangleList[i].a.x;
-        float bx = triangleList[i].b.x;
-        float cx = triangleList[i].c.x;
-
-        float ay = triangleList[i].a.y;
-        float by = triangleList[i].b.y;
-        float cy = triangleList[i].c.y;
-
-        float az = triangleList[i].a.z;
-        float bz = triangleList[i].b.z;
-        float cz = triangleList[i].c.z;
-
-            if(ax < xmin)
-            {
-                xmin = ax;
-            }
-            if(ax > xmax)
-            {
-                xmax = ax;
-            }
-
-            if(bx < xmin)
-            {
-                xmin = bx;
-            }
-            if(bx > xmax)
-            {
-                xmax = bx;
-            }
-
-            if(cx < xmin)
-            {
-                xmin = cx;
-            }
-            if(cx > xmax)
-            {
-                xmax = cx;
-            }
-
-        // --------------------------- //
-
-
-            if(ay < ymin)
-            {
-                ymin = ay;
-            }
-            if(ay > ymax)
-            {
-                ymax = ay;
-            }
-
-            if(by < ymin)
-            {
-                ymin = by;
-            }
-            if(by > ymax)
-            {
-                ymax = by;
-            }
-
-            if(cy < ymin)
-            {
-                ymin = cy;
-            }
-            if(cy > ymax)
-            {
-                ymax = cy;
-            }
-
-        // ------------------------ //
-
-
-            if(az < zmin)
-            {
-                zmin = az;
-            }
-            if(az > zmax)
-            {
-                zmax = az;
-            }
-
-            if(bz < zmin)
-            {
-                zmin = bz;
-            }
-            if(bz > zmax)
-            {
-                zmax = bz;
-            }
-
-            if(cz < zmin)
-            {
-                zmin = cz;
-            }
-            if(cz > zmax)
-            {
-                zmax = cz;
-            }         
-
-    }
-
-    bounds[0] = glm::vec3(xmin, ymin, zmin);
-    bounds[1] = glm::vec3(xmax, ymax, zmax);
+    bounds[1].x = std::max(bounds[1].x, point.x);
+    bounds[1].y = std::max(bounds[1].y, point.y);
+    bounds[1].z = std::max(bounds[1].z, point.z);
+}
+
+void AABB::Extend(const AABB& box)
+{
+    bounds[0].x = std::min(bounds[0].x, box.bounds[0].x);
+    bounds[0].y = std::min(bounds[0].y, box.bounds[0].y);
+    bounds[0].z = std::min(bounds[0].z, box.bounds[0].z);
 
+    bounds[1].x = std::max(bounds[1].x, box.bounds[1].x);
+    bounds[1].y = std::max(bounds[1].y, box.bounds[1].y);
+    bounds[1].z = std::max(bounds[1].z, box.bounds[1].z);
 }
 
-bool AABB::Intersect(const Ray& r)
+float AABB::SurfaceArea() const
 {
-    float t1 = (xmin - r.origin.x)*r.invDirection.x;
-	float t2 = (xmax - r.origin.x)*r.invDirection.x;
+    if(bounds[0].x > bounds[1].x)
+        return 0.0f;
+
+    glm::vec3 extent = bounds[1] - bounds[0];
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool AABB::Intersect(const Ray& r) const
+{
+    float t1 = (bounds[0].x - r.origin.x)*r.invDirection.x;
+	float t2 = (bounds[1].x - r.origin.x)*r.invDirection.x;
 
 	float tMin = std::min(t1, t2);
 	float tMax = std::max(t1, t2);
 
-	t1 = (ymin - r.origin.y)*r.invDirection.y;
-	t2 = (ymax - r.origin.y)*r.invDirection.y;
+	t1 = (bounds[0].y - r.origin.y)*r.invDirection.y;
+	t2 = (bounds[1].y - r.origin.y)*r.invDirection.y;
 
 	tMin = std::max(tMin, std::min(t1, t2));
 	tMax = std::min(tMax, std::max(t1, t2));
 
-	t1 = (zmin - r.origin.z)*r.invDirection.z;
-	t2 = (zmax - r.origin.z)*r.invDirection.z;
+	t1 = (bounds[0].z - r.origin.z)*r.invDirection.z;
+	t2 = (bounds[1].z - r.origin.z)*r.invDirection.z;
 
 	tMin = std::max(tMin, std::min(t1, t2));
-	tMax = std::min(tMax, std::max(t1, t2));	
+	tMax = std::min(tMax, std::max(t1, t2));
 
 	return tMax >= std::max(tMin, 0.0f);
 }
 
 
-bool AABB::Intersect2(const Ray& r, float t0, float t1)
+bool AABB::Intersect2(const Ray& r, float t0, float t1) const
 {
     float tmin, tmax, tymin, tymax, tzmin, tzmax;
 
@@ -36,7 +36,7 @@ AreaLight::AreaLight(glm::vec3 position, glm::vec3 radiance, glm::vec3 normal, f
 
 bool AreaLight::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                       const IntersectionReport& report, bool backfaceCulling,
-                                      float time, std::vector<Object *>& objectPointerVector)
+                                      float time, TopLevelBVH& topLevelBVH) const
 {
     glm::vec3 direction = glm::normalize(position - report.intersection);
     glm::vec3 origin    = report.intersection + shadowRayEpsilon*report.normal;
@@ -46,29 +46,22 @@ bool AreaLight::ShadowRayIntersection(float tmin, float tmax, float intersection
 
     float dist = glm::length(position - report.intersection);
 
-    for(auto object : objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling) && r.d < dist)
-            return true;
-    }
-
-    return false;
+    return topLevelBVH.Occluded(ray, tmin, std::min(tmax, dist), intersectionTestEpsilon, backfaceCulling);
 }
 
 
 glm::vec3 AreaLight::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                             const float& phongExponent, const IntersectionReport& report,
                                             float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                            bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                                            bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
 {
     glm::vec3 result = glm::vec3(0.0);
 
-    float randomOffsetU = areaLightPositionGenerator->Generate();
-    float randomOffsetV = areaLightPositionGenerator->Generate();
+    float randomOffsetU, randomOffsetV;
+    areaLightPositionGenerator->Generate2D(randomOffsetU, randomOffsetV);
     glm::vec3 randomPoint = position + extent*(randomOffsetU*u + randomOffsetV*v);
 
-    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, objectPointerVector))
+    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, topLevelBVH))
     {
         return glm::vec3(0.0);
     }
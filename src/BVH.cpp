@@ -1,254 +1,423 @@
 #include <BVH.h>
 
 
-
-SplittedTriangles BVH::splitMidpoint(const std::vector<Triangle>& triangleList, int axis)
+BVH::BVH(const MeshGeometry* geometry, const BVHSettings& settings) : geometry(geometry), settings(settings), width(settings.width)
 {
-    SplittedTriangles splittedResult;
-
-    glm::vec3 totalVec(0.0, 0.0, 0.0);
-    std::vector<VertexIndex> vivec;
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-    for(size_t i=0; i<triangleList.size(); i++)
+    std::vector<AABB> primitiveBounds(geometry->FaceCount());
+    std::vector<glm::vec3> centroids(geometry->FaceCount());
+    for(size_t i=0; i<geometry->FaceCount(); i++)
     {
-        glm::vec3 v = triangleList[i].GiveCenter();
-        totalVec += v;
+        primitiveBounds[i] = geometry->FaceBounds(i);
+        centroids[i] = geometry->FaceCenter(i);
+    }
 
-        VertexIndex vi;
-        vi.vertex = v;
-        vi.index  = i;
-        vivec.push_back(vi);
+    if(settings.builder == BVHBuilder::SBVH)
+    {
+        SBVHBuilder builder(*geometry, settings, nodes, primitiveIndices);
+        builder.Build();
     }
+    else
+    {
+        BVHNodeBuilder builder(primitiveBounds, centroids, settings, nodes, primitiveIndices);
+        builder.Build();
+    }
+
+    buildTraversalData();
+
+    buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+BVH::BVH(const MeshGeometry* geometry, const BVHSettings& settings, std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices) : geometry(geometry), settings(settings), width(settings.width)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    this->nodes.swap(nodes);
+    this->primitiveIndices.swap(primitiveIndices);
+
+    buildTraversalData();
+
+    buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+BVHStats BVH::Stats() const
+{
+    BVHStats stats = ComputeBVHStats(nodes, geometry->FaceCount(), primitiveIndices.size(), settings);
+    stats.memoryBytes += triangleBlocks.size() * sizeof(TriangleBlock) + leafBlockOffsets.size() * sizeof(int);
+    stats.memoryBytes += wideBVH4.nodes.size() * sizeof(WideBVHNode<4>) + wideBVH8.nodes.size() * sizeof(WideBVHNode<8>);
 
-    totalVec /= triangleList.size();
+    return stats;
+}
 
+void BVH::buildTraversalData()
+{
+    buildTriangleBlocks();
 
-    if(axis == 0)
+    if(width == 4)
+        wideBVH4 = WideBVH<4>(nodes);
+    else if(width == 8)
+        wideBVH8 = WideBVH<8>(nodes);
+}
+
+void BVH::buildTriangleBlocks()
+{
+    leafBlockOffsets.assign(primitiveIndices.size(), -1);
+
+    for(const BVHNode& node : nodes)
     {
-        for(size_t i=0; i<vivec.size(); i++)
+        if(node.primitiveCount == 0)
+            continue;
+
+        leafBlockOffsets[node.primitiveOffset] = triangleBlocks.size();
+        for(int i=0; i<node.primitiveCount; i++)
         {
-            if(vivec[i].vertex.x <= totalVec.x)
-            {
-                splittedResult.p1.push_back(triangleList[vivec[i].index]);
-            }
-            else
-            {
-                splittedResult.p2.push_back(triangleList[vivec[i].index]);
-            }
+            if(i % TRIANGLE_BLOCK_WIDTH == 0)
+                triangleBlocks.push_back(TriangleBlock());
+
+            triangleBlocks.back().SetLane(i % TRIANGLE_BLOCK_WIDTH, *geometry, primitiveIndices[node.primitiveOffset + i]);
         }
     }
-    else if(axis == 1)
+}
+
+// Tests the leaf block by block. Lanes are hit in any order, so every
+// accepted lane closer than the current hit replaces it.
+void BVH::intersectLeaf(int offset, int count, const Ray& ray, const WatertightRay& watertightRay, float tmin, float& closest, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling, TriangleHit& hit) const
+{
+    alignas(32) float t[TRIANGLE_BLOCK_WIDTH];
+    alignas(32) float beta[TRIANGLE_BLOCK_WIDTH];
+    alignas(32) float gamma[TRIANGLE_BLOCK_WIDTH];
+
+    int firstBlock = leafBlockOffsets[offset];
+    int blockCount = (count + TRIANGLE_BLOCK_WIDTH - 1) / TRIANGLE_BLOCK_WIDTH;
+
+    for(int b=firstBlock; b<firstBlock + blockCount; b++)
     {
-        for(size_t i=0; i<vivec.size(); i++)
+        const TriangleBlock& block = triangleBlocks[b];
+
+        int mask = settings.watertight ? block.IntersectWatertight(watertightRay, tmin, closest, t, beta, gamma)
+                                       : block.Intersect(ray, tmin, closest, intersectionTestEpsilon, t, beta, gamma);
+        for(int lane=0; mask; lane++, mask >>= 1)
         {
-            if(vivec[i].vertex.y <= totalVec.y)
-            {
-                splittedResult.p1.push_back(triangleList[vivec[i].index]);                }
-            else
-            {
-                splittedResult.p2.push_back(triangleList[vivec[i].index]);
-            }
+            if(!(mask & 1) || t[lane] >= closest)
+                continue;
+
+            if(backfaceCulling && geometry->IsBackfacing(block.face[lane], ray, beta[lane], gamma[lane], softShadingFlag))
+                continue;
+
+            closest   = t[lane];
+            hit.face  = block.face[lane];
+            hit.t     = t[lane];
+            hit.beta  = beta[lane];
+            hit.gamma = gamma[lane];
         }
     }
-    else if(axis == 2)
+}
+
+bool BVH::occludedLeaf(int offset, int count, const Ray& ray, const WatertightRay& watertightRay, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const
+{
+    alignas(32) float t[TRIANGLE_BLOCK_WIDTH];
+    alignas(32) float beta[TRIANGLE_BLOCK_WIDTH];
+    alignas(32) float gamma[TRIANGLE_BLOCK_WIDTH];
+
+    int firstBlock = leafBlockOffsets[offset];
+    int blockCount = (count + TRIANGLE_BLOCK_WIDTH - 1) / TRIANGLE_BLOCK_WIDTH;
+
+    for(int b=firstBlock; b<firstBlock + blockCount; b++)
     {
-        for(size_t i=0; i<vivec.size(); i++)
+        const TriangleBlock& block = triangleBlocks[b];
+
+        int mask = settings.watertight ? block.IntersectWatertight(watertightRay, tmin, tmax, t, beta, gamma)
+                                       : block.Intersect(ray, tmin, tmax, intersectionTestEpsilon, t, beta, gamma);
+        if(mask && !backfaceCulling)
+            return true;
+
+        for(int lane=0; mask; lane++, mask >>= 1)
         {
-            if(vivec[i].vertex.z <= totalVec.z)
-            {
-                splittedResult.p1.push_back(triangleList[vivec[i].index]);
-            }
-            else
-            {
-                splittedResult.p2.push_back(triangleList[vivec[i].index]);
-            }
+            if((mask & 1) && !geometry->IsBackfacing(block.face[lane], ray, beta[lane], gamma[lane], softShadingFlag))
+                return true;
         }
     }
 
-    return splittedResult;    
+    return false;
 }
 
+AABB BVH::Bounds() const
+{
+    if(nodes.empty())
+        return AABB();
 
-SplittedTriangles BVH::splitMidpoint(const std::vector<Triangle>& triangleList)
+    return nodes[0].box;
+}
+
+// Iterative closest hit traversal. The child on the near side of the split
+// plane is visited first and tmax shrinks to the closest hit found so far,
+// so boxes behind that hit are skipped.
+bool BVH::Intersect(const Ray& ray, TriangleHit& hit, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const
 {
-    SplittedTriangles splittedResult;
+    hit.face = -1;
 
-    float xlength = box.xmax - box.xmin;
-    float ylength = box.ymax - box.ymin;
-    float zlength = box.zmax - box.zmin;
+    if(width == 4)
+        return intersectWide(wideBVH4, ray, hit, tmin, tmax, intersectionTestEpsilon, softShadingFlag, backfaceCulling);
+    if(width == 8)
+        return intersectWide(wideBVH8, ray, hit, tmin, tmax, intersectionTestEpsilon, softShadingFlag, backfaceCulling);
 
-    glm::vec3 totalVec(0.0, 0.0, 0.0);
-    std::vector<VertexIndex> vivec;
+    if(nodes.empty())
+        return false;
 
-    for(size_t i=0; i<triangleList.size(); i++)
-    {
-        glm::vec3 v = triangleList[i].GiveCenter();
-        totalVec += v;
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIndex = 0;
 
-        VertexIndex vi;
-        vi.vertex = v;
-        vi.index  = i;
-        vivec.push_back(vi);
-    }
+    float closest = tmax;
+    WatertightRay watertightRay(ray);
+    TraversalCounter counter(traversalCounters.closestHit);
 
-    totalVec /= triangleList.size();
+    while(true)
+    {
+        const BVHNode& node = nodes[nodeIndex];
+        counter.nodes++;
 
-        if(xlength >= ylength && xlength >= zlength)
+        if(node.box.Intersect2(ray, tmin, closest))
         {
-            for(size_t i=0; i<vivec.size(); i++)
+            if(node.primitiveCount > 0)
             {
-                if(vivec[i].vertex.x <= totalVec.x)
-                {
-                    splittedResult.p1.push_back(triangleList[vivec[i].index]);
-                }
-                else
-                {
-                    splittedResult.p2.push_back(triangleList[vivec[i].index]);
-                }
+                counter.primitives += node.primitiveCount;
+                intersectLeaf(node.primitiveOffset, node.primitiveCount, ray, watertightRay, tmin, closest, intersectionTestEpsilon, softShadingFlag, backfaceCulling, hit);
             }
-        }
-        else if(ylength >= xlength && ylength >= zlength)
-        {
-            for(size_t i=0; i<vivec.size(); i++)
-            {
-                if(vivec[i].vertex.y <= totalVec.y)
-                {
-                    splittedResult.p1.push_back(triangleList[vivec[i].index]);
-                }
-                else
-                {
-                    splittedResult.p2.push_back(triangleList[vivec[i].index]);
-                }
-            }
-        }
-        else if(zlength >= ylength && zlength >= xlength)
-        {
-            for(size_t i=0; i<vivec.size(); i++)
+            else
             {
-                if(vivec[i].vertex.z <= totalVec.z)
+                // Left child holds the primitives with smaller centroids on the split axis
+                if(ray.sign[node.axis])
                 {
-                    splittedResult.p1.push_back(triangleList[vivec[i].index]);
+                    stack[stackSize++] = nodeIndex + 1;
+                    nodeIndex = node.secondChildOffset;
                 }
                 else
                 {
-                    splittedResult.p2.push_back(triangleList[vivec[i].index]);
+                    stack[stackSize++] = node.secondChildOffset;
+                    nodeIndex = nodeIndex + 1;
                 }
+                continue;
             }
         }
 
-        return splittedResult;    
+        if(stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize];
+    }
+
+    return hit.face >= 0;
 }
 
-BVH::BVH(const std::vector<Triangle>& triangleList, int depth, int maxdepth) : box(triangleList)
+// Packet version of the binary traversal above. Every stack entry keeps the
+// first ray that may still hit the node, rays before it missed an ancestor.
+// A node is skipped when the interval test rejects it for the whole packet
+// or no active ray hits its box, leaves test each remaining ray on its own.
+void BVH::IntersectPacket(const RayPacket& packet, int first, TriangleHit* hits, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const
 {
-    if(depth == maxdepth || triangleList.size() <= 1)
+    float closest[RAY_PACKET_SIZE];
+    for(int i=first; i<packet.count; i++)
     {
+        hits[i].face = -1;
+        closest[i] = std::min(tmax, packet.hits[i].t);
+    }
 
-        for(size_t i=0; i<triangleList.size(); i++)
-        {
-            this->primitives.push_back(triangleList[i]);
-        }
-
-        this->leftChild  = nullptr;
-        this->rightChild = nullptr;
-
+    if(!packet.coherent || width != 2)
+    {
+        for(int i=first; i<packet.count; i++)
+            Intersect(packet.rays[i], hits[i], tmin, closest[i], intersectionTestEpsilon, softShadingFlag, backfaceCulling);
         return;
     }
 
-    SplittedTriangles st = splitMidpoint(triangleList);
+    if(nodes.empty())
+        return;
+
+    int stack[BVH_STACK_SIZE];
+    int firstActive[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize] = 0;
+    firstActive[stackSize++] = first;
+
+    float farthest = 0.0f;
+    for(int i=first; i<packet.count; i++)
+        farthest = std::max(farthest, closest[i]);
+
+    TraversalCounter counter(traversalCounters.closestHit);
 
-    if(st.p1.empty() || st.p2.empty())
+    while(stackSize > 0)
     {
-        for(size_t i=0; i<triangleList.size(); i++)
+        stackSize--;
+        const BVHNode& node = nodes[stack[stackSize]];
+        int active = firstActive[stackSize];
+        counter.nodes++;
+
+        if(packet.Misses(node.box, tmin, farthest))
+            continue;
+
+        while(active < packet.count && !node.box.Intersect2(packet.rays[active], tmin, closest[active]))
+            active++;
+        if(active == packet.count)
+            continue;
+
+        if(node.primitiveCount > 0)
         {
-            this->primitives.push_back(triangleList[i]);
-        }
+            for(int i=active; i<packet.count; i++)
+            {
+                if(i > active && !node.box.Intersect2(packet.rays[i], tmin, closest[i]))
+                    continue;
 
-        this->leftChild  = nullptr;
-        this->rightChild = nullptr;
+                counter.primitives += node.primitiveCount;
+                WatertightRay watertightRay(packet.rays[i]);
+                intersectLeaf(node.primitiveOffset, node.primitiveCount, packet.rays[i], watertightRay, tmin, closest[i], intersectionTestEpsilon, softShadingFlag, backfaceCulling, hits[i]);
+            }
 
-        return;
-    }
+            farthest = 0.0f;
+            for(int i=first; i<packet.count; i++)
+                farthest = std::max(farthest, closest[i]);
+            continue;
+        }
 
-    this->leftChild = new BVH(st.p1, depth + 1, maxdepth);
-    this->rightChild = new BVH(st.p2, depth + 1, maxdepth);
+        int nodeIndex = &node - nodes.data();
+        if(packet.sign[node.axis])
+        {
+            stack[stackSize] = nodeIndex + 1;
+            firstActive[stackSize++] = active;
+            stack[stackSize] = node.secondChildOffset;
+            firstActive[stackSize++] = active;
+        }
+        else
+        {
+            stack[stackSize] = node.secondChildOffset;
+            firstActive[stackSize++] = active;
+            stack[stackSize] = nodeIndex + 1;
+            firstActive[stackSize++] = active;
+        }
+    }
 }
 
-BVH::BVH(const std::vector<Triangle>& triangleList, int depth, int maxdepth, int axis) : box(triangleList)
+// Any hit traversal for shadow rays, returns at the first accepted triangle
+bool BVH::Occluded(const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const
 {
-    if(depth == maxdepth || triangleList.size() <= 1)
+    if(width == 4)
+        return occludedWide(wideBVH4, ray, tmin, tmax, intersectionTestEpsilon, softShadingFlag, backfaceCulling);
+    if(width == 8)
+        return occludedWide(wideBVH8, ray, tmin, tmax, intersectionTestEpsilon, softShadingFlag, backfaceCulling);
+
+    if(nodes.empty())
+        return false;
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIndex = 0;
+    WatertightRay watertightRay(ray);
+    TraversalCounter counter(traversalCounters.shadow);
+
+    while(true)
     {
+        const BVHNode& node = nodes[nodeIndex];
+        counter.nodes++;
 
-        for(size_t i=0; i<triangleList.size(); i++)
+        if(node.box.Intersect2(ray, tmin, tmax))
         {
-            this->primitives.push_back(triangleList[i]);
+            if(node.primitiveCount > 0)
+            {
+                counter.primitives += node.primitiveCount;
+                if(occludedLeaf(node.primitiveOffset, node.primitiveCount, ray, watertightRay, tmin, tmax, intersectionTestEpsilon, softShadingFlag, backfaceCulling))
+                    return true;
+            }
+            else
+            {
+                stack[stackSize++] = node.secondChildOffset;
+                nodeIndex = nodeIndex + 1;
+                continue;
+            }
         }
 
-        this->leftChild  = nullptr;
-        this->rightChild = nullptr;
-
-        return;
+        if(stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize];
     }
 
-    SplittedTriangles st = splitMidpoint(triangleList);
+    return false;
+}
+
+// Closest hit traversal of the wide BVH. Hit children are pushed far to near
+// together with their entry distance, entries behind the closest hit so far
+// are dropped when popped.
+template<int N>
+bool BVH::intersectWide(const WideBVH<N>& wideBVH, const Ray& ray, TriangleHit& hit, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const
+{
+    if(wideBVH.nodes.empty())
+        return false;
 
-    if(st.p1.empty() || st.p2.empty())
+    WideBVHStackEntry stack[BVH_STACK_SIZE * N];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, tmin};
+
+    WideBVHStackEntry hits[N];
+    float closest = tmax;
+    WatertightRay watertightRay(ray);
+    TraversalCounter counter(traversalCounters.closestHit);
+
+    while(stackSize > 0)
     {
-        for(size_t i=0; i<triangleList.size(); i++)
+        const WideBVHStackEntry entry = stack[--stackSize];
+        if(entry.distance >= closest)
+            continue;
+
+        if(entry.count > 0)
         {
-            this->primitives.push_back(triangleList[i]);
+            counter.primitives += entry.count;
+            intersectLeaf(entry.index, entry.count, ray, watertightRay, tmin, closest, intersectionTestEpsilon, softShadingFlag, backfaceCulling, hit);
+            continue;
         }
 
-        this->leftChild  = nullptr;
-        this->rightChild = nullptr;
-
-        return;
+        counter.nodes++;
+        int hitCount = WideBVH<N>::SortedHits(wideBVH.nodes[entry.index], ray, tmin, closest, hits);
+        for(int i=hitCount - 1; i>=0; i--)
+            stack[stackSize++] = hits[i];
     }
 
-    this->leftChild = new BVH(st.p1, depth + 1, maxdepth, (axis+1)%3);
-    this->rightChild = new BVH(st.p2, depth + 1, maxdepth, (axis+1)%3);
+    return hit.face >= 0;
 }
 
-bool BVH::Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionTestEpslion, bool softShadingFlag, const glm::mat4& transformationMatrixTransposed, bool backfaceCulling)
+template<int N>
+bool BVH::occludedWide(const WideBVH<N>& wideBVH, const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, bool softShadingFlag, bool backfaceCulling) const
 {
-    bool boxTest = box.Intersect2(ray, tmin, tmax);
-
-    if(!boxTest)
+    if(wideBVH.nodes.empty())
         return false;
 
-    IntersectionReport report1, report2;
+    int stack[BVH_STACK_SIZE * N];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
 
-    report.d = FLT_MAX;
+    alignas(32) float distances[N];
+    WatertightRay watertightRay(ray);
+    TraversalCounter counter(traversalCounters.shadow);
 
-    if(this->leftChild == nullptr && this->rightChild == nullptr)
+    while(stackSize > 0)
     {
-        for(size_t i=0; i<primitives.size(); i++)
+        const WideBVHNode<N>& node = wideBVH.nodes[stack[--stackSize]];
+        counter.nodes++;
+
+        int mask = WideBVH<N>::IntersectChildren(node, ray, tmin, tmax, distances);
+        for(int c=0; c<N; c++)
         {
-            IntersectionReport r;
-            bool hitTest = primitives[i].Intersect(ray, r, tmin, tmax, intersectionTestEpslion, softShadingFlag, transformationMatrixTransposed, backfaceCulling);
-            if(hitTest)
+            if(!(mask & (1 << c)))
+                continue;
+
+            if(node.count[c] == 0)
             {
-                report = r.d < report.d ? r : report;
+                stack[stackSize++] = node.child[c];
+                continue;
             }
-            
-        }
-
-        return report.d != FLT_MAX;
-    }    
 
-    bool leftTest  = leftChild ->Intersect(ray, report1, tmin, tmax, intersectionTestEpslion, softShadingFlag, transformationMatrixTransposed, backfaceCulling);
-    bool rightTest = rightChild->Intersect(ray, report2, tmin, tmax, intersectionTestEpslion, softShadingFlag, transformationMatrixTransposed, backfaceCulling);
-
-    if(leftTest)
-    {
-        report = report1;
-    }
-    
-    if(rightTest)
-    {
-        report = report2.d < report.d ? report2 : report;
+            counter.primitives += node.count[c];
+            if(occludedLeaf(node.child[c], node.count[c], ray, watertightRay, tmin, tmax, intersectionTestEpsilon, softShadingFlag, backfaceCulling))
+                return true;
+        }
     }
 
-    return (leftTest || rightTest);
-    
-}
\ No newline at end of file
+    return false;
+}
@@ -0,0 +1,225 @@
+#include <BVHCache.h>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <filesystem>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// Read-only mapping of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+public:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile(const std::string& path)
+    {
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if(descriptor < 0)
+            return;
+
+        struct stat status;
+        if(fstat(descriptor, &status) == 0 && status.st_size > 0)
+        {
+            void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(mapping != MAP_FAILED)
+            {
+                data = (const unsigned char*)mapping;
+                size = status.st_size;
+            }
+        }
+        close(descriptor);
+    }
+
+    ~MappedFile()
+    {
+        if(data)
+            munmap((void*)data, size);
+    }
+};
+
+template<typename T>
+static void readArray(const unsigned char*& cursor, size_t count, std::vector<T>& out)
+{
+    out.resize(count);
+    std::memcpy(out.data(), cursor, count * sizeof(T));
+    cursor += count * sizeof(T);
+}
+
+template<typename T>
+static void writeArray(FILE* file, const std::vector<T>& array)
+{
+    fwrite(array.data(), sizeof(T), array.size(), file);
+}
+
+uint64_t BVHCacheHash(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    const uint64_t prime = 0x100000001b3ull;
+
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 32;
+    }
+    for(; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    return hash;
+}
+
+uint64_t BVHCacheFileHash(const std::string& path)
+{
+    MappedFile file(path);
+    if(!file.data)
+        return 0;
+
+    return BVHCacheHash(file.data, file.size);
+}
+
+uint64_t BVHCacheGeometryHash(const MeshGeometry& geometry)
+{
+    uint64_t hash = BVH_CACHE_HASH_SEED;
+    hash = BVHCacheHash(geometry.vertices.data(),  geometry.vertices.size()  * sizeof(glm::vec3), hash);
+    hash = BVHCacheHash(geometry.normals.data(),   geometry.normals.size()   * sizeof(glm::vec3), hash);
+    hash = BVHCacheHash(geometry.texCoords.data(), geometry.texCoords.size() * sizeof(glm::vec2), hash);
+    hash = BVHCacheHash(geometry.faces.data(),     geometry.faces.size()     * sizeof(Indices), hash);
+
+    return hash;
+}
+
+uint64_t BVHCacheKey(uint64_t sourceHash, const BVHSettings& settings)
+{
+    uint64_t hash = BVHCacheHash(&sourceHash, sizeof(sourceHash));
+    hash = BVHCacheHash(&BVH_CACHE_VERSION, sizeof(BVH_CACHE_VERSION), hash);
+
+    int builder = settings.builder;
+    hash = BVHCacheHash(&builder, sizeof(builder), hash);
+    hash = BVHCacheHash(&settings.binCount, sizeof(settings.binCount), hash);
+    hash = BVHCacheHash(&settings.traversalCost, sizeof(settings.traversalCost), hash);
+    hash = BVHCacheHash(&settings.leafCost, sizeof(settings.leafCost), hash);
+    hash = BVHCacheHash(&settings.maxLeafSize, sizeof(settings.maxLeafSize), hash);
+    hash = BVHCacheHash(&settings.maxDepth, sizeof(settings.maxDepth), hash);
+    hash = BVHCacheHash(&settings.mortonBits, sizeof(settings.mortonBits), hash);
+    hash = BVHCacheHash(&settings.treeletSize, sizeof(settings.treeletSize), hash);
+    hash = BVHCacheHash(&settings.spatialSplitAlpha, sizeof(settings.spatialSplitAlpha), hash);
+    hash = BVHCacheHash(&settings.duplicationBudget, sizeof(settings.duplicationBudget), hash);
+
+    return hash;
+}
+
+std::string BVHCachePath(const std::string& directory, uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long)key);
+
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool BVHCacheLoad(const std::string& path, uint64_t key, MeshGeometry& geometry, std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices)
+{
+    MappedFile file(path);
+    if(!file.data || file.size < sizeof(BVHCacheHeader))
+        return false;
+
+    BVHCacheHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if(std::memcmp(header.magic, "BVHC", 4) != 0 || header.version != BVH_CACHE_VERSION || header.key != key)
+        return false;
+
+    uint64_t expectedSize = sizeof(BVHCacheHeader) +
+                            header.vertexCount * (2 * sizeof(glm::vec3) + sizeof(glm::vec2)) +
+                            header.faceCount * (sizeof(Indices) + sizeof(glm::vec3)) +
+                            header.nodeCount * sizeof(BVHNode) +
+                            header.indexCount * sizeof(int);
+    if(file.size != expectedSize)
+        return false;
+
+    const unsigned char* cursor = file.data + sizeof(BVHCacheHeader);
+    readArray(cursor, header.vertexCount, geometry.vertices);
+    readArray(cursor, header.vertexCount, geometry.normals);
+    readArray(cursor, header.vertexCount, geometry.texCoords);
+    readArray(cursor, header.faceCount, geometry.faces);
+    readArray(cursor, header.faceCount, geometry.faceNormals);
+    readArray(cursor, header.nodeCount, nodes);
+    readArray(cursor, header.indexCount, primitiveIndices);
+
+    // A damaged entry must not index out of bounds during traversal
+    int vertexCount = header.vertexCount;
+    int faceCount   = header.faceCount;
+    for(const Indices& face : geometry.faces)
+    {
+        if(face.a < 0 || face.a >= vertexCount || face.b < 0 || face.b >= vertexCount || face.c < 0 || face.c >= vertexCount)
+            return false;
+    }
+    for(int index : primitiveIndices)
+    {
+        if(index < 0 || index >= faceCount)
+            return false;
+    }
+    // Children of an interior node come after it, the first one right after,
+    // so traversal always moves forward
+    int nodeCount = nodes.size();
+    for(int index=0; index<nodeCount; index++)
+    {
+        const BVHNode& node = nodes[index];
+        if(node.primitiveCount == 0 && (index + 1 >= nodeCount || node.secondChildOffset <= index || node.secondChildOffset >= nodeCount))
+            return false;
+        if(node.primitiveCount != 0 && (node.primitiveOffset < 0 || node.primitiveOffset + node.primitiveCount > (int)primitiveIndices.size()))
+            return false;
+    }
+
+    return true;
+}
+
+void BVHCacheStore(const std::string& path, uint64_t key, const MeshGeometry& geometry, const std::vector<BVHNode>& nodes, const std::vector<int>& primitiveIndices)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    // Meshes load on several threads, two of them may store the same entry
+    std::string temporaryPath = path + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if(!file)
+    {
+        std::cerr << "Warning: BVH cache entry " << path << " cannot be written" << std::endl;
+        return;
+    }
+
+    BVHCacheHeader header;
+    std::memcpy(header.magic, "BVHC", 4);
+    header.version     = BVH_CACHE_VERSION;
+    header.key         = key;
+    header.vertexCount = geometry.vertices.size();
+    header.faceCount   = geometry.faces.size();
+    header.nodeCount   = nodes.size();
+    header.indexCount  = primitiveIndices.size();
+
+    fwrite(&header, sizeof(header), 1, file);
+    writeArray(file, geometry.vertices);
+    writeArray(file, geometry.normals);
+    writeArray(file, geometry.texCoords);
+    writeArray(file, geometry.faces);
+    writeArray(file, geometry.faceNormals);
+    writeArray(file, nodes);
+    writeArray(file, primitiveIndices);
+
+    bool written = !std::ferror(file);
+    written = std::fclose(file) == 0 && written;
+
+    if(!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        std::cerr << "Warning: BVH cache entry " << path << " cannot be written" << std::endl;
+    }
+}
@@ -0,0 +1,307 @@
+#include <BVHNodeBuilder.h>
+#include <LBVHBuilder.h>
+#include <limits>
+#include <cmath>
+
+
+int BVHBuildThreadCount(const BVHSettings& settings)
+{
+    if(!settings.pool)
+        return 1;
+
+    int threadCount = settings.buildThreads > 0 ? settings.buildThreads : settings.pool->Size();
+    return std::max(1, threadCount);
+}
+
+int BVHParallelDepth(int threadCount)
+{
+    return threadCount > 1 ? (int)std::ceil(std::log2(threadCount)) + 2 : 0;
+}
+
+BVHNodeBuilder::BVHNodeBuilder(const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids, const BVHSettings& settings,
+                               std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices)
+    : primitiveBounds(primitiveBounds), centroids(centroids), settings(settings), nodes(nodes), primitiveIndices(primitiveIndices)
+{
+    this->settings.binCount    = std::max(2, this->settings.binCount);
+    this->settings.maxLeafSize = std::max(1, this->settings.maxLeafSize);
+
+    // Leaves too large for a node are split evenly below maxDepth, leave room for that
+    this->settings.maxDepth    = std::min(BVH_STACK_SIZE - 32, this->settings.maxDepth);
+
+    // Spatial splits need the triangles, without them only object splits are left
+    if(this->settings.builder == BVHBuilder::SBVH)
+        this->settings.builder = BVHBuilder::BINNED_SAH;
+
+    threadCount   = BVHBuildThreadCount(this->settings);
+    parallelDepth = BVHParallelDepth(threadCount);
+}
+
+void BVHNodeBuilder::computeBounds(AABB& box, int start, int end) const
+{
+    for(int i=start; i<end; i++)
+    {
+        box.Extend(primitiveBounds[primitiveIndices[i]]);
+    }
+}
+
+// Accumulates [start, end) into binCount bins per axis, bins[axis * binCount + b].
+// Ranges at the top of the tree are binned in chunks on separate tasks, box
+// extension and counts are order independent so the result is the same.
+void BVHNodeBuilder::binPrimitives(const AABB& centroidBox, int start, int end, std::vector<BVHBin>& bins) const
+{
+    int binCount = settings.binCount;
+    int count = end - start;
+
+    int chunkCount = std::min(threadCount, count / BVH_PARALLEL_BINNING_THRESHOLD);
+    if(chunkCount > 1)
+    {
+        std::vector<std::vector<BVHBin>> chunkBins(chunkCount, std::vector<BVHBin>(3 * binCount));
+        TaskGroup tasks(*settings.pool);
+
+        for(int c=0; c<chunkCount; c++)
+        {
+            int chunkStart = start + (long long)count * c / chunkCount;
+            int chunkEnd   = start + (long long)count * (c + 1) / chunkCount;
+            tasks.Run([&, c, chunkStart, chunkEnd]()
+            {
+                binPrimitives(centroidBox, chunkStart, chunkEnd, chunkBins[c]);
+            });
+        }
+        tasks.Wait();
+
+        for(int c=0; c<chunkCount; c++)
+        {
+            for(int b=0; b<3 * binCount; b++)
+            {
+                bins[b].count += chunkBins[c][b].count;
+                bins[b].box.Extend(chunkBins[c][b].box);
+            }
+        }
+        return;
+    }
+
+    for(int a=0; a<3; a++)
+    {
+        float minCentroid = centroidBox.bounds[0][a];
+        float extent = centroidBox.bounds[1][a] - minCentroid;
+        if(extent <= 0.0f)
+            continue;
+
+        float scale = binCount / extent;
+        BVHBin* axisBins = bins.data() + a * binCount;
+
+        for(int i=start; i<end; i++)
+        {
+            int index = primitiveIndices[i];
+            int b = std::min(binCount - 1, (int)((centroids[index][a] - minCentroid) * scale));
+            axisBins[b].count++;
+            axisBins[b].box.Extend(primitiveBounds[index]);
+        }
+    }
+}
+
+// Splits [start, end) at the mean centroid along the longest axis of the box.
+// Returns the first index of the right partition.
+int BVHNodeBuilder::splitMidpoint(const AABB& box, int start, int end, int& axis)
+{
+    glm::vec3 extent = box.bounds[1] - box.bounds[0];
+
+    if(extent.x >= extent.y && extent.x >= extent.z)
+        axis = 0;
+    else if(extent.y >= extent.x && extent.y >= extent.z)
+        axis = 1;
+    else
+        axis = 2;
+
+    glm::vec3 totalVec(0.0, 0.0, 0.0);
+    for(int i=start; i<end; i++)
+    {
+        totalVec += centroids[primitiveIndices[i]];
+    }
+    totalVec /= (end - start);
+
+    float splitPosition = totalVec[axis];
+    int* middle = std::stable_partition(primitiveIndices.data() + start, primitiveIndices.data() + end, [&](int index)
+    {
+        return centroids[index][axis] <= splitPosition;
+    });
+
+    return middle - primitiveIndices.data();
+}
+
+// Bins the centroids of [start, end) on every axis and picks the plane with the
+// lowest surface area heuristic cost. Returns start when a leaf is cheaper.
+int BVHNodeBuilder::splitBinnedSAH(const AABB& box, int start, int end, int& axis)
+{
+    int count = end - start;
+    int binCount = settings.binCount;
+
+    AABB centroidBox;
+    for(int i=start; i<end; i++)
+    {
+        centroidBox.Extend(centroids[primitiveIndices[i]]);
+    }
+
+    std::vector<BVHBin> allBins(3 * binCount);
+    binPrimitives(centroidBox, start, end, allBins);
+
+    std::vector<float> rightCost(binCount);
+
+    float bestCost = FLT_MAX;
+    int bestAxis  = -1;
+    int bestSplit = -1;
+
+    for(int a=0; a<3; a++)
+    {
+        if(centroidBox.bounds[1][a] - centroidBox.bounds[0][a] <= 0.0f)
+            continue;
+
+        const BVHBin* bins = allBins.data() + a * binCount;
+
+        AABB rightBox;
+        int rightCount = 0;
+        for(int b=binCount-1; b>0; b--)
+        {
+            rightBox.Extend(bins[b].box);
+            rightCount += bins[b].count;
+            rightCost[b] = rightBox.SurfaceArea() * rightCount;
+        }
+
+        AABB leftBox;
+        int leftCount = 0;
+        for(int b=1; b<binCount; b++)
+        {
+            leftBox.Extend(bins[b - 1].box);
+            leftCount += bins[b - 1].count;
+
+            // Planes that leave one side empty never help
+            if(leftCount == 0 || leftCount == count)
+                continue;
+
+            float cost = leftBox.SurfaceArea() * leftCount + rightCost[b];
+            if(cost < bestCost)
+            {
+                bestCost  = cost;
+                bestAxis  = a;
+                bestSplit = b;
+            }
+        }
+    }
+
+    if(bestAxis == -1)
+        return start;
+
+    float parentArea = box.SurfaceArea();
+    float splitCost = settings.traversalCost;
+    if(parentArea > 0.0f)
+        splitCost += settings.leafCost * bestCost / parentArea;
+
+    if(count <= settings.maxLeafSize && settings.leafCost * count <= splitCost)
+        return start;
+
+    axis = bestAxis;
+
+    float minCentroid = centroidBox.bounds[0][axis];
+    float scale = binCount / (centroidBox.bounds[1][axis] - minCentroid);
+    int* middle = std::partition(primitiveIndices.data() + start, primitiveIndices.data() + end, [&](int index)
+    {
+        int b = std::min(binCount - 1, (int)((centroids[index][axis] - minCentroid) * scale));
+        return b < bestSplit;
+    });
+
+    return middle - primitiveIndices.data();
+}
+
+void BVHNodeBuilder::build(int start, int end, int depth, std::vector<BVHNode>& out)
+{
+    int nodeIndex = out.size();
+    out.push_back(BVHNode());
+
+    AABB box;
+    computeBounds(box, start, end);
+    out[nodeIndex].box = box;
+    out[nodeIndex].axis = 0;
+    out[nodeIndex].pad  = 0;
+
+    int count = end - start;
+    int maxLeafSize = std::numeric_limits<uint16_t>::max();
+    int middle = start;
+
+    if(depth < settings.maxDepth && count > 1)
+    {
+        int axis = 0;
+        if(settings.builder == BVHBuilder::BINNED_SAH)
+            middle = splitBinnedSAH(box, start, end, axis);
+        else
+            middle = splitMidpoint(box, start, end, axis);
+        out[nodeIndex].axis = axis;
+    }
+
+    if(middle == start || middle == end)
+    {
+        if(count <= maxLeafSize)
+        {
+            out[nodeIndex].primitiveOffset = start;
+            out[nodeIndex].primitiveCount  = count;
+            return;
+        }
+
+        // Too many primitives for a single leaf, fall back to an even split
+        middle = start + count / 2;
+    }
+
+    out[nodeIndex].primitiveCount = 0;
+
+    if(depth < parallelDepth && count >= BVH_PARALLEL_BUILD_THRESHOLD)
+    {
+        // The right subtree is built into its own array on another task and
+        // appended after the left one, keeping the depth first layout
+        std::vector<BVHNode> rightNodes;
+        TaskGroup rightTask(*settings.pool);
+        rightTask.Run([&]()
+        {
+            build(middle, end, depth + 1, rightNodes);
+        });
+
+        build(start, middle, depth + 1, out);
+        rightTask.Wait();
+
+        int offset = out.size();
+        out[nodeIndex].secondChildOffset = offset;
+        for(BVHNode& node : rightNodes)
+        {
+            if(node.primitiveCount == 0)
+                node.secondChildOffset += offset;
+            out.push_back(node);
+        }
+        return;
+    }
+
+    build(start, middle, depth + 1, out);
+    out[nodeIndex].secondChildOffset = out.size();
+    build(middle, end, depth + 1, out);
+}
+
+void BVHNodeBuilder::Build()
+{
+    if(settings.builder == BVHBuilder::LBVH)
+    {
+        LBVHBuilder builder(primitiveBounds, centroids, settings, nodes, primitiveIndices);
+        builder.Build();
+        return;
+    }
+
+    nodes.clear();
+    primitiveIndices.resize(primitiveBounds.size());
+    for(size_t i=0; i<primitiveBounds.size(); i++)
+    {
+        primitiveIndices[i] = i;
+    }
+
+    if(primitiveBounds.empty())
+        return;
+
+    nodes.reserve(2 * primitiveBounds.size());
+    build(0, primitiveBounds.size(), 0, nodes);
+    nodes.shrink_to_fit();
+}
@@ -0,0 +1,185 @@
+#include <BVHStats.h>
+#include <iomanip>
+
+
+static double boxVolume(const AABB& box)
+{
+    glm::vec3 extent = box.bounds[1] - box.bounds[0];
+    if(extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f)
+        return 0.0;
+
+    return (double)extent.x * extent.y * extent.z;
+}
+
+static double overlapVolume(const AABB& a, const AABB& b)
+{
+    AABB overlap;
+    for(int axis=0; axis<3; axis++)
+    {
+        overlap.bounds[0][axis] = std::max(a.bounds[0][axis], b.bounds[0][axis]);
+        overlap.bounds[1][axis] = std::min(a.bounds[1][axis], b.bounds[1][axis]);
+    }
+
+    return boxVolume(overlap);
+}
+
+BVHStats ComputeBVHStats(const std::vector<BVHNode>& nodes, size_t primitiveCount, size_t referenceCount, const BVHSettings& settings)
+{
+    BVHStats stats;
+    stats.nodeCount      = nodes.size();
+    stats.primitiveCount = primitiveCount;
+    stats.referenceCount = referenceCount;
+    stats.memoryBytes    = nodes.size() * sizeof(BVHNode) + referenceCount * sizeof(int);
+
+    if(nodes.empty())
+        return stats;
+
+    int depthLimit = std::min(BVH_STACK_SIZE - 32, settings.maxDepth);
+    double rootArea = nodes[0].box.SurfaceArea();
+    double cost = 0.0;
+    double leafDepthSum = 0.0;
+    double emptySpaceSum = 0.0;
+    double overlapSum = 0.0;
+    size_t volumeNodeCount = 0;
+
+    std::vector<std::pair<int, int>> stack;
+    stack.push_back({0, 0});
+    while(!stack.empty())
+    {
+        int index = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+
+        const BVHNode& node = nodes[index];
+        double area = node.box.SurfaceArea();
+
+        if(node.primitiveCount > 0)
+        {
+            int count = node.primitiveCount;
+
+            stats.leafCount++;
+            stats.maxDepth = std::max(stats.maxDepth, depth);
+            leafDepthSum += depth;
+            cost += settings.leafCost * count * area;
+
+            if((size_t)count >= stats.leafSizeHistogram.size())
+                stats.leafSizeHistogram.resize(count + 1, 0);
+            stats.leafSizeHistogram[count]++;
+
+            if(count > settings.maxLeafSize)
+                stats.oversizedLeafCount++;
+            if(depth >= depthLimit && count > 1)
+                stats.depthLimitLeafCount++;
+            continue;
+        }
+
+        cost += settings.traversalCost * area;
+
+        const AABB& left  = nodes[index + 1].box;
+        const AABB& right = nodes[node.secondChildOffset].box;
+        double volume = boxVolume(node.box);
+        if(volume > 0.0)
+        {
+            double overlap = overlapVolume(left, right);
+            emptySpaceSum += std::max(0.0, 1.0 - (boxVolume(left) + boxVolume(right) - overlap) / volume);
+            overlapSum    += overlap / volume;
+            volumeNodeCount++;
+        }
+
+        stack.push_back({node.secondChildOffset, depth + 1});
+        stack.push_back({index + 1, depth + 1});
+    }
+
+    stats.averageLeafDepth = leafDepthSum / stats.leafCount;
+    stats.averageLeafSize  = (double)referenceCount / stats.leafCount;
+    stats.sahCost = rootArea > 0.0 ? cost / rootArea : 0.0;
+    if(volumeNodeCount > 0)
+    {
+        stats.emptySpaceRatio = emptySpaceSum / volumeNodeCount;
+        stats.overlapRatio    = overlapSum / volumeNodeCount;
+    }
+
+    return stats;
+}
+
+void BVHStats::Add(const BVHStats& other)
+{
+    size_t interiorCount      = nodeCount - leafCount;
+    size_t otherInteriorCount = other.nodeCount - other.leafCount;
+    size_t totalLeafCount     = leafCount + other.leafCount;
+    size_t totalInteriorCount = interiorCount + otherInteriorCount;
+    size_t totalPrimitives    = primitiveCount + other.primitiveCount;
+
+    if(totalLeafCount > 0)
+        averageLeafDepth = (averageLeafDepth * leafCount + other.averageLeafDepth * other.leafCount) / totalLeafCount;
+    if(totalInteriorCount > 0)
+    {
+        emptySpaceRatio = (emptySpaceRatio * interiorCount + other.emptySpaceRatio * otherInteriorCount) / totalInteriorCount;
+        overlapRatio    = (overlapRatio * interiorCount + other.overlapRatio * otherInteriorCount) / totalInteriorCount;
+    }
+    if(totalPrimitives > 0)
+        sahCost = (sahCost * primitiveCount + other.sahCost * other.primitiveCount) / totalPrimitives;
+
+    nodeCount      += other.nodeCount;
+    leafCount      += other.leafCount;
+    primitiveCount += other.primitiveCount;
+    referenceCount += other.referenceCount;
+    averageLeafSize = leafCount > 0 ? (double)referenceCount / leafCount : 0.0;
+
+    maxDepth = std::max(maxDepth, other.maxDepth);
+
+    if(other.leafSizeHistogram.size() > leafSizeHistogram.size())
+        leafSizeHistogram.resize(other.leafSizeHistogram.size(), 0);
+    for(size_t i=0; i<other.leafSizeHistogram.size(); i++)
+        leafSizeHistogram[i] += other.leafSizeHistogram[i];
+
+    oversizedLeafCount  += other.oversizedLeafCount;
+    depthLimitLeafCount += other.depthLimitLeafCount;
+    memoryBytes         += other.memoryBytes;
+}
+
+void BVHStats::Print(std::ostream& stream, const std::string& name) const
+{
+    stream << name << ": " << primitiveCount << " primitives, " << referenceCount << " references, "
+           << nodeCount << " nodes, " << leafCount << " leaves" << std::endl;
+
+    stream << std::fixed << std::setprecision(2)
+           << "    depth " << maxDepth << " (leaf average " << averageLeafDepth << "), leaf size average " << averageLeafSize
+           << ", SAH cost " << sahCost << ", empty space " << 100.0 * emptySpaceRatio << "%, overlap " << 100.0 * overlapRatio << "%, "
+           << memoryBytes / 1024.0 << " KB" << std::endl;
+    stream.unsetf(std::ios_base::floatfield);
+
+    stream << "    leaf sizes";
+    for(size_t i=0; i<leafSizeHistogram.size(); i++)
+    {
+        if(leafSizeHistogram[i] > 0)
+            stream << " " << i << ":" << leafSizeHistogram[i];
+    }
+    stream << std::endl;
+
+    if(oversizedLeafCount > 0 || depthLimitLeafCount > 0)
+        stream << "    warning: " << oversizedLeafCount << " leaves above MaxLeafSize, " << depthLimitLeafCount << " leaves at MaxDepth" << std::endl;
+}
+
+void BVHStats::WriteJSON(std::ostream& stream) const
+{
+    stream << "{\"primitives\": " << primitiveCount
+           << ", \"references\": " << referenceCount
+           << ", \"nodes\": " << nodeCount
+           << ", \"leaves\": " << leafCount
+           << ", \"maxDepth\": " << maxDepth
+           << ", \"averageLeafDepth\": " << averageLeafDepth
+           << ", \"averageLeafSize\": " << averageLeafSize
+           << ", \"oversizedLeaves\": " << oversizedLeafCount
+           << ", \"depthLimitLeaves\": " << depthLimitLeafCount
+           << ", \"sahCost\": " << sahCost
+           << ", \"emptySpaceRatio\": " << emptySpaceRatio
+           << ", \"overlapRatio\": " << overlapRatio
+           << ", \"memoryBytes\": " << memoryBytes
+           << ", \"leafSizeHistogram\": [";
+
+    for(size_t i=0; i<leafSizeHistogram.size(); i++)
+        stream << (i > 0 ? ", " : "") << leafSizeHistogram[i];
+
+    stream << "]}";
+}
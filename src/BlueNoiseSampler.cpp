@@ -0,0 +1,131 @@
+#include <BlueNoiseSampler.h>
+#include <SobolSampler.h>
+#include <RandomGenerator.h>
+#include <cmath>
+
+
+BlueNoiseSampler::BlueNoiseSampler()
+{
+    mask.resize(BLUE_NOISE_MASK_SIZE * BLUE_NOISE_MASK_SIZE);
+    generateMask();
+}
+
+// Ulichney's void and cluster method. The energy of a pixel is the sum of a
+// Gaussian over the set pixels around it, on a torus so the mask tiles. The
+// initial pattern is relaxed by moving its tightest cluster into its largest
+// void, then its pixels are ranked by taking clusters away and the remaining
+// ones by filling voids. The rank order of the result is blue noise.
+void BlueNoiseSampler::generateMask()
+{
+    const int size  = BLUE_NOISE_MASK_SIZE;
+    const int count = size * size;
+    const float sigma = 1.5f;
+
+    std::vector<float> kernel(count);
+    for(int dy=0; dy<size; dy++)
+    {
+        for(int dx=0; dx<size; dx++)
+        {
+            float wrappedX = std::min(dx, size - dx);
+            float wrappedY = std::min(dy, size - dy);
+            kernel[dy * size + dx] = std::exp(-(wrappedX * wrappedX + wrappedY * wrappedY) / (2.0f * sigma * sigma));
+        }
+    }
+
+    std::vector<char> pattern(count, 0);
+    std::vector<float> energy(count, 0.0f);
+
+    auto toggle = [&](int pixel, bool set)
+    {
+        pattern[pixel] = set;
+        float sign = set ? 1.0f : -1.0f;
+
+        int px = pixel % size;
+        int py = pixel / size;
+        for(int y=0; y<size; y++)
+        {
+            const float* row = &kernel[((y - py + size) % size) * size];
+            for(int x=0; x<size; x++)
+                energy[y * size + x] += sign * row[(x - px + size) % size];
+        }
+    };
+
+    auto tightestCluster = [&]()
+    {
+        int best = -1;
+        for(int i=0; i<count; i++)
+        {
+            if(pattern[i] && (best < 0 || energy[i] > energy[best]))
+                best = i;
+        }
+        return best;
+    };
+
+    auto largestVoid = [&]()
+    {
+        int best = -1;
+        for(int i=0; i<count; i++)
+        {
+            if(!pattern[i] && (best < 0 || energy[i] < energy[best]))
+                best = i;
+        }
+        return best;
+    };
+
+    int initialCount = count / 10;
+    for(uint32_t i=0, placed=0; (int)placed<initialCount; i++)
+    {
+        int pixel = RandomHash(i) % count;
+        if(!pattern[pixel])
+        {
+            toggle(pixel, true);
+            placed++;
+        }
+    }
+
+    for(int iteration=0; iteration<count; iteration++)
+    {
+        int cluster = tightestCluster();
+        toggle(cluster, false);
+
+        int hole = largestVoid();
+        toggle(hole, true);
+        if(hole == cluster)
+            break;
+    }
+
+    std::vector<char> prototype = pattern;
+    std::vector<float> prototypeEnergy = energy;
+    std::vector<int> rank(count);
+
+    for(int r=initialCount-1; r>=0; r--)
+    {
+        int cluster = tightestCluster();
+        toggle(cluster, false);
+        rank[cluster] = r;
+    }
+
+    pattern = prototype;
+    energy  = prototypeEnergy;
+    for(int r=initialCount; r<count; r++)
+    {
+        int hole = largestVoid();
+        toggle(hole, true);
+        rank[hole] = r;
+    }
+
+    for(int i=0; i<count; i++)
+        mask[i] = (rank[i] + 0.5f) / count;
+}
+
+float BlueNoiseSampler::Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const
+{
+    uint32_t offset = RandomHash(key ^ RandomHash(dimension));
+    uint32_t maskX = (x + (offset & 0xffff)) % BLUE_NOISE_MASK_SIZE;
+    uint32_t maskY = (y + (offset >> 16)) % BLUE_NOISE_MASK_SIZE;
+
+    float value = (SobolSampler::ScrambledSobol(index, dimension, RandomHash(key ^ RandomHash(dimension / 2))) >> 8) * (1.0f / 16777216.0f);
+    value += mask[maskY * BLUE_NOISE_MASK_SIZE + maskX];
+
+    return value >= 1.0f ? value - 1.0f : value;
+}
@@ -3,7 +3,7 @@
 
 
 bool DirectionalLight::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
-                                             const IntersectionReport& report, bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector)
+                                             const IntersectionReport& report, bool backfaceCulling, float time, TopLevelBVH& topLevelBVH) const
 {
     glm::vec3 dir       = -this->direction;
     glm::vec3 origin    = report.intersection + shadowRayEpsilon*report.normal;
@@ -11,26 +11,19 @@ bool DirectionalLight::ShadowRayIntersection(float tmin, float tmax, float inter
     Ray ray(origin, dir);
     ray.time = time;
 
-    for(auto object : objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling))
-            return true;
-    }
-
-    return false;
+    return topLevelBVH.Occluded(ray, tmin, tmax, intersectionTestEpsilon, backfaceCulling);
 }
 
 
 glm::vec3 DirectionalLight::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                                    const float& phongExponent, const IntersectionReport& report,
                                                    float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                                   bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                                                   bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
 {
 
     glm::vec3 result = glm::vec3(0.0);
 
-    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, objectPointerVector))
+    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, topLevelBVH))
     {
         return glm::vec3(0.0);
     }
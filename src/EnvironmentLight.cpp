@@ -1,6 +1,6 @@
 #include <EnvironmentLight.h>
 
-void EnvironmentLight::RejectionSampling(glm::vec3 normal)
+glm::vec3 EnvironmentLight::RejectionSampling(glm::vec3 normal) const
 {
     glm::vec3 resultVec(0.0);
 
@@ -13,7 +13,7 @@ void EnvironmentLight::RejectionSampling(glm::vec3 normal)
         resultVec = glm::vec3(randomX, randomY, randomZ);
     }
 
-    randomDirection = glm::normalize(resultVec);
+    return glm::normalize(resultVec);
 
 }
 
@@ -22,32 +22,25 @@ EnvironmentLight::EnvironmentLight()
     randomNumberGenerator = new RandomGenerator(0.0f, 1.0f);
 }
 
-bool EnvironmentLight::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
+bool EnvironmentLight::ShadowRayIntersection(const glm::vec3& direction, float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                              const IntersectionReport& report, bool backfaceCulling,
-                                             float time, std::vector<Object *>& objectPointerVector)
+                                             float time, TopLevelBVH& topLevelBVH) const
 {
-    glm::vec3 dir       = randomDirection;
+    glm::vec3 dir       = direction;
     glm::vec3 origin    = report.intersection + shadowRayEpsilon*report.normal;
         
     Ray ray(origin, dir);
     ray.time = time;
 
-    for(auto object : objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling))
-            return true;
-    }
-
-    return false;
+    return topLevelBVH.Occluded(ray, tmin, tmax, intersectionTestEpsilon, backfaceCulling);
 }
 
 glm::vec3 EnvironmentLight::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                                    const float& phongExponent, const IntersectionReport& report,
                                                    float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                                   bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                                                   bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
 {
-    RejectionSampling(report.normal);
+    glm::vec3 randomDirection = RejectionSampling(report.normal);
     float theta = std::acos(glm::dot(randomDirection, glm::vec3(0.0, 1.0, 0.0)));
     float phi   = std::atan2(glm::dot(randomDirection, glm::vec3(0.0, 0.0, 1.0)), glm::dot(randomDirection, glm::vec3(1.0, 0.0, 0.0)));
 
@@ -61,7 +54,7 @@ glm::vec3 EnvironmentLight::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& di
 
     glm::vec3 result = glm::vec3(0.0);
 
-    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, objectPointerVector))
+    if(ShadowRayIntersection(randomDirection, tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, topLevelBVH))
     {
         return glm::vec3(0.0);
     }
@@ -0,0 +1,96 @@
+#include <HaltonSampler.h>
+#include <RandomGenerator.h>
+#include <algorithm>
+
+
+HaltonSampler::HaltonSampler()
+{
+    for(uint32_t candidate=2; (int)primes.size() < HALTON_PRIME_COUNT; candidate++)
+    {
+        bool prime = true;
+        for(uint32_t p : primes)
+        {
+            if(p * p > candidate)
+                break;
+            if(candidate % p == 0)
+            {
+                prime = false;
+                break;
+            }
+        }
+
+        if(prime)
+            primes.push_back(candidate);
+    }
+
+    for(uint32_t base : primes)
+    {
+        int count = 0;
+        for(double range=1.0; range<16777216.0; range*=base)
+            count++;
+        digitCounts.push_back(count);
+    }
+}
+
+// Kensler's hashed permutation of [0, size), walks the cycle of a
+// permutation of the enclosing power of two until it lands inside the range
+static uint32_t permuteDigit(uint32_t value, uint32_t size, uint32_t seed)
+{
+    uint32_t mask = size - 1;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+
+    do
+    {
+        value ^= seed;
+        value *= 0xe170893d;
+        value ^= seed >> 16;
+        value ^= (value & mask) >> 4;
+        value ^= seed >> 8;
+        value *= 0x0929eb3f;
+        value ^= seed >> 23;
+        value ^= (value & mask) >> 1;
+        value *= 1 | seed >> 27;
+        value *= 0x6935fa69;
+        value ^= (value & mask) >> 11;
+        value *= 0x74dcb303;
+        value ^= (value & mask) >> 2;
+        value *= 0x9e501cc3;
+        value ^= (value & mask) >> 2;
+        value *= 0xc860a3df;
+        value &= mask;
+        value ^= value >> 5;
+    } while(value >= size);
+
+    return (value + seed) % size;
+}
+
+float HaltonSampler::Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const
+{
+    uint32_t base = primes[dimension % HALTON_PRIME_COUNT];
+    int digitCount = digitCounts[dimension % HALTON_PRIME_COUNT];
+    uint32_t seed = RandomHash(key ^ RandomHash(x ^ RandomHash(y ^ RandomHash(dimension))));
+
+    // The permutation of a digit depends on the digits before it, the point
+    // stays stratified and lands uniformly inside its stratum. Leading zero
+    // digits are permuted too, which jitters the last stratum.
+    double inverseBase = 1.0 / base;
+    double factor = inverseBase;
+    double result = 0.0;
+    uint32_t prefix = 0;
+    for(int digit=0; digit<digitCount; digit++)
+    {
+        uint32_t value = index % base;
+        index /= base;
+
+        uint32_t digitSeed = RandomHash(seed ^ RandomHash(prefix ^ RandomHash(digit)));
+        result += permuteDigit(value, base, digitSeed) * factor;
+        factor *= inverseBase;
+        prefix = prefix * base + value;
+    }
+
+    return std::min((float)result, 1.0f - 1.0f / 16777216.0f);
+}
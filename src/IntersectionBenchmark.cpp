@@ -0,0 +1,228 @@
+#include <IntersectionBenchmark.h>
+#include <TriangleIntersection.h>
+#include <TriangleBlock.h>
+#include <MeshGeometry.h>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+
+
+// The test Triangle used before the edges were precomputed, four 3x3
+// determinants by Cramer's rule
+static bool intersectDeterminant(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                                 float tmin, float tmax, float intersectionTestEpsilon, float& t, float& beta, float& gamma)
+{
+    float detA = glm::determinant(glm::mat3(a - b, a - c, ray.direction));
+
+    beta  = glm::determinant(glm::mat3(a - ray.origin, a - c, ray.direction)) / detA;
+    gamma = glm::determinant(glm::mat3(a - b, a - ray.origin, ray.direction)) / detA;
+    t     = glm::determinant(glm::mat3(a - b, a - c, a - ray.origin)) / detA;
+
+    return (beta + gamma <= 1 + intersectionTestEpsilon) && (beta >= -intersectionTestEpsilon) && (gamma >= -intersectionTestEpsilon) && t > tmin && t < tmax;
+}
+
+static void buildBlocks(const MeshGeometry& geometry, std::vector<TriangleBlock>& blocks)
+{
+    for(size_t i=0; i<geometry.FaceCount(); i++)
+    {
+        if(i % TRIANGLE_BLOCK_WIDTH == 0)
+            blocks.push_back(TriangleBlock());
+
+        blocks.back().SetLane(i % TRIANGLE_BLOCK_WIDTH, geometry, i);
+    }
+}
+
+// Runs test(ray) for every ray, returns nanoseconds per ray triangle pair
+static double timeTest(const std::vector<Ray>& rays, size_t triangleCount, const std::function<int(const Ray&)>& test, size_t& hits)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    hits = 0;
+    for(const Ray& ray : rays)
+        hits += test(ray);
+
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - startTime).count();
+    return ns / (rays.size() * triangleCount);
+}
+
+static int popCount(int mask)
+{
+    int count = 0;
+    for(; mask; mask >>= 1)
+        count += mask & 1;
+
+    return count;
+}
+
+void RunIntersectionBenchmark(std::ostream& stream)
+{
+    const float epsilon = 0.0001f;
+    const float tmax = 1000.0f;
+    std::mt19937 engine(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto randomPoint = [&](float scale) { return glm::vec3(unit(engine), unit(engine), unit(engine)) * scale; };
+
+    // Random triangles in the unit cube and rays aimed into it
+    MeshGeometry soup;
+    for(int i=0; i<1024; i++)
+    {
+        glm::vec3 center = randomPoint(1.0f);
+        int a = soup.AddVertex(center + randomPoint(0.2f) - glm::vec3(0.1f), glm::vec3(0.0f), glm::vec2(0.0f));
+        int b = soup.AddVertex(center + randomPoint(0.2f) - glm::vec3(0.1f), glm::vec3(0.0f), glm::vec2(0.0f));
+        int c = soup.AddVertex(center + randomPoint(0.2f) - glm::vec3(0.1f), glm::vec3(0.0f), glm::vec2(0.0f));
+        soup.AddFace(a, b, c);
+    }
+
+    std::vector<Ray> rays;
+    for(int i=0; i<4096; i++)
+    {
+        glm::vec3 origin = randomPoint(4.0f) - glm::vec3(1.5f);
+        glm::vec3 direction = glm::normalize(randomPoint(1.0f) - origin);
+        rays.push_back(Ray(origin, direction));
+    }
+
+    size_t faceCount = soup.FaceCount();
+    std::vector<glm::vec3> a(faceCount), b(faceCount), c(faceCount), edge1(faceCount), edge2(faceCount);
+    for(size_t i=0; i<faceCount; i++)
+    {
+        a[i] = soup.vertices[soup.faces[i].a];
+        b[i] = soup.vertices[soup.faces[i].b];
+        c[i] = soup.vertices[soup.faces[i].c];
+        edge1[i] = b[i] - a[i];
+        edge2[i] = c[i] - a[i];
+    }
+
+    std::vector<TriangleBlock> blocks;
+    buildBlocks(soup, blocks);
+
+    alignas(32) float t[TRIANGLE_BLOCK_WIDTH];
+    alignas(32) float beta[TRIANGLE_BLOCK_WIDTH];
+    alignas(32) float gamma[TRIANGLE_BLOCK_WIDTH];
+
+    struct Method
+    {
+        const char* name;
+        std::function<int(const Ray&)> test;
+    };
+
+    std::vector<Method> methods;
+    methods.push_back({"determinants (previous)", [&](const Ray& ray)
+    {
+        int hits = 0;
+        for(size_t i=0; i<faceCount; i++)
+            hits += intersectDeterminant(ray, a[i], b[i], c[i], 0.0f, tmax, epsilon, t[0], beta[0], gamma[0]);
+        return hits;
+    }});
+    methods.push_back({"precomputed edges", [&](const Ray& ray)
+    {
+        int hits = 0;
+        for(size_t i=0; i<faceCount; i++)
+            hits += IntersectTriangle(ray, a[i], edge1[i], edge2[i], 0.0f, tmax, epsilon, t[0], beta[0], gamma[0]);
+        return hits;
+    }});
+    methods.push_back({"watertight", [&](const Ray& ray)
+    {
+        WatertightRay watertightRay(ray);
+        int hits = 0;
+        for(size_t i=0; i<faceCount; i++)
+            hits += IntersectTriangleWatertight(watertightRay, a[i], b[i], c[i], 0.0f, tmax, t[0], beta[0], gamma[0]);
+        return hits;
+    }});
+    methods.push_back({"block precomputed", [&](const Ray& ray)
+    {
+        int hits = 0;
+        for(const TriangleBlock& block : blocks)
+            hits += popCount(block.Intersect(ray, 0.0f, tmax, epsilon, t, beta, gamma));
+        return hits;
+    }});
+    methods.push_back({"block watertight", [&](const Ray& ray)
+    {
+        WatertightRay watertightRay(ray);
+        int hits = 0;
+        for(const TriangleBlock& block : blocks)
+            hits += popCount(block.IntersectWatertight(watertightRay, 0.0f, tmax, t, beta, gamma));
+        return hits;
+    }});
+
+    stream << "Triangle tests, " << rays.size() << " rays against " << faceCount << " triangles" << std::endl;
+    stream << std::fixed << std::setprecision(2);
+    for(const Method& method : methods)
+    {
+        // Best of a few runs, the first one also warms the caches
+        size_t hits;
+        double ns = timeTest(rays, faceCount, method.test, hits);
+        for(int run=0; run<4; run++)
+            ns = std::min(ns, timeTest(rays, faceCount, method.test, hits));
+
+        stream << "    " << std::left << std::setw(26) << method.name << std::right << std::setw(8) << ns << " ns/test, " << hits << " hits" << std::endl;
+    }
+
+    // A closed grid of bumpy quads. Rays aimed at its vertices and edge
+    // midpoints have to hit at least one of the triangles sharing them.
+    const int gridSize = 64;
+    MeshGeometry grid;
+    for(int y=0; y<=gridSize; y++)
+    {
+        for(int x=0; x<=gridSize; x++)
+        {
+            glm::vec3 position(x / (float)gridSize, y / (float)gridSize, 0.05f * unit(engine));
+            grid.AddVertex(position, glm::vec3(0.0f), glm::vec2(0.0f));
+        }
+    }
+    for(int y=0; y<gridSize; y++)
+    {
+        for(int x=0; x<gridSize; x++)
+        {
+            int corner = y * (gridSize + 1) + x;
+            grid.AddFace(corner, corner + 1, corner + gridSize + 2);
+            grid.AddFace(corner, corner + gridSize + 2, corner + gridSize + 1);
+        }
+    }
+
+    std::vector<TriangleBlock> gridBlocks;
+    buildBlocks(grid, gridBlocks);
+
+    std::vector<Ray> edgeRays;
+    for(const Indices& face : grid.faces)
+    {
+        const glm::vec3 corners[3] = {grid.vertices[face.a], grid.vertices[face.b], grid.vertices[face.c]};
+        for(int i=0; i<3; i++)
+        {
+            const glm::vec3 targets[2] = {corners[i], (corners[i] + corners[(i + 1) % 3]) * 0.5f};
+            for(const glm::vec3& target : targets)
+            {
+                // Rays at the outer border may rightly pass outside the grid
+                if(target.x <= 0.0f || target.x >= 1.0f || target.y <= 0.0f || target.y >= 1.0f)
+                    continue;
+
+                glm::vec3 origin = target + glm::vec3(unit(engine) - 0.5f, unit(engine) - 0.5f, 1.0f + unit(engine));
+                glm::vec3 direction = glm::normalize(target - origin);
+                edgeRays.push_back(Ray(origin, direction));
+            }
+        }
+    }
+
+    size_t missedPrecomputed = 0;
+    size_t missedWatertight  = 0;
+    for(const Ray& ray : edgeRays)
+    {
+        WatertightRay watertightRay(ray);
+        int hitPrecomputed = 0;
+        int hitWatertight  = 0;
+        for(const TriangleBlock& block : gridBlocks)
+        {
+            hitPrecomputed |= block.Intersect(ray, 0.0f, tmax, 0.0f, t, beta, gamma);
+            hitWatertight  |= block.IntersectWatertight(watertightRay, 0.0f, tmax, t, beta, gamma);
+        }
+
+        missedPrecomputed += hitPrecomputed == 0;
+        missedWatertight  += hitWatertight == 0;
+    }
+
+    stream << "Rays through shared edges and vertices of a closed grid: " << edgeRays.size() << std::endl;
+    stream << "    precomputed, zero epsilon " << missedPrecomputed << " missed" << std::endl;
+    stream << "    watertight                " << missedWatertight << " missed" << std::endl;
+    stream.unsetf(std::ios_base::floatfield);
+}
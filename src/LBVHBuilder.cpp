@@ -0,0 +1,535 @@
+#include <LBVHBuilder.h>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// The largest treelet restructured, its subset tables have 2^7 entries
+const int LBVH_MAX_TREELET_SIZE = 7;
+
+
+// Spreads the lowest 21 bits of x so two zero bits follow each of them
+static uint64_t expandBits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x <<  8) & 0x100f00f00f00f00full;
+    x = (x | x <<  4) & 0x10c30c30c30c30c3ull;
+    x = (x | x <<  2) & 0x1249249249249249ull;
+
+    return x;
+}
+
+static int lowestBit(int mask)
+{
+    int bit = 0;
+    while(!(mask & (1 << bit)))
+        bit++;
+
+    return bit;
+}
+
+// Runs task(chunk, start, end) over count items split into chunkCount chunks
+template<typename Task>
+static void runChunks(ThreadPool* pool, int count, int chunkCount, const Task& task)
+{
+    if(chunkCount <= 1)
+    {
+        task(0, 0, count);
+        return;
+    }
+
+    TaskGroup tasks(*pool);
+    for(int c=0; c<chunkCount; c++)
+    {
+        int chunkStart = (long long)count * c / chunkCount;
+        int chunkEnd   = (long long)count * (c + 1) / chunkCount;
+        tasks.Run([&task, c, chunkStart, chunkEnd]()
+        {
+            task(c, chunkStart, chunkEnd);
+        });
+    }
+    tasks.Wait();
+}
+
+LBVHBuilder::LBVHBuilder(const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids, const BVHSettings& settings,
+                         std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices)
+    : primitiveBounds(primitiveBounds), centroids(centroids), settings(settings), nodes(nodes), primitiveIndices(primitiveIndices)
+{
+    this->settings.maxLeafSize = std::max(1, this->settings.maxLeafSize);
+    this->settings.maxDepth    = std::min(BVH_STACK_SIZE - 32, this->settings.maxDepth);
+    this->settings.treeletSize = std::min(LBVH_MAX_TREELET_SIZE, this->settings.treeletSize);
+
+    threadCount   = BVHBuildThreadCount(this->settings);
+    parallelDepth = BVHParallelDepth(threadCount);
+}
+
+// Cost of intersecting count primitives in a leaf, a subtree whose cost
+// equals this is collapsed into a leaf
+float LBVHBuilder::leafCost(int count, const AABB& box) const
+{
+    return settings.leafCost * count * box.SurfaceArea();
+}
+
+// Quantizes the centroids to 10 or 21 bits per axis inside their bounds and
+// interleaves them, x holds the highest bit of every triple
+void LBVHBuilder::computeMortonCodes()
+{
+    int count = centroids.size();
+    int bitsPerAxis = settings.mortonBits == 30 ? 10 : 21;
+    float maxValue = (float)((1 << bitsPerAxis) - 1);
+
+    AABB centroidBox;
+    for(const glm::vec3& centroid : centroids)
+        centroidBox.Extend(centroid);
+
+    glm::vec3 scale;
+    for(int a=0; a<3; a++)
+    {
+        float extent = centroidBox.bounds[1][a] - centroidBox.bounds[0][a];
+        scale[a] = extent > 0.0f ? maxValue / extent : 0.0f;
+    }
+
+    mortonCodes.resize(count);
+    runChunks(settings.pool, count, std::min(threadCount, count / BVH_PARALLEL_BINNING_THRESHOLD), [&](int, int start, int end)
+    {
+        for(int i=start; i<end; i++)
+        {
+            uint64_t code = 0;
+            for(int a=0; a<3; a++)
+            {
+                float value = (centroids[i][a] - centroidBox.bounds[0][a]) * scale[a];
+                uint64_t quantized = (uint64_t)std::min(maxValue, std::max(0.0f, value));
+                code |= expandBits(quantized) << (2 - a);
+            }
+            mortonCodes[i] = code;
+        }
+    });
+}
+
+// Least significant digit radix sort of the codes together with
+// primitiveIndices, 8 bits per pass. Every chunk counts its digits, the
+// offsets are laid out digit by digit and chunk by chunk so the scatter is
+// stable. Passes whose digit is the same for every code are skipped.
+void LBVHBuilder::sortMortonCodes()
+{
+    int count = mortonCodes.size();
+    int chunkCount = std::max(1, std::min(threadCount, count / BVH_PARALLEL_BINNING_THRESHOLD));
+    int codeBits = settings.mortonBits == 30 ? 30 : 63;
+
+    std::vector<uint64_t> codeBuffer(count);
+    std::vector<int> indexBuffer(count);
+    std::vector<int> offsets(chunkCount * 256);
+
+    for(int shift=0; shift<codeBits; shift+=8)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+
+        runChunks(settings.pool, count, chunkCount, [&](int c, int start, int end)
+        {
+            int* histogram = offsets.data() + c * 256;
+            for(int i=start; i<end; i++)
+                histogram[(mortonCodes[i] >> shift) & 0xff]++;
+        });
+
+        bool skip = false;
+        int total = 0;
+        for(int d=0; d<256; d++)
+        {
+            int digitCount = 0;
+            for(int c=0; c<chunkCount; c++)
+            {
+                int n = offsets[c * 256 + d];
+                offsets[c * 256 + d] = total;
+                total += n;
+                digitCount += n;
+            }
+            skip = skip || digitCount == count;
+        }
+
+        if(skip)
+            continue;
+
+        runChunks(settings.pool, count, chunkCount, [&](int c, int start, int end)
+        {
+            int* offset = offsets.data() + c * 256;
+            for(int i=start; i<end; i++)
+            {
+                int destination = offset[(mortonCodes[i] >> shift) & 0xff]++;
+                codeBuffer[destination]  = mortonCodes[i];
+                indexBuffer[destination] = primitiveIndices[i];
+            }
+        });
+
+        mortonCodes.swap(codeBuffer);
+        primitiveIndices.swap(indexBuffer);
+    }
+}
+
+// Emits the subtree over the sorted range [start, end). All codes of the range
+// agree above bit, the range is split where the highest differing bit flips.
+// Returns the index of the subtree root in out.
+int LBVHBuilder::emit(int start, int end, int bit, int depth, std::vector<LBVHNode>& out)
+{
+    int nodeIndex = out.size();
+    out.push_back(LBVHNode());
+    out[nodeIndex].count = end - start;
+
+    int count = end - start;
+    int maxLeafSize = std::numeric_limits<uint16_t>::max();
+
+    // Single primitives, subtrees are collapsed into larger leaves when flattening
+    if(count == 1 || (depth >= settings.maxDepth && count <= maxLeafSize))
+    {
+        AABB box;
+        for(int i=start; i<end; i++)
+            box.Extend(primitiveBounds[primitiveIndices[i]]);
+
+        out[nodeIndex].box   = box;
+        out[nodeIndex].start = start;
+        out[nodeIndex].cost  = leafCost(count, box);
+        return nodeIndex;
+    }
+
+    int middle = -1;
+    while(bit >= 0 && depth < settings.maxDepth)
+    {
+        uint64_t mask = 1ull << bit;
+        if((mortonCodes[start] & mask) != (mortonCodes[end - 1] & mask))
+        {
+            middle = std::partition_point(mortonCodes.begin() + start, mortonCodes.begin() + end, [mask](uint64_t code)
+            {
+                return !(code & mask);
+            }) - mortonCodes.begin();
+            break;
+        }
+        bit--;
+    }
+
+    // Identical codes, or too deep, fall back to an even split
+    if(middle == -1)
+    {
+        middle = start + count / 2;
+        bit = 0;
+    }
+
+    int left, right;
+    if(depth < parallelDepth && count >= BVH_PARALLEL_BUILD_THRESHOLD)
+    {
+        std::vector<LBVHNode> rightNodes;
+        TaskGroup rightTask(*settings.pool);
+        rightTask.Run([&]()
+        {
+            emit(middle, end, bit - 1, depth + 1, rightNodes);
+        });
+
+        left = emit(start, middle, bit - 1, depth + 1, out);
+        rightTask.Wait();
+
+        int offset = out.size();
+        for(LBVHNode& node : rightNodes)
+        {
+            if(node.child[0] != -1)
+            {
+                node.child[0] += offset;
+                node.child[1] += offset;
+            }
+            out.push_back(node);
+        }
+        right = offset;
+    }
+    else
+    {
+        left  = emit(start, middle, bit - 1, depth + 1, out);
+        right = emit(middle, end, bit - 1, depth + 1, out);
+    }
+
+    AABB box = out[left].box;
+    box.Extend(out[right].box);
+
+    out[nodeIndex].box      = box;
+    out[nodeIndex].child[0] = left;
+    out[nodeIndex].child[1] = right;
+    out[nodeIndex].cost     = settings.traversalCost * box.SurfaceArea() + out[left].cost + out[right].cost;
+    if(count <= settings.maxLeafSize)
+        out[nodeIndex].cost = std::min(out[nodeIndex].cost, leafCost(count, box));
+
+    return nodeIndex;
+}
+
+void LBVHBuilder::emitTree()
+{
+    int bitsPerAxis = settings.mortonBits == 30 ? 10 : 21;
+
+    tree.clear();
+    tree.reserve(2 * primitiveBounds.size());
+    emit(0, primitiveBounds.size(), 3 * bitsPerAxis - 1, 0, tree);
+}
+
+// Restructures every treelet bottom-up so each one sees optimized subtrees
+// below it. Sibling subtrees are disjoint and are processed on separate tasks.
+void LBVHBuilder::restructure(int nodeIndex, int depth)
+{
+    const LBVHNode& node = tree[nodeIndex];
+    if(node.child[0] == -1)
+        return;
+
+    if(depth < parallelDepth && node.count >= BVH_PARALLEL_BUILD_THRESHOLD)
+    {
+        TaskGroup rightTask(*settings.pool);
+        rightTask.Run([&]()
+        {
+            restructure(node.child[1], depth + 1);
+        });
+        restructure(node.child[0], depth + 1);
+        rightTask.Wait();
+    }
+    else
+    {
+        restructure(node.child[0], depth + 1);
+        restructure(node.child[1], depth + 1);
+    }
+
+    restructureTreelet(nodeIndex);
+}
+
+// Grows a treelet below root by repeatedly opening its largest interior leaf,
+// then finds the binary topology over the treelet leaves with the lowest
+// surface area heuristic cost by dynamic programming over leaf subsets. The
+// interior nodes are reused, so nothing outside the treelet changes.
+void LBVHBuilder::restructureTreelet(int root)
+{
+    const int subsetCapacity = 1 << LBVH_MAX_TREELET_SIZE;
+
+    // The subtrees below were restructured after the cost of root was
+    // computed. It is refreshed before the gain test, and so it is also
+    // exact when the treelet stays as it is.
+    LBVHNode& rootNode = tree[root];
+    rootNode.cost = settings.traversalCost * rootNode.box.SurfaceArea() + tree[rootNode.child[0]].cost + tree[rootNode.child[1]].cost;
+    if(rootNode.count <= settings.maxLeafSize)
+        rootNode.cost = std::min(rootNode.cost, leafCost(rootNode.count, rootNode.box));
+
+    int leaves[LBVH_MAX_TREELET_SIZE];
+    int interiors[LBVH_MAX_TREELET_SIZE - 1];
+    int leafCount = 2;
+    int interiorCount = 1;
+
+    leaves[0] = tree[root].child[0];
+    leaves[1] = tree[root].child[1];
+    interiors[0] = root;
+
+    while(leafCount < settings.treeletSize)
+    {
+        int best = -1;
+        float bestArea = -1.0f;
+        for(int i=0; i<leafCount; i++)
+        {
+            const LBVHNode& leaf = tree[leaves[i]];
+            if(leaf.child[0] != -1 && leaf.box.SurfaceArea() > bestArea)
+            {
+                best = i;
+                bestArea = leaf.box.SurfaceArea();
+            }
+        }
+
+        if(best == -1)
+            break;
+
+        int opened = leaves[best];
+        interiors[interiorCount++] = opened;
+        leaves[best] = tree[opened].child[0];
+        leaves[leafCount++] = tree[opened].child[1];
+    }
+
+    // Three leaves are needed before there is more than one topology
+    if(leafCount < 3)
+        return;
+
+    AABB boxes[subsetCapacity];
+    float costs[subsetCapacity];
+    int counts[subsetCapacity];
+    int partitions[subsetCapacity];
+
+    int subsetCount = 1 << leafCount;
+    for(int s=1; s<subsetCount; s++)
+    {
+        int lowest = s & -s;
+        const LBVHNode& lowestLeaf = tree[leaves[lowestBit(s)]];
+
+        if(s == lowest)
+        {
+            boxes[s]  = lowestLeaf.box;
+            costs[s]  = lowestLeaf.cost;
+            counts[s] = lowestLeaf.count;
+            continue;
+        }
+
+        boxes[s] = boxes[s ^ lowest];
+        boxes[s].Extend(lowestLeaf.box);
+        counts[s] = counts[s ^ lowest] + lowestLeaf.count;
+
+        // Only partitions holding the lowest leaf on their first side, the
+        // mirrored ones cost the same
+        float bestCost = FLT_MAX;
+        for(int p=(s - 1) & s; p; p=(p - 1) & s)
+        {
+            if(!(p & lowest))
+                continue;
+
+            float cost = costs[p] + costs[s ^ p];
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                partitions[s] = p;
+            }
+        }
+
+        costs[s] = settings.traversalCost * boxes[s].SurfaceArea() + bestCost;
+        if(counts[s] <= settings.maxLeafSize)
+            costs[s] = std::min(costs[s], leafCost(counts[s], boxes[s]));
+    }
+
+    // The current topology is one of the candidates, only rebuild on a real gain
+    int full = subsetCount - 1;
+    if(costs[full] >= tree[root].cost * 0.9999f)
+        return;
+
+    int stackSubsets[LBVH_MAX_TREELET_SIZE];
+    int stackNodes[LBVH_MAX_TREELET_SIZE];
+    int stackSize = 0;
+    int nextInterior = 1;
+
+    stackSubsets[stackSize] = full;
+    stackNodes[stackSize++] = root;
+
+    while(stackSize > 0)
+    {
+        stackSize--;
+        int s = stackSubsets[stackSize];
+        LBVHNode& node = tree[stackNodes[stackSize]];
+
+        node.box   = boxes[s];
+        node.cost  = costs[s];
+        node.count = counts[s];
+
+        int parts[2] = {partitions[s], s ^ partitions[s]};
+        for(int i=0; i<2; i++)
+        {
+            if((parts[i] & (parts[i] - 1)) == 0)
+            {
+                node.child[i] = leaves[lowestBit(parts[i])];
+                continue;
+            }
+
+            node.child[i] = interiors[nextInterior++];
+            stackSubsets[stackSize] = parts[i];
+            stackNodes[stackSize++] = node.child[i];
+        }
+    }
+}
+
+int LBVHBuilder::treeDepth(int nodeIndex) const
+{
+    const LBVHNode& node = tree[nodeIndex];
+    if(node.child[0] == -1)
+        return 1;
+
+    return 1 + std::max(treeDepth(node.child[0]), treeDepth(node.child[1]));
+}
+
+void LBVHBuilder::gatherPrimitives(int nodeIndex, std::vector<int>& out) const
+{
+    const LBVHNode& node = tree[nodeIndex];
+    if(node.child[0] == -1)
+    {
+        out.insert(out.end(), primitiveIndices.begin() + node.start, primitiveIndices.begin() + node.start + node.count);
+        return;
+    }
+
+    gatherPrimitives(node.child[0], out);
+    gatherPrimitives(node.child[1], out);
+}
+
+// Writes the subtree depth first into nodes and its primitives in leaf order
+// into orderedIndices. Subtrees cheaper as a leaf become one. The child with
+// the smaller center along the axis separating them most goes left, traversal
+// uses the axis to visit the nearer child first.
+void LBVHBuilder::flatten(int nodeIndex, std::vector<int>& orderedIndices)
+{
+    const LBVHNode& node = tree[nodeIndex];
+
+    int index = nodes.size();
+    nodes.push_back(BVHNode());
+    nodes[index].box  = node.box;
+    nodes[index].axis = 0;
+    nodes[index].pad  = 0;
+
+    bool collapse = node.count <= settings.maxLeafSize && node.cost == leafCost(node.count, node.box);
+    if(node.child[0] == -1 || collapse)
+    {
+        nodes[index].primitiveOffset = orderedIndices.size();
+        nodes[index].primitiveCount  = node.count;
+        gatherPrimitives(nodeIndex, orderedIndices);
+        return;
+    }
+
+    int left  = node.child[0];
+    int right = node.child[1];
+
+    glm::vec3 delta = (tree[right].box.bounds[0] + tree[right].box.bounds[1]) - (tree[left].box.bounds[0] + tree[left].box.bounds[1]);
+    int axis = 0;
+    for(int a=1; a<3; a++)
+    {
+        if(std::abs(delta[a]) > std::abs(delta[axis]))
+            axis = a;
+    }
+
+    if(delta[axis] < 0.0f)
+        std::swap(left, right);
+
+    nodes[index].axis = axis;
+    nodes[index].primitiveCount = 0;
+
+    flatten(left, orderedIndices);
+    nodes[index].secondChildOffset = nodes.size();
+    flatten(right, orderedIndices);
+}
+
+void LBVHBuilder::Build()
+{
+    nodes.clear();
+    primitiveIndices.resize(primitiveBounds.size());
+    for(size_t i=0; i<primitiveBounds.size(); i++)
+    {
+        primitiveIndices[i] = i;
+    }
+
+    if(primitiveBounds.empty())
+        return;
+
+    computeMortonCodes();
+    sortMortonCodes();
+    emitTree();
+
+    if(settings.treeletSize >= 3)
+    {
+        int depth = treeDepth(0);
+        restructure(0, 0);
+
+        // Restructuring may deepen the tree, keep it within the traversal stacks
+        if(treeDepth(0) > std::max(depth, settings.maxDepth))
+            emitTree();
+    }
+
+    std::vector<int> orderedIndices;
+    orderedIndices.reserve(primitiveIndices.size());
+    nodes.reserve(tree.size());
+    flatten(0, orderedIndices);
+    nodes.shrink_to_fit();
+    primitiveIndices.swap(orderedIndices);
+
+    tree.clear();
+    tree.shrink_to_fit();
+    mortonCodes.clear();
+    mortonCodes.shrink_to_fit();
+}
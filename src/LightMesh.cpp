@@ -1,22 +1,28 @@
 #include <LightMesh.h>
 
 
-LightMesh::LightMesh(const std::vector<Triangle>& triangleList, size_t materialId, bool softShadingFlag) : Mesh(triangleList, materialId, softShadingFlag)
+LightMesh::LightMesh(MeshGeometry* geometry, BVH* bvh, size_t materialId, bool softShadingFlag) : Mesh(geometry, bvh, materialId, softShadingFlag)
 {
     this->randomGenerator =  new RandomGenerator(0.0f, 1.0f);
-    this->triangleList    = triangleList;
     this->totalArea       = 0.0f;
 
-    // we sort triangle list according to their areas in ascending order
-    std::sort(this->triangleList.begin(), this->triangleList.end(),
-    [](const Triangle& t1, Triangle& t2) -> bool
+    std::vector<float> areas(geometry->FaceCount());
+    for(size_t i=0; i<geometry->FaceCount(); i++)
     {
-        return t1.area > t2.area;
+        areas[i] = geometry->FaceArea(i);
+        this->facesByArea.push_back(i);
+    }
+
+    // we sort the faces according to their areas in descending order
+    std::sort(this->facesByArea.begin(), this->facesByArea.end(),
+    [&areas](int f1, int f2) -> bool
+    {
+        return areas[f1] > areas[f2];
     });
 
-    for(size_t i=0; i<this->triangleList.size(); i++)
+    for(size_t i=0; i<this->facesByArea.size(); i++)
     {
-        this->totalArea += this->triangleList[i].area;
+        this->totalArea += areas[this->facesByArea[i]];
     }
 
 
@@ -29,29 +35,20 @@ LightMesh::~LightMesh()
 }
 
 
-bool LightMesh::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
+bool LightMesh::ShadowRayIntersection(const glm::vec3& lightPosition, float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                        const IntersectionReport& report, bool backfaceCulling,
-                                       float time, std::vector<Object *>& objectPointerVector)
+                                       float time, TopLevelBVH& topLevelBVH) const
 {
 
-    glm::vec3 direction = glm::normalize(randomPosition - report.intersection);
+    glm::vec3 direction = glm::normalize(lightPosition - report.intersection);
     glm::vec3 origin    = report.intersection + shadowRayEpsilon*report.normal;
 
     Ray ray(origin, direction);
     ray.time = time;
 
-    float dist = glm::length(randomPosition - report.intersection);
-
-    for(auto object : objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling) && r.d < dist && !r.isLight)
-        {
-            return true;
-        }
-    }
+    float dist = glm::length(lightPosition - report.intersection);
 
-    return false;
+    return topLevelBVH.Occluded(ray, tmin, std::min(tmax, dist), intersectionTestEpsilon, backfaceCulling, nullptr, true);
 
 
 }
@@ -60,13 +57,14 @@ bool LightMesh::ShadowRayIntersection(float tmin, float tmax, float intersection
 glm::vec3 LightMesh::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                             const float& phongExponent, const IntersectionReport& report,
                                             float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                            bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                                            bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
 {
 
-    SampleRandomPosition(ray, report, tmin, tmax, intersectionTestEpsilon, backfaceCulling);
+    glm::vec3 randomPosition, randomNormal;
+    SampleRandomPosition(ray, randomPosition, randomNormal);
     glm::vec3 result = glm::vec3(0.0);
 
-    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, objectPointerVector))
+    if(ShadowRayIntersection(randomPosition, tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, topLevelBVH))
     {
         return glm::vec3(0.0);
     }
@@ -121,7 +119,7 @@ glm::vec3 LightMesh::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseRe
     return result;   
 }
 
-void LightMesh::SampleRandomPosition(const Ray& ray, const IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+void LightMesh::SampleRandomPosition(const Ray& ray, glm::vec3& position, glm::vec3& normal) const
 {
     // We need to sample a direction to the light source first
     // We take square root and we want to push the value
@@ -130,59 +128,57 @@ void LightMesh::SampleRandomPosition(const Ray& ray, const IntersectionReport& r
     // more probability to be selected.
     float randomValue = std::pow(this->randomGenerator->Generate(), 1.0/2.0);
 
-    randomValue *= this->triangleList.size() - 1;
+    randomValue *= this->facesByArea.size() - 1;
     int index = std::round(randomValue);
 
-
-
-    Triangle selectedTriangle = this->triangleList[index];
+    int selectedFace = this->facesByArea[index];
+    const glm::vec3& a = geometry->vertices[geometry->faces[selectedFace].a];
+    const glm::vec3& b = geometry->vertices[geometry->faces[selectedFace].b];
+    const glm::vec3& c = geometry->vertices[geometry->faces[selectedFace].c];
 
     // we now sample a point on the selected triangle
-    float tSampleRand1 = std::sqrt(this->randomGenerator->Generate());
-    float tSampleRand2 = this->randomGenerator->Generate();
+    float tSampleRand1, tSampleRand2;
+    this->randomGenerator->Generate2D(tSampleRand1, tSampleRand2);
+    tSampleRand1 = std::sqrt(tSampleRand1);
 
-    glm::vec3 p = (1-tSampleRand2)*selectedTriangle.b + tSampleRand2*selectedTriangle.c;
+    glm::vec3 p = (1-tSampleRand2)*b + tSampleRand2*c;
 
     // the point we have found is in the local coordinates of the mesh
-    glm::vec3 sampledPoint = tSampleRand1*p + (1-tSampleRand1)*selectedTriangle.a;
+    glm::vec3 sampledPoint = tSampleRand1*p + (1-tSampleRand1)*a;
 
     // we transform sampledPoint to world coordinates
-    glm::mat4 motionBlurTranslationMatrix = MotionBlurTranslate(ray.time);    
-    glm::mat4 tMat   = MotionBlurTranslate2(ray.time) * transformationMatrix;
-    glm::mat4 tMatIT = glm::transpose(motionBlurTranslationMatrix) * transformationMatrixInverseTransposed;
-    glm::vec3 worldPoint =(tMat * glm::vec4(sampledPoint, 1.0f));
+    glm::vec3 worldPoint = PointToWorldSpace(sampledPoint, ray.time);
 
-    glm::vec3 worldNormal = (tMatIT * glm::vec4(selectedTriangle.normal, 0.0f));
+    glm::vec3 worldNormal = NormalToWorldSpace(geometry->faceNormals[selectedFace]);
     worldNormal = glm::normalize(worldNormal);
 
-    this->randomPosition = worldPoint;
-    this->randomNormal   = worldNormal;
+    position = worldPoint;
+    normal   = worldNormal;
 
 }
 
-bool LightMesh::Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+bool LightMesh::Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
 {
+    Ray newRay = RayToObjectSpace(ray);
 
-    glm::mat4 motionBlurTranslationMatrix = MotionBlurTranslate(ray.time);
-    glm::mat4 nTMI = transformationMatrixInversed * motionBlurTranslationMatrix;
-    glm::mat4 nTMIT = glm::transpose(motionBlurTranslationMatrix) * transformationMatrixInverseTransposed;
+    TriangleHit triangleHit;
+    if(!bvhRoot->Intersect(newRay, triangleHit, tmin, tmax, intersectionEpsilon, softShadingFlag, backfaceCulling))
+        return false;
 
+    hit.t           = triangleHit.t;
+    hit.primitiveId = triangleHit.face;
+    hit.beta        = triangleHit.beta;
+    hit.gamma       = triangleHit.gamma;
+    hit.object      = this;
 
-    glm::vec3 newOrigin = (nTMI * glm::vec4(ray.origin, 1.0f));
-    glm::vec3 newDirection = (nTMI * glm::vec4(ray.direction, 0.0f));
-    Ray newRay(newOrigin, newDirection);
-
-    bool test = bvhRoot->Intersect(newRay, report, tmin, tmax, intersectionEpsilon, softShadingFlag, nTMIT, backfaceCulling);
+    return true;
+}
 
+void LightMesh::ComputeSurfaceInteraction(const Ray&, const HitRecord& hit, IntersectionReport& report)
+{
     report.materialId = materialId;
     report.isLight    = true;
-    report.radiance = ((radiance * totalArea)/(1.0f));
-    report.hitObject = this;
-
-    if(test)
-    {
-        report.intersection = ray.origin + ray.direction * report.d;
-    }
+    report.radiance   = ((radiance * totalArea)/(1.0f));
 
-    return test;
+    geometry->ComputeHit(hit.primitiveId, hit.beta, hit.gamma, softShadingFlag, normalToWorldMatrix, report);
 }
\ No newline at end of file
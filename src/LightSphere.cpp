@@ -11,27 +11,20 @@ LightSphere::~LightSphere()
     //delete randomGenerator;
 }
 
-bool LightSphere::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
+bool LightSphere::ShadowRayIntersection(const glm::vec3& lightPosition, float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                         const IntersectionReport& report, bool backfaceCulling,
-                                        float time, std::vector<Object *>& objectPointerVector)
+                                        float time, TopLevelBVH& topLevelBVH) const
 {
 
-    glm::vec3 direction = glm::normalize(randomPosition - report.intersection);
+    glm::vec3 direction = glm::normalize(lightPosition - report.intersection);
     glm::vec3 origin    = report.intersection + shadowRayEpsilon*report.normal;
 
     Ray ray(origin, direction);
     ray.time = time;
 
-    float dist = glm::length(randomPosition - report.intersection);
+    float dist = glm::length(lightPosition - report.intersection);
 
-    for(auto object : objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling) && r.d < dist && r.hitObject != this)
-            return true;
-    }
-
-    return false;
+    return topLevelBVH.Occluded(ray, tmin, std::min(tmax, dist), intersectionTestEpsilon, backfaceCulling, this);
 
 }          
 
@@ -39,15 +32,16 @@ bool LightSphere::ShadowRayIntersection(float tmin, float tmax, float intersecti
 glm::vec3 LightSphere::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                               const float& phongExponent, const IntersectionReport& report,
                                               float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                              bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                                              bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
 {
-    bool test = SampleRandomPosition(ray, report, tmin, tmax, intersectionTestEpsilon, backfaceCulling);
+    glm::vec3 randomPosition;
+    bool test = SampleRandomPosition(ray, report, tmin, tmax, intersectionTestEpsilon, randomPosition);
     if(!test)
         return glm::vec3(0.0f);
 
     glm::vec3 result = glm::vec3(0.0f);
 
-    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, objectPointerVector))
+    if(ShadowRayIntersection(randomPosition, tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, backfaceCulling, ray.time, topLevelBVH))
     {
         return glm::vec3(0.0);
     }
@@ -106,7 +100,7 @@ glm::vec3 LightSphere::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuse
 
 }
 
-OrthonormalBasis LightSphere::GiveOrthonormalBasis(glm::vec3 direction)
+OrthonormalBasis LightSphere::GiveOrthonormalBasis(glm::vec3 direction) const
 {
     OrthonormalBasis result;
     glm::vec3 nVec = direction;
@@ -131,24 +125,21 @@ OrthonormalBasis LightSphere::GiveOrthonormalBasis(glm::vec3 direction)
     return result;    
 }
 
-bool LightSphere::SampleRandomPosition(const Ray& ray, const IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+bool LightSphere::SampleRandomPosition(const Ray& ray, const IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, glm::vec3& position) const
 {
-    glm::mat4 motionBlurTranslationMatrix = MotionBlurTranslate(ray.time);
-    glm::mat4 nTMI = transformationMatrixInversed * motionBlurTranslationMatrix;
-
-    glm::vec3 localPoint = (nTMI * glm::vec4(report.intersection, 1.0f));
+    glm::vec3 localPoint = PointToObjectSpace(report.intersection, ray.time);
 
     glm::vec3 w = this->center - localPoint;
     float d = glm::length(w);
     w = glm::normalize(w);
 
-    float randomVal1 = randomGenerator->Generate();
-    float randomVal2 = randomGenerator->Generate();
+    float randomVal1, randomVal2;
+    randomGenerator->Generate2D(randomVal1, randomVal2);
 
     OrthonormalBasis onb = GiveOrthonormalBasis(w);
 
     float sinThetaMax2 = (radius*radius) / (d*d);
-    cosThetaMax = std::sqrt(std::max((float)0, 1 - sinThetaMax2));
+    float cosThetaMax = std::sqrt(std::max((float)0, 1 - sinThetaMax2));
     float cosTheta = (1 - randomVal1) + randomVal1 * cosThetaMax;
     float sinTheta = std::sqrt(std::max((float)0, 1 - cosTheta * cosTheta));
     float phi   = 2*M_PI*randomVal2;  
@@ -157,19 +148,16 @@ bool LightSphere::SampleRandomPosition(const Ray& ray, const IntersectionReport&
 
     glm::vec3 lLocal = w * std::cos(theta) + onb.u * std::sin(theta) * std::cos(phi) + onb.v * std::sin(theta) * std::sin(phi);
 
-    glm::mat4 tMat = MotionBlurTranslate2(ray.time) * transformationMatrix;
-    glm::vec3 lWorld = (tMat * glm::vec4(lLocal, 0.0f));
+    glm::vec3 lWorld = DirectionToWorldSpace(lLocal);
     lWorld = glm::normalize(lWorld);
     glm::vec3 pWorld = report.intersection + intersectionEpsilon*lWorld;
 
     Ray newRay(pWorld, lWorld);
-    IntersectionReport newReport;
-
-    bool test = Intersect(newRay, newReport, tmin, tmax, intersectionEpsilon, backfaceCulling);
+    float t;
 
-    if(test)
+    if(surfaceDistance(newRay, t) && t > tmin - intersectionEpsilon && t < tmax + intersectionEpsilon)
     {
-        randomPosition = newReport.intersection;
+        position = newRay.origin + t*newRay.direction;
         return true;
     }
 
@@ -177,65 +165,15 @@ bool LightSphere::SampleRandomPosition(const Ray& ray, const IntersectionReport&
 
 }
 
-bool LightSphere::Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+void LightSphere::ComputeSurfaceInteraction(const Ray& ray, const HitRecord& hit, IntersectionReport& report)
 {
-    glm::mat4 motionBlurTranslationMatrix = MotionBlurTranslate(ray.time);
-
-    glm::vec3 newOrigin = (transformationMatrixInversed*motionBlurTranslationMatrix*glm::vec4(ray.origin, 1.0f));
-    glm::vec3 newDirection = (transformationMatrixInversed*motionBlurTranslationMatrix*glm::vec4(ray.direction, 0.0f));
-    Ray newRay(newOrigin, newDirection);
-
-    report.intersection = glm::vec3(-FLT_MAX);
-    report.d            = FLT_MAX;
-    report.isLight      = true;
-
-    float discriminant = pow(glm::dot(newRay.direction, (newRay.origin - center)), 2) -
-                         dot(newRay.direction, newRay.direction) * (glm::dot(newRay.origin - center, newRay.origin - center) -
-                         radius * radius);
-
-    float t;
-
-    if(discriminant >= 0)
-    {
-        float t1 = -(glm::dot(newRay.direction, (newRay.origin - center)) + sqrt(discriminant)) / glm::dot(newRay.direction, newRay.direction);
-        float t2 = -(glm::dot(newRay.direction, (newRay.origin - center)) - sqrt(discriminant)) / glm::dot(newRay.direction, newRay.direction);
-
-        t = std::min(t1, t2);
-
-        if(t1 * t2 < 0)
-            t = std::max(t1, t2);
-
-        if(t > tmin - intersectionEpsilon && t < tmax + intersectionEpsilon)
-        {
-            report.d            = t;
-            report.intersection = ray.origin + t*ray.direction;
-            report.hitObject    = this;
-            
-            float cosThetaMax = std::sqrt(1 - (radius*radius)/(radius*radius));            
-            float invProb = 2 * M_PI * (1 - cosThetaMax);
-
-            report.radiance     = radiance * invProb;
-            report.materialId   = materialId;
-            glm::vec3 normal = (newRay.origin + t*newRay.direction) - center;
-            report.normal       = glm::transpose(motionBlurTranslationMatrix)*transformationMatrixInverseTransposed * glm::vec4(normal, 0.0f);
-            report.normal = glm::normalize(report.normal);
-
-            glm::vec3 localIntersection = newRay.origin + t*newRay.direction;
-
-            float x = localIntersection.x - this->center.x;
-            float y = localIntersection.y - this->center.y;
-            float z = localIntersection.z - this->center.z;
-
-            float theta = std::acos(y/this->radius);
-            float phi   = std::atan2(z, x);
-
-            report.texCoord.x = (-phi + M_PI) / (2 * M_PI);
-            report.texCoord.y = theta / M_PI;            
+    float cosThetaMax = std::sqrt(1 - (radius*radius)/(radius*radius));
+    float invProb = 2 * M_PI * (1 - cosThetaMax);
 
-            return true;
-        }
-      
-    }
+    report.materialId = materialId;
+    report.isLight    = true;
+    report.radiance   = radiance * invProb;
 
-    return false;
-}
\ No newline at end of file
+    float theta, phi;
+    computeHit(ray, hit, report, theta, phi);
+}
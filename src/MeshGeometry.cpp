@@ -0,0 +1,109 @@
+#include <MeshGeometry.h>
+
+
+int MeshGeometry::AddVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoord)
+{
+    vertices.push_back(position);
+    normals.push_back(normal);
+    texCoords.push_back(texCoord);
+
+    return vertices.size() - 1;
+}
+
+void MeshGeometry::AddFace(int a, int b, int c)
+{
+    Indices face;
+    face.a = a;
+    face.b = b;
+    face.c = c;
+
+    faces.push_back(face);
+    faceNormals.push_back(glm::normalize(glm::cross((vertices[b]-vertices[a]), (vertices[c]-vertices[a]))));
+}
+
+void MeshGeometry::Transform(const glm::mat4& matrix)
+{
+    glm::mat3 linear(matrix);
+    glm::vec3 offset(matrix[3]);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+
+    for(glm::vec3& vertex : vertices)
+        vertex = linear * vertex + offset;
+
+    // Vertex normals are left unnormalized, so smooth shading interpolates
+    // them exactly as it did in object space
+    for(glm::vec3& normal : normals)
+        normal = normalMatrix * normal;
+
+    for(glm::vec3& normal : faceNormals)
+        normal = glm::normalize(normalMatrix * normal);
+}
+
+size_t MeshGeometry::FaceCount() const
+{
+    return faces.size();
+}
+
+AABB MeshGeometry::FaceBounds(int face) const
+{
+    AABB box;
+    box.Extend(vertices[faces[face].a]);
+    box.Extend(vertices[faces[face].b]);
+    box.Extend(vertices[faces[face].c]);
+
+    return box;
+}
+
+glm::vec3 MeshGeometry::FaceCenter(int face) const
+{
+    glm::vec3 result = (vertices[faces[face].a] + vertices[faces[face].b] + vertices[faces[face].c]);
+    result.x /= 3;
+    result.y /= 3;
+    result.z /= 3;
+
+    return result;
+}
+
+float MeshGeometry::FaceArea(int face) const
+{
+    const glm::vec3& a = vertices[faces[face].a];
+    const glm::vec3& b = vertices[faces[face].b];
+    const glm::vec3& c = vertices[faces[face].c];
+
+    return glm::length(glm::cross(b-a, c-a))/2;
+}
+
+bool MeshGeometry::IsBackfacing(int face, const Ray& ray, float beta, float gamma, bool softShadingFlag) const
+{
+    const Indices& indices = faces[face];
+
+    // The sign test does not need the interpolated normal to be normalized
+    glm::vec3 n = softShadingFlag ? (1 - (beta + gamma))*normals[indices.a] + beta*normals[indices.b] + gamma*normals[indices.c] : faceNormals[face];
+
+    return glm::dot(ray.direction, n) > 0;
+}
+
+void MeshGeometry::ComputeHit(int face, float beta, float gamma, bool softShadingFlag, const glm::mat3& normalToWorldMatrix, IntersectionReport& report) const
+{
+    const Indices& indices = faces[face];
+
+    float alpha = 1 - (beta + gamma);
+
+    glm::vec3 normal;
+    if(softShadingFlag)
+        normal = glm::normalize(alpha*normals[indices.a] + beta*normals[indices.b] + gamma*normals[indices.c]);
+    else
+        normal = faceNormals[face];
+
+    report.normal       = normalToWorldMatrix * normal;
+    report.normal       = glm::normalize(report.normal);
+
+    report.texCoordA = texCoords[indices.a];
+    report.texCoordB = texCoords[indices.b];
+    report.texCoordC = texCoords[indices.c];
+
+    report.coordA = vertices[indices.a];
+    report.coordB = vertices[indices.b];
+    report.coordC = vertices[indices.c];
+    report.texCoord = alpha*report.texCoordA + beta*report.texCoordB + gamma*report.texCoordC;
+}
@@ -7,229 +7,265 @@ MeshInstance::MeshInstance()
 }
 
 
-bool MeshInstance::Intersect(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+bool MeshInstance::Occluded(const Ray& ray, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
 {
+    Ray newRay = RayToObjectSpace(ray);
 
-    glm::mat4 motionBlurTranslationMatrix = MotionBlurTranslate(ray.time);
-    glm::mat4 nTMI = transformationMatrixInversed * motionBlurTranslationMatrix;
-    glm::mat4 nTMIT = glm::transpose(motionBlurTranslationMatrix) * transformationMatrixInverseTransposed;
+    return mesh->bvhRoot->Occluded(newRay, tmin, tmax, intersectionEpsilon, mesh->softShadingFlag, backfaceCulling);
+}
+
+AABB MeshInstance::WorldBounds()
+{
+    return TransformBounds(mesh->bvhRoot->Bounds());
+}
+
+bool MeshInstance::Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+{
+    Ray newRay = RayToObjectSpace(ray);
+
+    TriangleHit triangleHit;
+    if(!mesh->bvhRoot->Intersect(newRay, triangleHit, tmin, tmax, intersectionEpsilon, mesh->softShadingFlag, backfaceCulling))
+        return false;
+
+    hit.t           = triangleHit.t;
+    hit.primitiveId = triangleHit.face;
+    hit.beta        = triangleHit.beta;
+    hit.gamma       = triangleHit.gamma;
+    hit.object      = this;
+
+    return true;
+}
 
-    glm::vec3 newOrigin = (nTMI * glm::vec4(ray.origin, 1.0f));
-    glm::vec3 newDirection = (nTMI * glm::vec4(ray.direction, 0.0f));
-    Ray newRay(newOrigin, newDirection);
+void MeshInstance::IntersectPacket(RayPacket& packet, int first, float tmin, float tmax, float intersectionEpsilon, bool backfaceCulling)
+{
+    TriangleHit triangleHits[RAY_PACKET_SIZE];
+    if(identityTransform && !moving)
+        mesh->bvhRoot->IntersectPacket(packet, first, triangleHits, tmin, tmax, intersectionEpsilon, mesh->softShadingFlag, backfaceCulling);
+    else
+        mesh->bvhRoot->IntersectPacket(PacketToObjectSpace(packet, first), first, triangleHits, tmin, tmax, intersectionEpsilon, mesh->softShadingFlag, backfaceCulling);
 
-    bool test = mesh->bvhRoot->Intersect(newRay, report, tmin, tmax, intersectionEpsilon, mesh->softShadingFlag, nTMIT, backfaceCulling);
+    for(int i=first; i<packet.count; i++)
+    {
+        const TriangleHit& triangleHit = triangleHits[i];
+        if(triangleHit.face < 0)
+            continue;
+
+        HitRecord& hit = packet.hits[i];
+        hit.t           = triangleHit.t;
+        hit.primitiveId = triangleHit.face;
+        hit.beta        = triangleHit.beta;
+        hit.gamma       = triangleHit.gamma;
+        hit.object      = this;
+    }
+}
 
+void MeshInstance::ComputeSurfaceInteraction(const Ray&, const HitRecord& hit, IntersectionReport& report)
+{
     report.materialId = materialId;
     report.isLight    = false;
-    if(test)
+
+    mesh->geometry->ComputeHit(hit.primitiveId, hit.beta, hit.gamma, mesh->softShadingFlag, normalToWorldMatrix, report);
+
+    if(this->diffuseMap)
     {
-        report.intersection = ray.origin + ray.direction * report.d;
-        report.hitObject    = this;
-        
-        if(this->diffuseMap)
+        report.replaceAll = false;
+        if(this->diffuseMap->decalMode == DecalMode::REPLACE_ALL)
+            report.replaceAll = true;
+        else if(this->diffuseMap->decalMode == DecalMode::REPLACE_KD)
+            report.texDiffuseKdMode = 1;
+        else if(this->diffuseMap->decalMode == DecalMode::BLEND_KD)
+            report.texDiffuseKdMode = 2;
+
+        if(this->diffuseMap->type == TextureType::IMAGE)
+        {
+            report.texDiffuseReflectance = this->diffuseMap->Fetch(report.texCoord.x, report.texCoord.y);
+        }
+        else if(this->diffuseMap->type == TextureType::PERLIN)
         {
-            report.replaceAll = false;
-            if(this->diffuseMap->decalMode == DecalMode::REPLACE_ALL)
-                report.replaceAll = true;
-            else if(this->diffuseMap->decalMode == DecalMode::REPLACE_KD)
-                report.texDiffuseKdMode = 1;
-            else if(this->diffuseMap->decalMode == DecalMode::BLEND_KD)
-                report.texDiffuseKdMode = 2;
-
-            if(this->diffuseMap->type == TextureType::IMAGE)
-            {
-                report.texDiffuseReflectance = this->diffuseMap->Fetch(report.texCoord.x, report.texCoord.y);
-            }
-            else if(this->diffuseMap->type == TextureType::PERLIN)
-            {
 
-                float perlin = this->diffuseMap->FetchPerlin(report.intersection);
-                // Veiny appearence
-                if(this->diffuseMap->noiseConversion == NoiseConversionType::ABSVAL)
-                {
-                    report.texDiffuseReflectance = glm::vec3(std::fabs(perlin));
-                }
-                // Patch appearence
-                else if(this->diffuseMap->noiseConversion == NoiseConversionType::LINEAR)
-                {
-                    report.texDiffuseReflectance = glm::vec3((perlin + 1)/2);
-                }
+            float perlin = this->diffuseMap->FetchPerlin(report.intersection);
+            // Veiny appearence
+            if(this->diffuseMap->noiseConversion == NoiseConversionType::ABSVAL)
+            {
+                report.texDiffuseReflectance = glm::vec3(std::fabs(perlin));
             }
-            else if(this->diffuseMap->type == TextureType::CHECKERBOARD)
+            // Patch appearence
+            else if(this->diffuseMap->noiseConversion == NoiseConversionType::LINEAR)
             {
-                // Will be implemented
+                report.texDiffuseReflectance = glm::vec3((perlin + 1)/2);
             }
-
-            report.diffuseActive = true;
         }
-        
-        if(this->specularMap)
+        else if(this->diffuseMap->type == TextureType::CHECKERBOARD)
         {
+            // Will be implemented
+        }
 
-            if(this->specularMap->decalMode == DecalMode::REPLACE_KD)
-                report.texSpecularKdMode = 1;
-            else if(this->specularMap->decalMode == DecalMode::BLEND_KD)
-                report.texSpecularKdMode = 2;
+        report.diffuseActive = true;
+    }
+    
+    if(this->specularMap)
+    {
 
-            if(this->specularMap->type == TextureType::IMAGE)
+        if(this->specularMap->decalMode == DecalMode::REPLACE_KD)
+            report.texSpecularKdMode = 1;
+        else if(this->specularMap->decalMode == DecalMode::BLEND_KD)
+            report.texSpecularKdMode = 2;
+
+        if(this->specularMap->type == TextureType::IMAGE)
+        {
+            report.texSpecularReflectance = this->specularMap->Fetch(report.texCoord.x, report.texCoord.y);
+        }
+        else if(this->diffuseMap->type == TextureType::PERLIN)
+        {
+
+            float perlin = this->diffuseMap->FetchPerlin(report.intersection);
+            // Veiny appearence
+            if(this->diffuseMap->noiseConversion == NoiseConversionType::ABSVAL)
             {
-                report.texSpecularReflectance = this->specularMap->Fetch(report.texCoord.x, report.texCoord.y);
+                report.texDiffuseReflectance = glm::vec3(std::fabs(perlin));
             }
-            else if(this->diffuseMap->type == TextureType::PERLIN)
+            // Patch appearence
+            else if(this->diffuseMap->noiseConversion == NoiseConversionType::LINEAR)
             {
-
-                float perlin = this->diffuseMap->FetchPerlin(report.intersection);
-                // Veiny appearence
-                if(this->diffuseMap->noiseConversion == NoiseConversionType::ABSVAL)
-                {
-                    report.texDiffuseReflectance = glm::vec3(std::fabs(perlin));
-                }
-                // Patch appearence
-                else if(this->diffuseMap->noiseConversion == NoiseConversionType::LINEAR)
-                {
-                    report.texDiffuseReflectance = glm::vec3((perlin + 1)/2);
-                }
+                report.texDiffuseReflectance = glm::vec3((perlin + 1)/2);
             }
-            else if(this->diffuseMap->type == TextureType::CHECKERBOARD)
-            {
-                // Will be implemented
-                int u = (report.intersection.x + this->diffuseMap->offset) * this->diffuseMap->scale;
-                int v = (report.intersection.z + this->diffuseMap->offset) * this->diffuseMap->scale;
-                
-                int uPv = u + v;
-
-                // white
-                if(uPv % 2 == 0)
-                {
-                    report.texDiffuseReflectance = this->diffuseMap->blackColor;
-                }
-                // black
-                else
-                {
-                    report.texDiffuseReflectance = this->diffuseMap->whiteColor;
-                }
-            } 
-
-            report.specularActive = true;
         }
-
-        if(this->normalMap)
+        else if(this->diffuseMap->type == TextureType::CHECKERBOARD)
         {
-            glm::vec3 fetchedNormal = this->normalMap->Fetch(report.texCoord.x, report.texCoord.y);
-            fetchedNormal.x /= 255;
-            fetchedNormal.y /= 255;
-            fetchedNormal.z /= 255;
+            // Will be implemented
+            int u = (report.intersection.x + this->diffuseMap->offset) * this->diffuseMap->scale;
+            int v = (report.intersection.z + this->diffuseMap->offset) * this->diffuseMap->scale;
+            
+            int uPv = u + v;
+
+            // white
+            if(uPv % 2 == 0)
+            {
+                report.texDiffuseReflectance = this->diffuseMap->blackColor;
+            }
+            // black
+            else
+            {
+                report.texDiffuseReflectance = this->diffuseMap->whiteColor;
+            }
+        } 
 
-            fetchedNormal -= glm::vec3(0.5, 0.5, 0.5);
-            fetchedNormal = glm::normalize(fetchedNormal);
+        report.specularActive = true;
+    }
 
-            glm::vec3 e1 = report.coordB - report.coordA;
-            glm::vec3 e2 = report.coordC - report.coordA;
+    if(this->normalMap)
+    {
+        glm::vec3 fetchedNormal = this->normalMap->Fetch(report.texCoord.x, report.texCoord.y);
+        fetchedNormal.x /= 255;
+        fetchedNormal.y /= 255;
+        fetchedNormal.z /= 255;
 
-            glm::mat2 A_Inverse = glm::inverse(glm::mat2(glm::vec2(report.texCoordB.x - report.texCoordA.x, report.texCoordC.x - report.texCoordA.x),
-                                                         glm::vec2(report.texCoordB.y - report.texCoordA.y, report.texCoordC.y - report.texCoordA.y)));
+        fetchedNormal -= glm::vec3(0.5, 0.5, 0.5);
+        fetchedNormal = glm::normalize(fetchedNormal);
 
-            glm::mat3x2 E(glm::vec2(e1.x, e2.x),
-                          glm::vec2(e1.y, e2.y),
-                          glm::vec2(e1.z, e2.z));
+        glm::vec3 e1 = report.coordB - report.coordA;
+        glm::vec3 e2 = report.coordC - report.coordA;
 
-            glm::mat2x3 TB = glm::transpose(A_Inverse * E);
-            glm::mat3 TBN(TB[0], TB[1], report.normal);
-            report.normal = TBN * fetchedNormal;
-        }
-        else if(this->bumpMap)
+        glm::mat2 A_Inverse = glm::inverse(glm::mat2(glm::vec2(report.texCoordB.x - report.texCoordA.x, report.texCoordC.x - report.texCoordA.x),
+                                                     glm::vec2(report.texCoordB.y - report.texCoordA.y, report.texCoordC.y - report.texCoordA.y)));
+
+        glm::mat3x2 E(glm::vec2(e1.x, e2.x),
+                      glm::vec2(e1.y, e2.y),
+                      glm::vec2(e1.z, e2.z));
+
+        glm::mat2x3 TB = glm::transpose(A_Inverse * E);
+        glm::mat3 TBN(TB[0], TB[1], report.normal);
+        report.normal = TBN * fetchedNormal;
+    }
+    else if(this->bumpMap)
+    {
+        if(this->bumpMap->type != TextureType::PERLIN)
         {
-            if(this->bumpMap->type != TextureType::PERLIN)
-            {
-                glm::vec3 e1 = glm::normalize(report.coordB - report.coordA);
-                glm::vec3 e2 = glm::normalize(report.coordC - report.coordA);
+            glm::vec3 e1 = glm::normalize(report.coordB - report.coordA);
+            glm::vec3 e2 = glm::normalize(report.coordC - report.coordA);
 
-                glm::mat2 A_Inverse = glm::inverse(glm::mat2(glm::vec2(report.texCoordB.x - report.texCoordA.x, report.texCoordC.x - report.texCoordA.x),
-                                                            glm::vec2(report.texCoordB.y - report.texCoordA.y, report.texCoordC.y - report.texCoordA.y)));
+            glm::mat2 A_Inverse = glm::inverse(glm::mat2(glm::vec2(report.texCoordB.x - report.texCoordA.x, report.texCoordC.x - report.texCoordA.x),
+                                                        glm::vec2(report.texCoordB.y - report.texCoordA.y, report.texCoordC.y - report.texCoordA.y)));
 
-                glm::mat3x2 E(glm::vec2(e1.x, e2.x),
-                            glm::vec2(e1.y, e2.y),
-                            glm::vec2(e1.z, e2.z));
+            glm::mat3x2 E(glm::vec2(e1.x, e2.x),
+                        glm::vec2(e1.y, e2.y),
+                        glm::vec2(e1.z, e2.z));
 
-                glm::mat2x3 TB = glm::transpose(A_Inverse * E);
+            glm::mat2x3 TB = glm::transpose(A_Inverse * E);
 
-                float u = report.texCoord.x;
-                float v = report.texCoord.y;
+            float u = report.texCoord.x;
+            float v = report.texCoord.y;
 
-                if(u < 0 || u > 1)
-                    u -= std::floor(u);
-                if(v < 0 || v > 1)
-                    v -= std::floor(v);
+            if(u < 0 || u > 1)
+                u -= std::floor(u);
+            if(v < 0 || v > 1)
+                v -= std::floor(v);
 
 
-                int i = u * this->bumpMap->image->width;
-                int j = v * this->bumpMap->image->height;
-                glm::vec3 image = this->bumpMap->image->get(i,j);
-                glm::vec3 imageForwardU = this->bumpMap->image->get(i+1, j);
-                glm::vec3 imageForwardV = this->bumpMap->image->get(i, j+1);
+            int i = u * this->bumpMap->image->width;
+            int j = v * this->bumpMap->image->height;
+            glm::vec3 image = this->bumpMap->image->get(i,j);
+            glm::vec3 imageForwardU = this->bumpMap->image->get(i+1, j);
+            glm::vec3 imageForwardV = this->bumpMap->image->get(i, j+1);
 
-                float avImage = (image.x + image.y + image.z) / 3;
-                float avImageForwardU = (imageForwardU.x + imageForwardU.y + imageForwardU.z) / 3;
-                float avImageForwardV = (imageForwardV.x + imageForwardV.y + imageForwardV.z) / 3;
+            float avImage = (image.x + image.y + image.z) / 3;
+            float avImageForwardU = (imageForwardU.x + imageForwardU.y + imageForwardU.z) / 3;
+            float avImageForwardV = (imageForwardV.x + imageForwardV.y + imageForwardV.z) / 3;
 
-                    
-                float du = avImageForwardU - avImage;//glm::length(this->bumpMap->image->get(i+1,j) - this->bumpMap->image->get(i,j));
-                float dv = avImageForwardV - avImage;//glm::length(this->bumpMap->image->get(i,j+1) - this->bumpMap->image->get(i,j));
+                
+            float du = avImageForwardU - avImage;//glm::length(this->bumpMap->image->get(i+1,j) - this->bumpMap->image->get(i,j));
+            float dv = avImageForwardV - avImage;//glm::length(this->bumpMap->image->get(i,j+1) - this->bumpMap->image->get(i,j));
 
-                glm::vec3 tangentPlaneVec = du * TB[0] + dv * TB[1];
+            glm::vec3 tangentPlaneVec = du * TB[0] + dv * TB[1];
 
-                glm::vec3 newNormal = report.normal - this->bumpMap->bumpFactor*(tangentPlaneVec);
-                newNormal = glm::normalize(newNormal);
-                report.normal = newNormal;
+            glm::vec3 newNormal = report.normal - this->bumpMap->bumpFactor*(tangentPlaneVec);
+            newNormal = glm::normalize(newNormal);
+            report.normal = newNormal;
+        }
+        else
+        {
+            // perlin gradient
+            float epsilon = 0.001;
+            float xDiff = this->bumpMap->FetchPerlin(glm::vec3(report.intersection.x + epsilon, report.intersection.y, report.intersection.z));
+            float yDiff = this->bumpMap->FetchPerlin(glm::vec3(report.intersection.x, report.intersection.y + epsilon, report.intersection.z));
+            float zDiff = this->bumpMap->FetchPerlin(glm::vec3(report.intersection.x, report.intersection.y, report.intersection.z + epsilon));
+            float perlinNoise = this->bumpMap->FetchPerlin(report.intersection);
+
+            // Veiny appearence
+            if(this->bumpMap->noiseConversion == NoiseConversionType::ABSVAL)
+            {
+                xDiff = std::fabs(xDiff);
+                yDiff = std::fabs(yDiff);
+                zDiff = std::fabs(zDiff);
+                perlinNoise = std::fabs(perlinNoise);
             }
-            else
+            // Patch appearence
+            else if(this->bumpMap->noiseConversion == NoiseConversionType::LINEAR)
             {
-                // perlin gradient
-                float epsilon = 0.001;
-                float xDiff = this->bumpMap->FetchPerlin(glm::vec3(report.intersection.x + epsilon, report.intersection.y, report.intersection.z));
-                float yDiff = this->bumpMap->FetchPerlin(glm::vec3(report.intersection.x, report.intersection.y + epsilon, report.intersection.z));
-                float zDiff = this->bumpMap->FetchPerlin(glm::vec3(report.intersection.x, report.intersection.y, report.intersection.z + epsilon));
-                float perlinNoise = this->bumpMap->FetchPerlin(report.intersection);
-
-                // Veiny appearence
-                if(this->bumpMap->noiseConversion == NoiseConversionType::ABSVAL)
-                {
-                    xDiff = std::fabs(xDiff);
-                    yDiff = std::fabs(yDiff);
-                    zDiff = std::fabs(zDiff);
-                    perlinNoise = std::fabs(perlinNoise);
-                }
-                // Patch appearence
-                else if(this->bumpMap->noiseConversion == NoiseConversionType::LINEAR)
-                {
-                    xDiff = (xDiff + 1)/2;
-                    yDiff = (yDiff + 1)/2;
-                    zDiff = (zDiff + 1)/2;
-                    perlinNoise = (perlinNoise + 1)/2;
-                }
-
-                glm::vec3 perlinGradient = glm::vec3((xDiff - perlinNoise)/epsilon,
-                                                     (yDiff - perlinNoise)/epsilon,
-                                                     (zDiff - perlinNoise)/epsilon);
-
-                glm::vec3 projectedGradient = perlinGradient - glm::dot(perlinGradient, report.normal) * report.normal;
-                glm::vec3 newNormal = report.normal - this->bumpMap->bumpFactor * (projectedGradient);
-                newNormal = glm::normalize(newNormal);
-                report.normal = newNormal;
+                xDiff = (xDiff + 1)/2;
+                yDiff = (yDiff + 1)/2;
+                zDiff = (zDiff + 1)/2;
+                perlinNoise = (perlinNoise + 1)/2;
             }
-        }
 
-        if(this->emissionMap)
-        {
-            report.emissionActive = true;
-        }
+            glm::vec3 perlinGradient = glm::vec3((xDiff - perlinNoise)/epsilon,
+                                                 (yDiff - perlinNoise)/epsilon,
+                                                 (zDiff - perlinNoise)/epsilon);
 
-        if(this->roughnessMap)
-        {
+            glm::vec3 projectedGradient = perlinGradient - glm::dot(perlinGradient, report.normal) * report.normal;
+            glm::vec3 newNormal = report.normal - this->bumpMap->bumpFactor * (projectedGradient);
+            newNormal = glm::normalize(newNormal);
+            report.normal = newNormal;
+        }
+    }
 
-        }           
+    if(this->emissionMap)
+    {
+        report.emissionActive = true;
     }
 
-    return test;
+    if(this->roughnessMap)
+    {
+
+    }
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include <Renderer.h>
 
-Renderer::Renderer(const std::string& filepath) : scene(std::string(ROOT_DIR) + filepath)
+Renderer::Renderer(const std::string& filepath, const RenderOptions& options) : pool(ParseThreadCount(options.threads)), scene(std::string(ROOT_DIR) + filepath, options, pool)
 {
     contrast   = 0.5;
     brightness = 0.5;
@@ -26,120 +26,121 @@ uint8_t* Renderer::GiveResult(float* pixels, int width, int height)
     // we will omit alpha channel
     uint8_t* res = new uint8_t[width * height * 3];
 
-    int indexSrc = 0;
-    int indexDst = 0;
-    for(int j= 0; j<width; j++)
+    pool.ParallelFor(0, width * height, PIXEL_CHUNK_SIZE, [&](int start, int end)
     {
-        for(int i=0; i<height; i++)
+        for(int i=start*3; i<end*3; i++)
         {
-            int r = pixels[indexSrc++];
-            int g = pixels[indexSrc++];
-            int b = pixels[indexSrc++];
-
-            res[indexDst++] = r;
-            res[indexDst++] = g;
-            res[indexDst++] = b;
+            res[i] = (int)pixels[i];
         }
-    }
+    });
 
     return res;    
 }
 
 void Renderer::ToneMap(float* pixels, int width, int height)
 {
-    long double av_lum = 0;
-    double max_lum = 0;
+    int pixelCount = width * height;
 
-    for(int i=0; i<width*height; i++)
+    // Log luminance is summed per chunk and the chunks are added in order
+    std::vector<long double> chunkSums((pixelCount + PIXEL_CHUNK_SIZE - 1) / PIXEL_CHUNK_SIZE, 0);
+    pool.ParallelFor(0, pixelCount, PIXEL_CHUNK_SIZE, [&](int start, int end)
     {
-        double r = pixels[i*3];
-        double g = pixels[i*3 + 1];
-        double b = pixels[i*3 + 2];
-
-
-        double lum =  r*0.27 + g*0.67 + b*0.06;
+        long double sum = 0;
+        for(int i=start; i<end; i++)
+        {
+            double r = pixels[i*3];
+            double g = pixels[i*3 + 1];
+            double b = pixels[i*3 + 2];
 
-        if(lum > max_lum)
-            max_lum = lum;
 
+            double lum =  r*0.27 + g*0.67 + b*0.06;
 
-        double testLum = std::log(0.000005 + lum);
+            double testLum = std::log(0.000005 + lum);
 
-        if(std::isnan(testLum))
-            av_lum += 0;
-        else
-            av_lum += testLum;
+            if(!std::isnan(testLum))
+                sum += testLum;
+        }
+        chunkSums[start / PIXEL_CHUNK_SIZE] = sum;
+    });
 
-    }
+    long double av_lum = 0;
+    for(long double sum : chunkSums)
+        av_lum += sum;
 
-    max_lum = scene._activeCamera.burn_percentage * av_lum / 100;
+    double max_lum = scene._activeCamera.burn_percentage * av_lum / 100;
     av_lum = std::pow(EULER, av_lum/(width*height));       
 
-    for(int i=0; i<width*height; i++)
+    pool.ParallelFor(0, pixelCount, PIXEL_CHUNK_SIZE, [&](int start, int end)
     {
-        double r = pixels[i*3];
-        double g = pixels[i*3 + 1];
-        double b = pixels[i*3 + 2];
+        for(int i=start; i<end; i++)
+        {
+            double r = pixels[i*3];
+            double g = pixels[i*3 + 1];
+            double b = pixels[i*3 + 2];
 
-       
-        double lum = r*0.27 + g*0.67 + b*0.06;
+           
+            double lum = r*0.27 + g*0.67 + b*0.06;
 
-        double lm = (scene._activeCamera.keyValue * lum)/av_lum;
+            double lm = (scene._activeCamera.keyValue * lum)/av_lum;
 
-        double ld = lm *(1 + (lm/(max_lum*max_lum))/(scene._activeCamera.saturation + lm));
+            double ld = lm *(1 + (lm/(max_lum*max_lum))/(scene._activeCamera.saturation + lm));
 
-        //ld = std::clamp(ld, (float)0, (float)1);
-                      
- 
-        // Luminance mapping
-        pixels[i*3]     = ld * pixels[i*3] / lum;
-        pixels[i*3 + 1] = ld * pixels[i*3 + 1] / lum;
-        pixels[i*3 + 2] = ld * pixels[i*3 + 2] / lum;
-        // Sigmoidal compression
+            //ld = std::clamp(ld, (float)0, (float)1);
+                          
+     
+            // Luminance mapping
+            pixels[i*3]     = ld * pixels[i*3] / lum;
+            pixels[i*3 + 1] = ld * pixels[i*3 + 1] / lum;
+            pixels[i*3 + 2] = ld * pixels[i*3 + 2] / lum;
+            // Sigmoidal compression
 
-        // Sigmoid 1
-        //pixels[i*3]     = pixels[i*3]/(pixels[i*3] + 1);
-        //pixels[i*3 + 1] = pixels[i*3 + 1]/(pixels[i*3 + 1] + 1);
-        //pixels[i*3 + 2] = pixels[i*3 + 2]/(pixels[i*3 + 2] + 1);
+            // Sigmoid 1
+            //pixels[i*3]     = pixels[i*3]/(pixels[i*3] + 1);
+            //pixels[i*3 + 1] = pixels[i*3 + 1]/(pixels[i*3 + 1] + 1);
+            //pixels[i*3 + 2] = pixels[i*3 + 2]/(pixels[i*3 + 2] + 1);
 
-        // Sigmoid 2
-        //pixels[i*3] = (pixels[i*3]*(1 + pixels[i*3]/(max_lum*max_lum)))/(1 + pixels[i*3]);
-        //pixels[i*3 + 1] = (pixels[i*3 + 1]*(1 + pixels[i*3 + 1]/(max_lum*max_lum)))/(1 + pixels[i*3 + 1]);
-        //pixels[i*3 + 2] = (pixels[i*3 + 2]*(1 + pixels[i*3 + 2]/(max_lum*max_lum)))/(1 + pixels[i*3 + 2]);                
+            // Sigmoid 2
+            //pixels[i*3] = (pixels[i*3]*(1 + pixels[i*3]/(max_lum*max_lum)))/(1 + pixels[i*3]);
+            //pixels[i*3 + 1] = (pixels[i*3 + 1]*(1 + pixels[i*3 + 1]/(max_lum*max_lum)))/(1 + pixels[i*3 + 1]);
+            //pixels[i*3 + 2] = (pixels[i*3 + 2]*(1 + pixels[i*3 + 2]/(max_lum*max_lum)))/(1 + pixels[i*3 + 2]);                
 
-        //pixels[i*3] = ld_r;
-        //pixels[i*3 + 1] = ld_g;
-        //pixels[i*3 + 2] = ld_b;
+            //pixels[i*3] = ld_r;
+            //pixels[i*3 + 1] = ld_g;
+            //pixels[i*3 + 2] = ld_b;
 
-        pixels[i*3]     = (std::pow((pixels[i*3]), 1/scene._activeCamera.gamma));
-        pixels[i*3 + 1] = (std::pow((pixels[i*3 + 1]), 1/scene._activeCamera.gamma));
-        pixels[i*3 + 2] = (std::pow((pixels[i*3 + 2]), 1/scene._activeCamera.gamma));           
+            pixels[i*3]     = (std::pow((pixels[i*3]), 1/scene._activeCamera.gamma));
+            pixels[i*3 + 1] = (std::pow((pixels[i*3 + 1]), 1/scene._activeCamera.gamma));
+            pixels[i*3 + 2] = (std::pow((pixels[i*3 + 2]), 1/scene._activeCamera.gamma));           
 
-        // gamma correction and scaling to [0, 255] range
-        pixels[i*3]     *= 255 ;//* (std::pow((pixels[i*3]), scene._activeCamera.gamma));
-        pixels[i*3 + 1] *= 255 ;//* (std::pow((pixels[i*3 + 1]), scene._activeCamera.gamma));
-        pixels[i*3 + 2] *= 255 ;//* (std::pow((pixels[i*3 + 2]), scene._activeCamera.gamma));
+            // gamma correction and scaling to [0, 255] range
+            pixels[i*3]     *= 255 ;//* (std::pow((pixels[i*3]), scene._activeCamera.gamma));
+            pixels[i*3 + 1] *= 255 ;//* (std::pow((pixels[i*3 + 1]), scene._activeCamera.gamma));
+            pixels[i*3 + 2] *= 255 ;//* (std::pow((pixels[i*3 + 2]), scene._activeCamera.gamma));
 
 
-        pixels[i*3]     = clamp(pixels[i*3], (float)0, (float)255);
-        pixels[i*3 + 1] = clamp(pixels[i*3 + 1], (float)0, (float)255);
-        pixels[i*3 + 2] = clamp(pixels[i*3 + 2], (float)0, (float)255);
+            pixels[i*3]     = clamp(pixels[i*3], (float)0, (float)255);
+            pixels[i*3 + 1] = clamp(pixels[i*3 + 1], (float)0, (float)255);
+            pixels[i*3 + 2] = clamp(pixels[i*3 + 2], (float)0, (float)255);
 
-    }
+        }
+    });
 
 }
 
 void Renderer::Clamp0_255(float* pixels, int width, int height)
 {
-    for(int i=0; i<width*height; i++)
+    pool.ParallelFor(0, width * height, PIXEL_CHUNK_SIZE, [&](int start, int end)
     {
-        pixels[i*3]     = clamp(pixels[i*3], (float)0, (float)255);
-        pixels[i*3 + 1] = clamp(pixels[i*3 + 1], (float)0, (float)255);
-        pixels[i*3 + 2] = clamp(pixels[i*3 + 2], (float)0, (float)255);
-    }
+        for(int i=start; i<end; i++)
+        {
+            pixels[i*3]     = clamp(pixels[i*3], (float)0, (float)255);
+            pixels[i*3 + 1] = clamp(pixels[i*3 + 1], (float)0, (float)255);
+            pixels[i*3 + 2] = clamp(pixels[i*3 + 2], (float)0, (float)255);
+        }
+    });
 }
 
-void Renderer::WriteExr(float* rgb)
+void Renderer::WriteExr(float* rgb, const std::string& outputPath, int pixelType)
 {
     EXRHeader header;
     InitEXRHeader(&header);
@@ -154,12 +155,15 @@ void Renderer::WriteExr(float* rgb)
     images[1].resize(scene._imageWidth * scene._imageHeight);
     images[2].resize(scene._imageWidth * scene._imageHeight);
 
-    for(int i=0; i< scene._imageWidth * scene._imageHeight; i++)
+    pool.ParallelFor(0, scene._imageWidth * scene._imageHeight, PIXEL_CHUNK_SIZE, [&](int start, int end)
     {
-        images[0][i] = rgb[3*i + 0];
-        images[1][i] = rgb[3*i + 1];
-        images[2][i] = rgb[3*i + 2];
-    } 
+        for(int i=start; i<end; i++)
+        {
+            images[0][i] = rgb[3*i + 0];
+            images[1][i] = rgb[3*i + 1];
+            images[2][i] = rgb[3*i + 2];
+        }
+    });
 
     float* image_ptr[3];
     image_ptr[0] = &(images[2].at(0));
@@ -182,21 +186,18 @@ void Renderer::WriteExr(float* rgb)
     for(int i=0; i<header.num_channels; i++)
     {
         header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
-        header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
+        header.requested_pixel_types[i] = pixelType;
     }
 
-    std::string outputPath =  "outputs/" + scene._activeCamera.imageName;
-    int dotIndex = outputPath.find('.');
-    std::string pathWithoutExtension = outputPath.substr(0, dotIndex) + ".exr";    
     const char* err;
-    int ret = SaveEXRImageToFile(&image, &header, pathWithoutExtension.c_str(), &err);
+    int ret = SaveEXRImageToFile(&image, &header, outputPath.c_str(), &err);
     if(ret != TINYEXR_SUCCESS)
     {
         fprintf(stderr, "Save EXR err: %s\n", err);
         return;
     }
 
-    printf("Saved exr file. [ %s ] \n", pathWithoutExtension.c_str());
+    printf("Saved exr file. [ %s ] \n", outputPath.c_str());
     free(header.channels);
     free(header.pixel_types);
     free(header.requested_pixel_types);
@@ -218,17 +219,83 @@ void Renderer::RenderOneCamera()
     else if(scene._activeCamera.renderMode == RenderMode::HDR)
     {
         std::string outputPath = "outputs/" + scene._activeCamera.imageName;
-        WriteExr(obtainedImage);
-
         int dotIndex = outputPath.find('.');
+
+        // The EXR is compressed and written from a copy of the linear image
+        // while the image itself is tone mapped
+        std::vector<float> linearImage(obtainedImage, obtainedImage + scene._imageWidth * scene._imageHeight * 3);
+        TaskGroup exrTask(pool);
+        exrTask.Run([&]()
+        {
+            WriteExr(linearImage.data(), outputPath.substr(0, dotIndex) + ".exr");
+        });
+
         std::string pathWithoutExtension = outputPath.substr(0, dotIndex) + "_tonemapped.png"; 
         ToneMap(obtainedImage, scene._activeCamera.imageResolution.x, scene._activeCamera.imageResolution.y);
         result = GiveResult(obtainedImage, scene._activeCamera.imageResolution.x, scene._activeCamera.imageResolution.y);
         stbi_write_png(pathWithoutExtension.c_str(), scene._activeCamera.imageResolution.x, scene._activeCamera.imageResolution.y, 3, result, scene._activeCamera.imageResolution.x *3);        
+
+        exrTask.Wait();
     }
 
     delete[] result;
 
+    if(scene._heatmap)
+        WriteHeatmap();
+}
+
+// Maps [0, 1] onto a blue, cyan, green, yellow, red ramp
+static glm::vec3 FalseColor(float value)
+{
+    const glm::vec3 ramp[5] = {glm::vec3(0, 0, 255), glm::vec3(0, 255, 255), glm::vec3(0, 255, 0), glm::vec3(255, 255, 0), glm::vec3(255, 0, 0)};
+
+    float position = clamp(value, 0.0f, 1.0f) * 4.0f;
+    int index = std::min((int)position, 3);
+
+    float t = position - index;
+    return ramp[index] * (1.0f - t) + ramp[index + 1] * t;
+}
+
+// Raw counts go to an EXR with nodes visited in R and primitives tested in G,
+// each count is also written as a false color PNG scaled to its maximum
+void Renderer::WriteHeatmap()
+{
+    int width  = scene._imageWidth;
+    int height = scene._imageHeight;
+
+    std::string outputPath = "outputs/" + scene._activeCamera.imageName;
+    std::string pathWithoutExtension = outputPath.substr(0, outputPath.find('.'));
+
+    WriteExr(scene._heatmap, pathWithoutExtension + "_heatmap.exr", TINYEXR_PIXELTYPE_FLOAT);
+
+    const char* names[2] = {"nodes", "primitives"};
+    uint8_t* result = new uint8_t[width * height * 3];
+
+    for(int channel=0; channel<2; channel++)
+    {
+        double sum = 0.0;
+        float maximum = 0.0f;
+        for(int i=0; i<width*height; i++)
+        {
+            sum    += scene._heatmap[i*3 + channel];
+            maximum = std::max(maximum, scene._heatmap[i*3 + channel]);
+        }
+
+        for(int i=0; i<width*height; i++)
+        {
+            glm::vec3 color = FalseColor(maximum > 0.0f ? scene._heatmap[i*3 + channel] / maximum : 0.0f);
+            result[i*3]     = color.x;
+            result[i*3 + 1] = color.y;
+            result[i*3 + 2] = color.z;
+        }
+
+        std::string path = pathWithoutExtension + "_heatmap_" + names[channel] + ".png";
+        stbi_write_png(path.c_str(), width, height, 3, result, width * 3);
+
+        std::cout << "Heatmap " << names[channel] << ": average " << sum / (width * height) << ", maximum " << maximum << " per ray [ " << path << " ]" << std::endl;
+    }
+
+    delete[] result;
 }
 
 void Renderer::Render()
@@ -243,12 +310,20 @@ void Renderer::Render()
 
         scene.cameraVariableGenerator = new RandomGenerator(-halfAperture, halfAperture);
 
-        RenderOneCamera();
-
+        // Cameras may differ in resolution, the buffers are sized for the
+        // one about to render
         delete[] scene._image;
         scene._image = new float[scene._imageHeight*scene._imageWidth*3];
         scene.ClearImage();
 
+        if(scene._heatmap)
+        {
+            delete[] scene._heatmap;
+            scene._heatmap = new float[scene._imageHeight*scene._imageWidth*3]();
+        }
+
+        RenderOneCamera();
+
     }
 }
 
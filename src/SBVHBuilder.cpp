@@ -0,0 +1,462 @@
+#include <SBVHBuilder.h>
+#include <algorithm>
+#include <limits>
+
+
+static glm::vec3 referenceCentroid(const SBVHReference& reference)
+{
+    return (reference.box.bounds[0] + reference.box.bounds[1]) * 0.5f;
+}
+
+static bool isValidBox(const AABB& box)
+{
+    return box.bounds[0].x <= box.bounds[1].x && box.bounds[0].y <= box.bounds[1].y && box.bounds[0].z <= box.bounds[1].z;
+}
+
+SBVHBuilder::SBVHBuilder(const MeshGeometry& geometry, const BVHSettings& settings, std::vector<BVHNode>& nodes, std::vector<int>& primitiveIndices)
+    : geometry(geometry), settings(settings), nodes(nodes), primitiveIndices(primitiveIndices)
+{
+    this->settings.binCount    = std::max(2, this->settings.binCount);
+    this->settings.maxLeafSize = std::max(1, this->settings.maxLeafSize);
+    this->settings.maxDepth    = std::min(BVH_STACK_SIZE - 32, this->settings.maxDepth);
+
+    threadCount   = BVHBuildThreadCount(this->settings);
+    parallelDepth = BVHParallelDepth(threadCount);
+
+    minOverlapArea   = 0.0f;
+    duplicationLimit = geometry.FaceCount() * std::max(0.0f, this->settings.duplicationBudget);
+}
+
+// Splits the part of the triangle inside the reference box at the plane. The
+// triangle edges are clipped against the plane and the resulting boxes are
+// intersected with the reference box, which may already be clipped.
+void SBVHBuilder::splitReference(const SBVHReference& reference, int axis, float position, SBVHReference& left, SBVHReference& right) const
+{
+    left.primitive  = reference.primitive;
+    right.primitive = reference.primitive;
+    left.box  = AABB();
+    right.box = AABB();
+
+    const Indices& face = geometry.faces[reference.primitive];
+    const glm::vec3 vertices[3] = {geometry.vertices[face.a], geometry.vertices[face.b], geometry.vertices[face.c]};
+
+    for(int i=0; i<3; i++)
+    {
+        const glm::vec3& v0 = vertices[i];
+        const glm::vec3& v1 = vertices[(i + 1) % 3];
+        float p0 = v0[axis];
+        float p1 = v1[axis];
+
+        if(p0 <= position)
+            left.box.Extend(v0);
+        if(p0 >= position)
+            right.box.Extend(v0);
+
+        if((p0 < position && p1 > position) || (p0 > position && p1 < position))
+        {
+            glm::vec3 point = v0 + (v1 - v0) * ((position - p0) / (p1 - p0));
+            point[axis] = position;
+            left.box.Extend(point);
+            right.box.Extend(point);
+        }
+    }
+
+    left.box.bounds[1][axis]  = position;
+    right.box.bounds[0][axis] = position;
+
+    for(int a=0; a<3; a++)
+    {
+        left.box.bounds[0][a]  = std::max(left.box.bounds[0][a],  reference.box.bounds[0][a]);
+        left.box.bounds[1][a]  = std::min(left.box.bounds[1][a],  reference.box.bounds[1][a]);
+        right.box.bounds[0][a] = std::max(right.box.bounds[0][a], reference.box.bounds[0][a]);
+        right.box.bounds[1][a] = std::min(right.box.bounds[1][a], reference.box.bounds[1][a]);
+    }
+}
+
+// Binned surface area heuristic over the reference centroids, as in the
+// binned SAH builder
+SBVHSplit SBVHBuilder::findObjectSplit(const std::vector<SBVHReference>& references) const
+{
+    int count = references.size();
+    int binCount = settings.binCount;
+
+    AABB centroidBox;
+    for(const SBVHReference& reference : references)
+        centroidBox.Extend(referenceCentroid(reference));
+
+    SBVHSplit best;
+    std::vector<BVHBin> bins(binCount);
+    std::vector<AABB> rightBoxes(binCount);
+
+    for(int a=0; a<3; a++)
+    {
+        float minCentroid = centroidBox.bounds[0][a];
+        float extent = centroidBox.bounds[1][a] - minCentroid;
+        if(extent <= 0.0f)
+            continue;
+
+        std::fill(bins.begin(), bins.end(), BVHBin());
+
+        float scale = binCount / extent;
+        for(const SBVHReference& reference : references)
+        {
+            int b = std::min(binCount - 1, (int)((referenceCentroid(reference)[a] - minCentroid) * scale));
+            bins[b].count++;
+            bins[b].box.Extend(reference.box);
+        }
+
+        AABB rightBox;
+        for(int b=binCount-1; b>0; b--)
+        {
+            rightBox.Extend(bins[b].box);
+            rightBoxes[b] = rightBox;
+        }
+
+        AABB leftBox;
+        int leftCount = 0;
+        for(int b=1; b<binCount; b++)
+        {
+            leftBox.Extend(bins[b - 1].box);
+            leftCount += bins[b - 1].count;
+
+            if(leftCount == 0 || leftCount == count)
+                continue;
+
+            float cost = leftBox.SurfaceArea() * leftCount + rightBoxes[b].SurfaceArea() * (count - leftCount);
+            if(cost < best.cost)
+            {
+                best.cost       = cost;
+                best.axis       = a;
+                best.bin        = b;
+                best.leftBox    = leftBox;
+                best.rightBox   = rightBoxes[b];
+                best.leftCount  = leftCount;
+                best.rightCount = count - leftCount;
+            }
+        }
+    }
+
+    return best;
+}
+
+// Bins the references spatially over the node box. A reference is chopped at
+// every bin plane it crosses, each bin gets the box of its piece, and it is
+// counted as entering its first bin and exiting its last one.
+SBVHSplit SBVHBuilder::findSpatialSplit(const AABB& box, const std::vector<SBVHReference>& references) const
+{
+    int count = references.size();
+    int binCount = settings.binCount;
+
+    SBVHSplit best;
+    std::vector<SBVHSpatialBin> bins(binCount);
+    std::vector<AABB> rightBoxes(binCount);
+    std::vector<int> rightCounts(binCount);
+
+    for(int a=0; a<3; a++)
+    {
+        float origin = box.bounds[0][a];
+        float binWidth = (box.bounds[1][a] - origin) / binCount;
+        if(binWidth <= 0.0f)
+            continue;
+
+        std::fill(bins.begin(), bins.end(), SBVHSpatialBin());
+
+        for(const SBVHReference& reference : references)
+        {
+            int firstBin = std::min(binCount - 1, std::max(0, (int)((reference.box.bounds[0][a] - origin) / binWidth)));
+            int lastBin  = std::min(binCount - 1, std::max(firstBin, (int)((reference.box.bounds[1][a] - origin) / binWidth)));
+
+            SBVHReference current = reference;
+            for(int b=firstBin; b<lastBin; b++)
+            {
+                SBVHReference left, right;
+                splitReference(current, a, origin + binWidth * (b + 1), left, right);
+                bins[b].box.Extend(left.box);
+                current = right;
+            }
+            bins[lastBin].box.Extend(current.box);
+
+            bins[firstBin].entries++;
+            bins[lastBin].exits++;
+        }
+
+        AABB rightBox;
+        int rightCount = 0;
+        for(int b=binCount-1; b>0; b--)
+        {
+            rightBox.Extend(bins[b].box);
+            rightCount += bins[b].exits;
+            rightBoxes[b]  = rightBox;
+            rightCounts[b] = rightCount;
+        }
+
+        AABB leftBox;
+        int leftCount = 0;
+        for(int b=1; b<binCount; b++)
+        {
+            leftBox.Extend(bins[b - 1].box);
+            leftCount += bins[b - 1].entries;
+
+            if(leftCount == 0 || rightCounts[b] == 0 || (leftCount == count && rightCounts[b] == count))
+                continue;
+
+            float cost = leftBox.SurfaceArea() * leftCount + rightBoxes[b].SurfaceArea() * rightCounts[b];
+            if(cost < best.cost)
+            {
+                best.cost       = cost;
+                best.axis       = a;
+                best.bin        = b;
+                best.leftBox    = leftBox;
+                best.rightBox   = rightBoxes[b];
+                best.leftCount  = leftCount;
+                best.rightCount = rightCounts[b];
+            }
+        }
+    }
+
+    return best;
+}
+
+void SBVHBuilder::performObjectSplit(const SBVHSplit& split, std::vector<SBVHReference>& references, std::vector<SBVHReference>& left, std::vector<SBVHReference>& right) const
+{
+    int binCount = settings.binCount;
+
+    AABB centroidBox;
+    for(const SBVHReference& reference : references)
+        centroidBox.Extend(referenceCentroid(reference));
+
+    float minCentroid = centroidBox.bounds[0][split.axis];
+    float scale = binCount / (centroidBox.bounds[1][split.axis] - minCentroid);
+
+    for(const SBVHReference& reference : references)
+    {
+        int b = std::min(binCount - 1, (int)((referenceCentroid(reference)[split.axis] - minCentroid) * scale));
+        if(b < split.bin)
+            left.push_back(reference);
+        else
+            right.push_back(reference);
+    }
+}
+
+// References entirely on one side of the plane go there. A straddling
+// reference is split, unless moving it whole to one side is cheaper than the
+// duplicate, which is decided one reference at a time.
+void SBVHBuilder::performSpatialSplit(const AABB& box, const SBVHSplit& split, std::vector<SBVHReference>& references, std::vector<SBVHReference>& left, std::vector<SBVHReference>& right) const
+{
+    int axis = split.axis;
+    float binWidth = (box.bounds[1][axis] - box.bounds[0][axis]) / settings.binCount;
+    float position = box.bounds[0][axis] + binWidth * split.bin;
+
+    AABB leftBox   = split.leftBox;
+    AABB rightBox  = split.rightBox;
+    int leftCount  = split.leftCount;
+    int rightCount = split.rightCount;
+
+    for(const SBVHReference& reference : references)
+    {
+        if(reference.box.bounds[1][axis] <= position)
+        {
+            left.push_back(reference);
+            continue;
+        }
+        if(reference.box.bounds[0][axis] >= position)
+        {
+            right.push_back(reference);
+            continue;
+        }
+
+        AABB unsplitLeftBox = leftBox;
+        unsplitLeftBox.Extend(reference.box);
+        AABB unsplitRightBox = rightBox;
+        unsplitRightBox.Extend(reference.box);
+
+        float leftArea  = leftBox.SurfaceArea();
+        float rightArea = rightBox.SurfaceArea();
+
+        float splitCost        = leftArea * leftCount + rightArea * rightCount;
+        float unsplitLeftCost  = unsplitLeftBox.SurfaceArea() * leftCount + rightArea * (rightCount - 1);
+        float unsplitRightCost = leftArea * (leftCount - 1) + unsplitRightBox.SurfaceArea() * rightCount;
+
+        if(unsplitLeftCost < splitCost && unsplitLeftCost <= unsplitRightCost)
+        {
+            left.push_back(reference);
+            leftBox = unsplitLeftBox;
+            rightCount--;
+        }
+        else if(unsplitRightCost < splitCost)
+        {
+            right.push_back(reference);
+            rightBox = unsplitRightBox;
+            leftCount--;
+        }
+        else
+        {
+            // Rounding can leave no part of the triangle on one side
+            SBVHReference leftPart, rightPart;
+            splitReference(reference, axis, position, leftPart, rightPart);
+            if(!isValidBox(leftPart.box))
+                right.push_back(reference);
+            else if(!isValidBox(rightPart.box))
+                left.push_back(reference);
+            else
+            {
+                left.push_back(leftPart);
+                right.push_back(rightPart);
+            }
+        }
+    }
+}
+
+void SBVHBuilder::build(std::vector<SBVHReference>& references, int depth, int budget, std::vector<BVHNode>& outNodes, std::vector<int>& outIndices)
+{
+    int nodeIndex = outNodes.size();
+    outNodes.push_back(BVHNode());
+
+    AABB box;
+    for(const SBVHReference& reference : references)
+        box.Extend(reference.box);
+
+    outNodes[nodeIndex].box  = box;
+    outNodes[nodeIndex].axis = 0;
+    outNodes[nodeIndex].pad  = 0;
+
+    int count = references.size();
+    int maxLeafSize = std::numeric_limits<uint16_t>::max();
+
+    std::vector<SBVHReference> left, right;
+    int axis = 0;
+
+    if(depth < settings.maxDepth && count > 1)
+    {
+        SBVHSplit split = findObjectSplit(references);
+        bool spatial = false;
+
+        // Spatial splits only pay off where the object split children overlap
+        AABB overlap;
+        for(int a=0; a<3; a++)
+        {
+            overlap.bounds[0][a] = std::max(split.leftBox.bounds[0][a], split.rightBox.bounds[0][a]);
+            overlap.bounds[1][a] = std::min(split.leftBox.bounds[1][a], split.rightBox.bounds[1][a]);
+        }
+        bool overlapping = split.axis == -1 || (isValidBox(overlap) && overlap.SurfaceArea() > minOverlapArea);
+
+        if(overlapping && budget > 0)
+        {
+            SBVHSplit spatialSplit = findSpatialSplit(box, references);
+            if(spatialSplit.cost < split.cost)
+            {
+                split = spatialSplit;
+                spatial = true;
+            }
+        }
+
+        if(split.axis != -1)
+        {
+            float parentArea = box.SurfaceArea();
+            float splitCost = settings.traversalCost;
+            if(parentArea > 0.0f)
+                splitCost += settings.leafCost * split.cost / parentArea;
+
+            if(count > settings.maxLeafSize || settings.leafCost * count > splitCost)
+            {
+                axis = split.axis;
+                if(spatial)
+                    performSpatialSplit(box, split, references, left, right);
+                else
+                    performObjectSplit(split, references, left, right);
+
+                if(left.empty() || right.empty())
+                {
+                    left.clear();
+                    right.clear();
+                }
+            }
+        }
+    }
+
+    if(left.empty())
+    {
+        if(count <= maxLeafSize)
+        {
+            outNodes[nodeIndex].primitiveOffset = outIndices.size();
+            outNodes[nodeIndex].primitiveCount  = count;
+            for(const SBVHReference& reference : references)
+                outIndices.push_back(reference.primitive);
+            return;
+        }
+
+        // Too many references for a single leaf, fall back to an even split
+        left.assign(references.begin(), references.begin() + count / 2);
+        right.assign(references.begin() + count / 2, references.end());
+    }
+
+    int remaining = std::max(0, budget - ((int)(left.size() + right.size()) - count));
+    int leftBudget  = (int)((int64_t)remaining * left.size() / (left.size() + right.size()));
+    int rightBudget = remaining - leftBudget;
+    references.clear();
+    references.shrink_to_fit();
+
+    outNodes[nodeIndex].axis = axis;
+    outNodes[nodeIndex].primitiveCount = 0;
+
+    if(depth < parallelDepth && count >= BVH_PARALLEL_BUILD_THRESHOLD)
+    {
+        // The right subtree is built into its own arrays on another task and
+        // appended after the left one, keeping the depth first layout
+        std::vector<BVHNode> rightNodes;
+        std::vector<int> rightIndices;
+        TaskGroup rightTask(*settings.pool);
+        rightTask.Run([&]()
+        {
+            build(right, depth + 1, rightBudget, rightNodes, rightIndices);
+        });
+
+        build(left, depth + 1, leftBudget, outNodes, outIndices);
+        rightTask.Wait();
+
+        int nodeOffset  = outNodes.size();
+        int indexOffset = outIndices.size();
+        outNodes[nodeIndex].secondChildOffset = nodeOffset;
+        for(BVHNode& node : rightNodes)
+        {
+            if(node.primitiveCount == 0)
+                node.secondChildOffset += nodeOffset;
+            else
+                node.primitiveOffset += indexOffset;
+            outNodes.push_back(node);
+        }
+        outIndices.insert(outIndices.end(), rightIndices.begin(), rightIndices.end());
+        return;
+    }
+
+    build(left, depth + 1, leftBudget, outNodes, outIndices);
+    outNodes[nodeIndex].secondChildOffset = outNodes.size();
+    build(right, depth + 1, rightBudget, outNodes, outIndices);
+}
+
+void SBVHBuilder::Build()
+{
+    nodes.clear();
+    primitiveIndices.clear();
+
+    int faceCount = geometry.FaceCount();
+    if(faceCount == 0)
+        return;
+
+    std::vector<SBVHReference> references(faceCount);
+    AABB rootBox;
+    for(int i=0; i<faceCount; i++)
+    {
+        references[i].box = geometry.FaceBounds(i);
+        references[i].primitive = i;
+        rootBox.Extend(references[i].box);
+    }
+
+    minOverlapArea = settings.spatialSplitAlpha * rootBox.SurfaceArea();
+
+    nodes.reserve(2 * (faceCount + duplicationLimit));
+    primitiveIndices.reserve(faceCount + duplicationLimit);
+    build(references, 0, duplicationLimit, nodes, primitiveIndices);
+    nodes.shrink_to_fit();
+    primitiveIndices.shrink_to_fit();
+}
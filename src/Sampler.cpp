@@ -0,0 +1,17 @@
+#include <Sampler.h>
+#include <HaltonSampler.h>
+#include <SobolSampler.h>
+#include <BlueNoiseSampler.h>
+
+
+Sampler* CreateSampler(SamplerType type)
+{
+    if(type == SamplerType::HALTON)
+        return new HaltonSampler();
+    else if(type == SamplerType::SOBOL)
+        return new SobolSampler();
+    else if(type == SamplerType::BLUE_NOISE)
+        return new BlueNoiseSampler();
+
+    return nullptr;
+}
@@ -1,7 +1,7 @@
 #include <Scene.h>
 
 
-Scene::Scene(const std::string& filepath)
+Scene::Scene(const std::string& filepath, const RenderOptions& options, ThreadPool& pool) : pool(pool)
 {
     tinyxml2::XMLDocument file;
     std::stringstream stream;
@@ -20,6 +20,27 @@ Scene::Scene(const std::string& filepath)
 
 
     SceneReadConstants(root, _backgroundColor, _shadowRayEpsilon, _intersectionTestEpsilon, _maxRecursionDepth);
+    SceneReadBVHSettings(root, _bvhSettings);
+    if(options.bvhWidth)
+        _bvhSettings.width = ParseBVHWidth(options.bvhWidth);
+    if(options.bvhCache)
+        _bvhSettings.cache = true;
+    _bvhSettings.cacheDirectory = options.bvhCacheDir.empty() ? std::string(BUILD_DIR) + "bvhcache" : options.bvhCacheDir;
+    if(options.watertight)
+        _bvhSettings.watertight = true;
+    if(options.bakeTransforms)
+        _bvhSettings.bakeTransforms = true;
+    _bvhSettings.pool = &pool;
+    randomSeed = options.seed;
+    if(!options.sampler.empty())
+        _sampler = CreateSampler(ParseSamplerType(options.sampler.c_str()));
+    randomSampler = _sampler;
+    _packetTracing = options.packets;
+    _wavefront = options.wavefront;
+    if(options.tileSize)
+        _tileSize = ParseTileSize(options.tileSize);
+    if(!options.tileOrder.empty())
+        _tileOrder = ParseTileOrder(options.tileOrder.c_str());
     SceneReadCameras(root, _cameras, imageNames, _imageName);
     SceneReadTextures(root, _images, _textures, _backgroundTextureIndex);    
     SceneReadLights(root, _pointLights, _areaLights, _environmentLights, _directionalLights, _spotLights, _images, _ambientLight);
@@ -28,27 +49,58 @@ Scene::Scene(const std::string& filepath)
     SceneReadVertexData(root, _vertexData);
     SceneReadTexCoordData(root, _texCoordData);
     SceneReadTransformations(root, _translationMatrices, _rotationMatrices, _scalingMatrices, _compositeMatrices);
-    SceneReadMeshes(root, _meshes, _textures, _vertexData, _texCoordData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
+    SceneReadMeshes(root, _bvhSettings, _meshes, _textures, _vertexData, _texCoordData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
     SceneReadMeshInstances(root, _meshes, _textures, _meshInstances, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
     SceneReadSpheres(root, _spheres, _textures, _vertexData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
     SceneReadTriangles(root, _triangles, _textures, _vertexData, _texCoordData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
+    for(Triangle& triangle : _triangles)
+    {
+        triangle.watertight = _bvhSettings.watertight;
+        if(_bvhSettings.bakeTransforms && triangle.translationVector == glm::vec3(0.0f))
+            triangle.BakeTransform();
+    }
 
-    SceneReadLightMeshes(root, _lightMeshes, _textures, _vertexData, _texCoordData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
+    SceneReadLightMeshes(root, _bvhSettings, _lightMeshes, _textures, _vertexData, _texCoordData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);
     SceneReadLightSpheres(root, _lightSpheres, _textures, _vertexData, _rotationMatrices, _scalingMatrices, _translationMatrices, _compositeMatrices);    
 
 
     ScenePopulateObjects(_objectPointerVector, _lightObjectPointerVector ,_meshes, _meshInstances, _spheres, _triangles, _lightMeshes, _lightSpheres);
+    for(Object* object : _objectPointerVector)
+        object->PrecomputeTransforms();
+    _topLevelBVH = new TopLevelBVH(_objectPointerVector, _bvhSettings, _intersectionTestEpsilon);
+
+    // Only the BVH part is timed. Meshes are built side by side, so this is
+    // the summed build time of all of them rather than the time it took.
+    double bvhBuildTime = _topLevelBVH->buildTime;
+    size_t triangleCount = 0;
+    for(const Mesh& mesh : _meshes)
+    {
+        bvhBuildTime  += mesh.bvhRoot->buildTime;
+        triangleCount += mesh.geometry->FaceCount();
+    }
+    for(const LightMesh& lightMesh : _lightMeshes)
+    {
+        bvhBuildTime  += lightMesh.bvhRoot->buildTime;
+        triangleCount += lightMesh.geometry->FaceCount();
+    }
+    std::cout << "BVH build: " << triangleCount << " triangles " << bvhBuildTime << "ms (" << bvhBuildTime * 0.001 << "s)" << std::endl;
+
+    if(options.bvhStats || !options.bvhStatsPath.empty())
+        ReportBVHStats(options);
+
     ScenePopulateLights(_lightPointerVector, _pointLights, _areaLights, _directionalLights, _spotLights, _environmentLights, _lightMeshes, _lightSpheres);
 
     _activeCamera = _cameras[0];
 
     _imageHeight = _activeCamera.imageResolution.y;
     _imageWidth  = _activeCamera.imageResolution.x;
-    worksize = _imageHeight * _imageWidth;
     _image = new float[_imageHeight*_imageWidth*3];
 
-    coreSize = std::thread::hardware_concurrency();
-    count = 0;
+    if(options.heatmap)
+    {
+        _heatmap = new float[_imageHeight*_imageWidth*3];
+        _heatmapShadowRays = options.heatmapShadowRays;
+    }
 
     backfaceCulling = true;
     
@@ -72,6 +124,59 @@ Scene::Scene(const std::string& filepath)
 Scene::~Scene()
 {
     delete[] _image;
+    delete[] _heatmap;
+    delete _topLevelBVH;
+    delete _sampler;
+}
+
+void Scene::ReportBVHStats(const RenderOptions& options)
+{
+    std::vector<std::string> names;
+    std::vector<BVHStats> meshStats;
+    for(size_t i=0; i<_meshes.size(); i++)
+    {
+        names.push_back("Mesh " + std::to_string(i + 1));
+        meshStats.push_back(_meshes[i].bvhRoot->Stats());
+    }
+    for(size_t i=0; i<_lightMeshes.size(); i++)
+    {
+        names.push_back("LightMesh " + std::to_string(i + 1));
+        meshStats.push_back(_lightMeshes[i].bvhRoot->Stats());
+    }
+
+    // Scene totals cover the mesh BVHs, the top level is reported on its own
+    BVHStats sceneStats;
+    for(const BVHStats& stats : meshStats)
+        sceneStats.Add(stats);
+    BVHStats topLevelStats = _topLevelBVH->Stats();
+
+    if(options.bvhStats)
+    {
+        for(size_t i=0; i<meshStats.size(); i++)
+            meshStats[i].Print(std::cout, names[i]);
+        topLevelStats.Print(std::cout, "Top level");
+        sceneStats.Print(std::cout, "All meshes");
+    }
+
+    if(!options.bvhStatsPath.empty())
+    {
+        std::ofstream file(options.bvhStatsPath);
+        if(!file)
+            throw std::runtime_error("Error: The BVH statistics file cannot be written.");
+
+        file << "{\n  \"meshes\": [";
+        for(size_t i=0; i<meshStats.size(); i++)
+        {
+            file << (i > 0 ? "," : "") << "\n    {\"name\": \"" << names[i] << "\", \"stats\": ";
+            meshStats[i].WriteJSON(file);
+            file << "}";
+        }
+        file << "\n  ],\n  \"topLevel\": ";
+        topLevelStats.WriteJSON(file);
+        file << ",\n  \"scene\": ";
+        sceneStats.WriteJSON(file);
+        file << "\n}\n";
+    }
 }
 
 glm::vec2 Scene::GiveCoords(int index, int width)
@@ -89,46 +194,71 @@ glm::vec2 Scene::GiveCoords(int index, int width)
 
 void Scene::RenderThread()
 {
-    int cores = coreSize;
+    // DOF cameras have no shared origin and the heatmap counts rays one by
+    // one, both keep tracing a pixel at a time
+    bool packets = _packetTracing && _activeCamera.apertureSize == 0 && !_heatmap;
+    bool wavefront = _wavefront && _activeCamera.lightingMode == LightingMode::PATH_TRACING && !_heatmap;
+
+    TileScheduler scheduler(_imageWidth, _imageHeight, _tileSize, _tileOrder);
+
+    // A worker that throws leaves its tile unfinished, so the progress loop
+    // also ends once every worker has returned
+    int workerCount = pool.Size();
+    int returnedWorkers = 0;
+    auto workerReturned = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            returnedWorkers++;
+        }
+        waitResults.notify_all();
+    };
 
-    while(cores--)
+    // One tile loop per worker, the tiles themselves are balanced by the
+    // scheduler
+    TaskGroup workers(pool);
+    for(int i=0; i<workerCount; i++)
     {
-        futureVector.push_back(
-            std::async(std::launch::async, [=]()
+        workers.Run([&]()
+        {
+            // Tiles are rendered here and copied into the image in one go
+            std::vector<float> buffer(_tileSize * _tileSize * 3);
+            Tile tile;
+
+            try
             {
-                while(true)
+                while(scheduler.Next(tile))
                 {
-                    int index = count++;
-                    if(index >= worksize)
-                        break;
-
-                    glm::vec2 coords = GiveCoords(index, _imageWidth);
-                    
-                    std::vector<RayWithWeigth> rwwVector = ComputePrimaryRays(coords.x, coords.y);
-                    glm::vec3 filteredColor = TraceAndFilter(rwwVector, coords.x, coords.y);
-
-                    //Ray pR = ComputePrimaryRay(coords.x, coords.y);
-                    //glm::vec3 pixel = RayTrace(pR);
-
-                    WritePixelCoord(coords.x, coords.y, filteredColor);
-
-                    {
-                        std::lock_guard<std::mutex> lock(progressLock);
-                        std::cout << "Progress: [" << std::setprecision(1) << std::fixed << (count / (float)worksize) * 100.0 << "% ] \r";
-                        std::cout.flush();
-                    }
+                    TraceTile(tile, packets, wavefront, buffer.data());
+                    CommitTile(tile, buffer.data());
+                    scheduler.Finish(tile);
                 }
-            }));
-    }
+            }
+            catch(...)
+            {
+                workerReturned();
+                throw;
+            }
 
+            workerReturned();
+        });
+    }
 
-    for(auto& element : futureVector)
+    // Progress is reported from this thread a few times a second, the
+    // workers never wait on the console
     {
-        element.get();
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!waitResults.wait_for(lock, std::chrono::milliseconds(PROGRESS_INTERVAL_MS), [&]() { return scheduler.Done() || returnedWorkers == workerCount; }))
+        {
+            std::cout << "Progress: [" << std::setprecision(1) << std::fixed << scheduler.Progress() * 100.0 << "% ] \r";
+            std::cout.flush();
+        }
     }
+    // Rethrows what a worker threw before claiming the render is complete
+    workers.Wait();
 
-    futureVector.clear();
-    count = 0;
+    std::cout << "Progress: [" << std::setprecision(1) << std::fixed << 100.0 << "% ] \r";
+    std::cout.flush();
 }
 
 float* Scene::GetImage()
@@ -159,6 +289,13 @@ void Scene::WritePixelCoord(int i, int j, const glm::vec3& color)
     _image[i * 3 + (_imageWidth * j *3) + 2] = color.z;
 }
 
+void Scene::WriteHeatmapPixel(int i, int j, float nodesVisited, float primitivesTested)
+{
+    _heatmap[i * 3 + (_imageWidth * j *3)]     = nodesVisited;
+    _heatmap[i * 3 + (_imageWidth * j *3) + 1] = primitivesTested;
+    _heatmap[i * 3 + (_imageWidth * j *3) + 2] = 0.0;
+}
+
 
 Ray Scene::ComputePrimaryRay(int i, int j)
 {
@@ -185,8 +322,11 @@ std::vector<RayWithWeigth> Scene::ComputePrimaryRays(int i, int j)
     {
         for(int x=0; x<rowColSize; x++)
         {
-            float randomX = randomVariableGenerator->Generate();
-            float randomY = randomVariableGenerator->Generate();
+            int sample = y * rowColSize + x;
+            CurrentRandomStream() = RandomStream(i, j, sample);
+
+            float randomX, randomY;
+            randomVariableGenerator->Generate2D(randomX, randomY);
 
             glm::vec3 origin = _activeCamera.position;
             glm::vec3 m = origin + _activeCamera.gaze * _activeCamera.nearDistance;
@@ -195,6 +335,13 @@ std::vector<RayWithWeigth> Scene::ComputePrimaryRays(int i, int j)
             float offsetX = (x + randomX)/rowColSize;
             float offsetY = (y + randomY)/rowColSize;
 
+            // Low discrepancy points are already stratified over the pixel
+            if(randomSampler)
+            {
+                offsetX = randomX;
+                offsetY = randomY;
+            }
+
             if(rowColSize == 1)
             {
                 offsetX = 0.5f;
@@ -213,6 +360,7 @@ std::vector<RayWithWeigth> Scene::ComputePrimaryRays(int i, int j)
                 float tfd = _activeCamera.focusDistance/glm::dot(-direction, -_activeCamera.gaze);
                 glm::vec3 p = fR.origin + tfd * fR.direction;
 
+                CurrentRandomStream().Seek(CAMERA_LENS_DIMENSION);
                 float apertureRandomOffset = cameraVariableGenerator->Generate();
 
                 glm::vec3 s = origin;
@@ -224,6 +372,7 @@ std::vector<RayWithWeigth> Scene::ComputePrimaryRays(int i, int j)
                 
             }
 
+            CurrentRandomStream().Seek(CAMERA_TIME_DIMENSION);
             float time = motionBlurTimeGenerator->Generate();
             fR.time = time;
 
@@ -231,6 +380,7 @@ std::vector<RayWithWeigth> Scene::ComputePrimaryRays(int i, int j)
             rww.r = fR;
             rww.distX = std::fabs(0.5f - offsetX);
             rww.distY = std::fabs(0.5f - offsetY);
+            rww.stream = RandomStream(i, j, sample);
 
             result.push_back(rww);
         }
@@ -241,22 +391,29 @@ std::vector<RayWithWeigth> Scene::ComputePrimaryRays(int i, int j)
 
 
 
+// Objects only report hits during traversal, the surface of the closest one
+// is shaded once it is known
 bool Scene::TestWorldIntersection(const Ray& ray, IntersectionReport& report, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling)
 {
-    report.d = FLT_MAX;
-    bool result = false;
+    HitRecord hit;
+    if(!_topLevelBVH->Intersect(ray, hit, tmin, tmax, intersectionTestEpsilon, backfaceCulling))
+        return false;
 
-    for(auto object : _objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling))
-        {
-            result = true;
-            report = r.d < report.d ? r : report;
-        }
-    }
+    return ExpandHit(ray, hit, report);
+}
 
-    return result;
+bool Scene::ExpandHit(const Ray& ray, const HitRecord& hit, IntersectionReport& report)
+{
+    if(!hit.object)
+        return false;
+
+    // Callers may reuse a report, no shading field may survive from before
+    report = IntersectionReport();
+    report.d            = hit.t;
+    report.intersection = ray.origin + hit.t*ray.direction;
+    report.hitObject    = hit.object;
+    hit.object->ComputeSurfaceInteraction(ray, hit, report);
+    return true;
 }
 
 bool Scene::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, const glm::vec3& lightPosition, const IntersectionReport& report, bool backfaceCulling, float time)
@@ -271,14 +428,7 @@ bool Scene::ShadowRayIntersection(float tmin, float tmax, float intersectionTest
     float dist = glm::length(lightPosition - report.intersection);
 
 
-    for(auto object : _objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling) && r.d < dist)
-            return true;
-    }
-
-    return false;
+    return _topLevelBVH->Occluded(ray, tmin, std::min(tmax, dist), intersectionTestEpsilon, backfaceCulling);
 }
 
 
@@ -327,12 +477,12 @@ glm::vec3 Scene::ComputeDiffuseSpecular(const IntersectionReport& report, const
         {
             result += _lightPointerVector[i]->ComputeDiffuseSpecular(ray, diffuseReflectance, specularReflectance, phongExponent,
                                                                  report, 0.00001, 2000, _intersectionTestEpsilon, _shadowRayEpsilon, 
-                                                                 true, ray.time, _objectPointerVector, gammaflag, _activeCamera.gamma, hasBrdf, brdf, refractionIndex, absorbtionIndex);
+                                                                 true, ray.time, *_topLevelBVH, gammaflag, _activeCamera.gamma, hasBrdf, brdf, refractionIndex, absorbtionIndex);
         }
         else
             result += _lightPointerVector[i]->ComputeDiffuseSpecular(ray, diffuseReflectance, specularReflectance, phongExponent,
                                                                  report, 0.00001, 2000, _intersectionTestEpsilon, _shadowRayEpsilon, 
-                                                                 true, ray.time, _objectPointerVector, gammaflag, 0, hasBrdf, brdf, refractionIndex, absorbtionIndex);            
+                                                                 true, ray.time, *_topLevelBVH, gammaflag, 0, hasBrdf, brdf, refractionIndex, absorbtionIndex);            
         
 
     }
@@ -356,14 +506,18 @@ glm::vec3 Scene::ComputeSpecularComponent(const IntersectionReport& report, cons
 }
 
 
-RayTraceResult Scene::RayTrace(const Ray& ray, bool backfaceCulling)
+RayTraceResult Scene::RayTrace(const Ray& ray, bool backfaceCulling, const HitRecord* primaryHit)
 {
 
     RayTraceResult result;
     IntersectionReport r;
     bool flag = false;
 
-    if(TestWorldIntersection(ray, r, 0, 2000, _intersectionTestEpsilon, backfaceCulling))
+    // The recursion of the ray tracer branches at every surface, its draws
+    // take the dimensions of the first vertex in the order they happen
+    CurrentRandomStream().StartVertex(1);
+
+    if(primaryHit ? ExpandHit(ray, *primaryHit, r) : TestWorldIntersection(ray, r, 0, 2000, _intersectionTestEpsilon, backfaceCulling))
     {
         glm::vec3 pixel(0.0);
         if(r.diffuseActive && r.replaceAll)
@@ -388,14 +542,14 @@ RayTraceResult Scene::RayTrace(const Ray& ray, bool backfaceCulling)
 
 }
 
-RayTraceResult Scene::PathTrace(const Ray& ray, bool backfaceCulling, int recursionDepth)
+RayTraceResult Scene::PathTrace(const Ray& ray, bool backfaceCulling, int recursionDepth, const HitRecord* primaryHit)
 {
 
     RayTraceResult result;
     result.hit = false;
     result.resultColor = glm::vec3(0.0f);
     float rrProb = 1.0f;
-    float rayEnergyLoseFactor = 0.95;
+    CurrentRandomStream().StartVertex(recursionDepth + 1);
     // Checking stopping conditions
     if(_activeCamera.russianRoulette && recursionDepth > this->_maxRecursionDepth)
     {
@@ -417,425 +571,366 @@ RayTraceResult Scene::PathTrace(const Ray& ray, bool backfaceCulling, int recurs
         result.resultColor = glm::vec3(0.0f);
         return result;
     }
+    CurrentRandomStream().Seek(SHADING_DIMENSION);
 
     IntersectionReport r;
-    bool flag = false;
 
-    if(TestWorldIntersection(ray, r, 0, 2000, _intersectionTestEpsilon, backfaceCulling))
+    if(primaryHit ? ExpandHit(ray, *primaryHit, r) : TestWorldIntersection(ray, r, 0, 2000, _intersectionTestEpsilon, backfaceCulling))
     {
+        result.hit = true;
+
         if(r.diffuseActive && r.replaceAll)
         {
-            result.hit = true;
             result.resultColor = r.texDiffuseReflectance;
         }
         else if(r.isLight)
         {
-            result.hit = true;
             result.resultColor = r.radiance;
             return result;
         }
         else
         {
-            glm::vec3 bounceRayOrigin(0.0f);
-            glm::vec3 bounceRayDirection(0.0f);
+            PathBranch branches[2];
+            int branchCount = ScatterPath(ray, r, rrProb, branches);
+            RandomStream stream = CurrentRandomStream();
 
-            Ray bounceRay;
+            for(int i=0; i<branchCount; i++)
+            {
+                const PathBranch& branch = branches[i];
+                CurrentRandomStream() = stream.Branch(i);
+                if(branch.nextEvent)
+                {
+                    HitRecord hit;
+                    if(_topLevelBVH->Intersect(branch.ray, hit, 0, 2000, _intersectionTestEpsilon, backfaceCulling) && hit.object->IsLight())
+                    {
+                        result.resultColor += branch.directIfLight;
+                        continue;
+                    }
+                    result.resultColor += branch.directOtherwise;
+                }
 
+                result.resultColor += branch.weight * PathTrace(branch.ray, backfaceCulling, recursionDepth + 1).resultColor;
+            }
+        }
 
-            glm::vec3 attenuation(1.0);
+    }
 
-            if(ray.materialIdCurrentlyIn != -1)
-            {
-                float dist = glm::length(ray.origin - r.intersection);
+    if(std::isnan(result.resultColor.x) || std::isnan(result.resultColor.y) || std::isnan(result.resultColor.z))
+    {
+        result.resultColor = glm::vec3(0.0,0.0,0.0);
+    }    
+
+    return result;
+    
+}
 
-                float cx = _materials[ray.materialIdCurrentlyIn].absorptionCoefficient.x;
-                float cy = _materials[ray.materialIdCurrentlyIn].absorptionCoefficient.y;
-                float cz = _materials[ray.materialIdCurrentlyIn].absorptionCoefficient.z;
+int Scene::ScatterPath(const Ray& ray, const IntersectionReport& r, float rrProb, PathBranch* branches)
+{
+    float rayEnergyLoseFactor = 0.95;
+    glm::vec3 attenuation(1.0);
 
-                attenuation.x = std::pow((float)EULER, -cx * dist);
-                attenuation.y = std::pow((float)EULER, -cy * dist);
-                attenuation.z = std::pow((float)EULER, -cz * dist);
+    if(ray.materialIdCurrentlyIn != -1)
+    {
+        float dist = glm::length(ray.origin - r.intersection);
 
-            }
+        float cx = _materials[ray.materialIdCurrentlyIn].absorptionCoefficient.x;
+        float cy = _materials[ray.materialIdCurrentlyIn].absorptionCoefficient.y;
+        float cz = _materials[ray.materialIdCurrentlyIn].absorptionCoefficient.z;
+
+        attenuation.x = std::pow((float)EULER, -cx * dist);
+        attenuation.y = std::pow((float)EULER, -cy * dist);
+        attenuation.z = std::pow((float)EULER, -cz * dist);
+
+    }
+
+    // Diffuse
+    if(_materials[r.materialId].type == -1)
+    {
+        glm::vec3 reflectedRayOrigin = r.intersection + r.normal*_shadowRayEpsilon;
+        glm::vec3 reflectedRayDir;
+        float probabilityInv = 0;
+        if(_activeCamera.importanceSampling)
+        {
+            reflectedRayDir = directionSampler->importanceSample(r.normal);
+            probabilityInv  = M_PI / std::max(0.1f, glm::dot(reflectedRayDir, r.normal));
+        }
+        else
+        {
+            reflectedRayDir = directionSampler->uniformSample(r.normal);
+            probabilityInv  = 2 * M_PI;                         
+        }
+        Ray reflected(reflectedRayOrigin, reflectedRayDir);
+        reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
+
+        branches[0].ray    = reflected;
+        branches[0].weight = probabilityInv * getReflectance(ray, reflectedRayDir, 
+                                                    _materials[r.materialId].diffuseReflectance, 
+                                                    _materials[r.materialId].specularReflectance,
+                                                    _materials[r.materialId].phongExponent,
+                                                    r, _materials[r.materialId].degammaFlag,
+                                                    _activeCamera.gamma,
+                                                    _materials[r.materialId].hasBrdf, _materials[r.materialId].brdf,
+                                                    _materials[r.materialId].refractionIndex, _materials[r.materialId].absorptionIndex) / rrProb;
+
+        if(_activeCamera.nextEventEstimation)
+        {
+            glm::vec3 direct = ComputeDiffuseSpecular(r, ray);
+
+            branches[0].nextEvent       = true;
+            branches[0].directIfLight   = direct;
+            branches[0].directOtherwise = direct / rrProb;
+        }
 
-            // Diffuse
-            if(_materials[r.materialId].type == -1)
+        return 1;
+    }
+    // Dielectric
+    else if(_materials[r.materialId].type == 1)
+    {
+
+        // Ray is entering
+        if(glm::dot(ray.direction, r.normal) < 0)
+        {
+            glm::vec3 reflectedRayOrigin = r.intersection + r.normal * 0.01f;
+            glm::vec3 reflectedRayDir    = glm::normalize(glm::reflect(ray.direction, r.normal));
+
+            float cosTheta = glm::dot(-ray.direction, r.normal);
+            float coeffRatio = 1/_materials[r.materialId].refractionIndex;
+
+            float cosPhiSquared = (1 - coeffRatio*coeffRatio * (1 - cosTheta*cosTheta));
+
+            Ray reflected(reflectedRayOrigin, reflectedRayDir);
+            reflected.isRefracting = ray.isRefracting;
+            reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
+            reflected.mediumCoeffNow = ray.mediumCoeffNow;
+            reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
+            reflected.time = ray.time;
+            reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
+
+            // Reflection and transmission both occur
+            if(cosPhiSquared >= 0)
             {
-                    
-                glm::vec3 reflectedRayOrigin = r.intersection + r.normal*_shadowRayEpsilon;
-                glm::vec3 reflectedRayDir;
-                float probabilityInv = 0;
-                if(_activeCamera.importanceSampling)
-                {
-                    reflectedRayDir = directionSampler->importanceSample(r.normal);
-                    probabilityInv  = M_PI / std::max(0.1f, glm::dot(reflectedRayDir, r.normal));
-                }
-                else
-                {
-                    reflectedRayDir = directionSampler->uniformSample(r.normal);
-                    probabilityInv  = 2 * M_PI;                         
-                }
-                Ray reflected(reflectedRayOrigin, reflectedRayDir);
-                reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-                bool directionSuitable = true;
+                float cosPhi = std::sqrt(cosPhiSquared);
 
-                if(_activeCamera.nextEventEstimation)
-                {
-                    IntersectionReport report;
+                // Building transmitted ray
+                glm::vec3 transmittedRayOrigin = r.intersection - r.normal * 0.01f;            
+                glm::vec3 transmittedRayDir = (ray.direction + r.normal*cosTheta)*coeffRatio - r.normal*cosPhi;
 
-                    if(TestWorldIntersection(reflected, report, 0, 2000, _intersectionTestEpsilon, backfaceCulling))
-                    {
-                        Object* obj = (Object*) report.hitObject;
-                        for(auto element : _lightObjectPointerVector)
-                        {
-                            if(obj == element)
-                                directionSuitable = false;
-                        }
-                    }
+                Ray tRay(transmittedRayOrigin, transmittedRayDir);
+                tRay.mediumCoeffNow = _materials[r.materialId].refractionIndex;
+                tRay.mediumCoeffBefore = ray.mediumCoeffNow;
+                tRay.isRefracting = true;
+                tRay.materialIdCurrentlyIn = r.materialId;
+                tRay.time = ray.time;
+                tRay.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
 
-                    if(directionSuitable)
-                    {
-                        result.resultColor = probabilityInv * getReflectance(ray, reflectedRayDir, 
-                                                            _materials[r.materialId].diffuseReflectance, 
-                                                            _materials[r.materialId].specularReflectance,
-                                                            _materials[r.materialId].phongExponent,
-                                                            r, _materials[r.materialId].degammaFlag,
-                                                            _activeCamera.gamma,
-                                                            _materials[r.materialId].hasBrdf, _materials[r.materialId].brdf,
-                                                            _materials[r.materialId].refractionIndex, _materials[r.materialId].absorptionIndex) *
-                                                            PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor;
-                        result.resultColor += ComputeDiffuseSpecular(r, ray);
-                        result.resultColor /= rrProb;
-                        result.hit = true;
-                    }
-                    else
-                    {
-                        result.resultColor = ComputeDiffuseSpecular(r, ray);
-                        result.hit = true;
-                    }
-                
-                }
-                else
+                float rRpar = (tRay.mediumCoeffNow*cosTheta - 1*cosPhi)/
+                            (tRay.mediumCoeffNow*cosTheta + 1*cosPhi);
+
+                float rPpar = (1*cosTheta - tRay.mediumCoeffNow*cosPhi)/
+                            (1*cosTheta + tRay.mediumCoeffNow*cosPhi);
+
+                float reflectionRatio = (rPpar*rPpar + rRpar*rRpar)/2;
+                float transmissionRatio = 1 - reflectionRatio;
+
+                // With next event estimation the reflected part and the
+                // direct lighting are divided by rrProb twice
+                branches[0].ray    = reflected;
+                branches[0].weight = glm::vec3(reflectionRatio / rrProb);
+                if(_activeCamera.nextEventEstimation)
                 {
-                    result.resultColor = probabilityInv * getReflectance(ray, reflectedRayDir, 
-                                                        _materials[r.materialId].diffuseReflectance, 
-                                                        _materials[r.materialId].specularReflectance,
-                                                        _materials[r.materialId].phongExponent,
-                                                        r, _materials[r.materialId].degammaFlag,
-                                                        _activeCamera.gamma,
-                                                        _materials[r.materialId].hasBrdf, _materials[r.materialId].brdf,
-                                                        _materials[r.materialId].refractionIndex, _materials[r.materialId].absorptionIndex) *
-                                                        PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor;
-                    result.hit = true;
-                    result.resultColor /= rrProb;          
+                    glm::vec3 direct = ComputeDiffuseSpecular(r, ray) / (rrProb * rrProb);
+
+                    branches[0].weight         /= rrProb;
+                    branches[0].nextEvent       = true;
+                    branches[0].directIfLight   = direct;
+                    branches[0].directOtherwise = direct;
                 }
 
+                branches[1].ray    = tRay;
+                branches[1].weight = glm::vec3(transmissionRatio / rrProb);
+
+                return 2;
             }
-            // Dielectric
-            else if(_materials[r.materialId].type == 1)
+            // Only reflection occurs
+            else
             {
-
-                // Ray is entering
-                if(glm::dot(ray.direction, r.normal) < 0)
+                branches[0].ray    = reflected;
+                branches[0].weight = glm::vec3(1.0f / rrProb);
+                if(_activeCamera.nextEventEstimation)
                 {
-                    glm::vec3 reflectedRayOrigin = r.intersection + r.normal * 0.01f;
-                    glm::vec3 reflectedRayDir    = glm::normalize(glm::reflect(ray.direction, r.normal));
+                    glm::vec3 direct = ComputeDiffuseSpecular(r, ray) / rrProb;
 
-                    float cosTheta = glm::dot(-ray.direction, r.normal);
-                    float coeffRatio = 1/_materials[r.materialId].refractionIndex;
+                    branches[0].nextEvent       = true;
+                    branches[0].directIfLight   = direct;
+                    branches[0].directOtherwise = direct;
+                }
 
-                    float cosPhiSquared = (1 - coeffRatio*coeffRatio * (1 - cosTheta*cosTheta));
+                return 1;
+            }                         
+        }
 
-                    // Reflection and transmission both occur
-                    if(cosPhiSquared >= 0)
-                    {
-                        float cosPhi = std::sqrt(cosPhiSquared);
-
-                        // Building transmitted ray
-                        glm::vec3 transmittedRayOrigin = r.intersection - r.normal * 0.01f;            
-                        glm::vec3 transmittedRayDir = (ray.direction + r.normal*cosTheta)*coeffRatio - r.normal*cosPhi;
-
-                        Ray tRay(transmittedRayOrigin, transmittedRayDir);
-                        tRay.mediumCoeffNow = _materials[r.materialId].refractionIndex;
-                        tRay.mediumCoeffBefore = ray.mediumCoeffNow;
-                        tRay.isRefracting = true;
-                        tRay.materialIdCurrentlyIn = r.materialId;
-                        tRay.time = ray.time;
-                        tRay.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-
-                        Ray reflected(reflectedRayOrigin, reflectedRayDir);
-                        reflected.isRefracting = ray.isRefracting;
-                        reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
-                        reflected.mediumCoeffNow = ray.mediumCoeffNow;
-                        reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
-                        reflected.time = ray.time;
-                        reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-
-                        float rRpar = (tRay.mediumCoeffNow*cosTheta - 1*cosPhi)/
-                                    (tRay.mediumCoeffNow*cosTheta + 1*cosPhi);
-
-                        float rPpar = (1*cosTheta - tRay.mediumCoeffNow*cosPhi)/
-                                    (1*cosTheta + tRay.mediumCoeffNow*cosPhi);
-
-                        float reflectionRatio = (rPpar*rPpar + rRpar*rRpar)/2;
-                        float transmissionRatio = 1 - reflectionRatio;
-
-                        bool directionSuitable = true;
-
-                        if(_activeCamera.nextEventEstimation)
-                        {
-                            IntersectionReport report;
-
-                            if(TestWorldIntersection(reflected, report, 0, 9000, _intersectionTestEpsilon, backfaceCulling))
-                            {
-                                Object* obj = (Object*) report.hitObject;
-                                for(auto element : _lightObjectPointerVector)
-                                {
-                                    if(obj == element)
-                                        directionSuitable = false;
-                                }
-                            }
-
-                            if(directionSuitable)
-                            {
-                                result.resultColor = reflectionRatio * PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor;
-                                result.resultColor += ComputeDiffuseSpecular(r, ray);
-                                result.resultColor /= rrProb;                                
-                            }
-                            else
-                            {
-                                result.resultColor = ComputeDiffuseSpecular(r, ray);
-                                result.resultColor /= rrProb;                              
-                            }
-                        
-                        }
-                        else
-                        {
-                            result.resultColor = reflectionRatio * PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor;
-                        }                        
-
-                                                                 
-                        result.resultColor +=  transmissionRatio * PathTrace(tRay, backfaceCulling, recursionDepth + 1).resultColor;
-                        result.resultColor /= rrProb;
-                        result.hit = true;
-
-                        
-                    }
-                    // Only reflection occurs
-                    else
-                    {
-                        Ray reflected(reflectedRayOrigin, reflectedRayDir);
-                        reflected.isRefracting = ray.isRefracting;
-                        reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
-                        reflected.mediumCoeffNow = ray.mediumCoeffNow;
-                        reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
-                        reflected.time = ray.time;
-                        reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-                        bool directionSuitable = true;
-
-                        if(_activeCamera.nextEventEstimation)
-                        {
-                            IntersectionReport report;
-
-                            if(TestWorldIntersection(reflected, report, 0, 2000, _intersectionTestEpsilon, backfaceCulling))
-                            {
-                                Object* obj = (Object*) report.hitObject;
-                                for(auto element : _lightObjectPointerVector)
-                                {
-                                    if(obj == element)
-                                        directionSuitable = false;
-                                }
-                            }
-
-                            if(directionSuitable)
-                            {
-                                result.resultColor =  PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor;
-                                result.resultColor += ComputeDiffuseSpecular(r, ray);
-                                result.resultColor /= rrProb;                                
-                            }
-                            else
-                            {
-                                result.resultColor = ComputeDiffuseSpecular(r, ray);
-                                result.resultColor /= rrProb;                               
-                            }
-                        
-                        }
-                        else
-                        {
-                            result.resultColor +=  PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor;
-                            result.resultColor /= rrProb;                                                                
-                        }  
-
-                        result.hit = true;                            
-                    }                         
-                }
+        // Ray is exiting
+        else if(glm::dot(ray.direction, r.normal) > 0)
+        {
+            glm::vec3 invertedNormal = -r.normal;
 
-                // Ray is exiting
-                else if(glm::dot(ray.direction, r.normal) > 0)
-                {
-                    glm::vec3 invertedNormal = -r.normal;
+            glm::vec3 reflectedRayOrigin = r.intersection + invertedNormal * 0.01f;
+            glm::vec3 reflectedRayDir    = glm::reflect(ray.direction, invertedNormal);
 
-                    glm::vec3 reflectedRayOrigin = r.intersection + invertedNormal * 0.01f;
-                    glm::vec3 reflectedRayDir    = glm::reflect(ray.direction, invertedNormal);
+            float cosTheta = glm::dot(-ray.direction, invertedNormal);
+            float coeffRatio = ray.mediumCoeffNow/1;
 
-                    float cosTheta = glm::dot(-ray.direction, invertedNormal);
-                    float coeffRatio = ray.mediumCoeffNow/1;
+            float cosPhiSquared = (1 - coeffRatio*coeffRatio * (1 - cosTheta*cosTheta));
 
-                    float cosPhiSquared = (1 - coeffRatio*coeffRatio * (1 - cosTheta*cosTheta));
+            Ray reflected(reflectedRayOrigin, reflectedRayDir);
+            reflected.isRefracting = ray.isRefracting;
+            reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
+            reflected.mediumCoeffNow = ray.mediumCoeffNow;
+            reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
+            reflected.time = ray.time;
+            reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
 
-                    // Reflection and transmission both occur
-                    if(cosPhiSquared >= 0)
-                    {
-                        float cosPhi = std::sqrt(cosPhiSquared);
-
-                        // Building transmitted ray
-                        glm::vec3 transmittedRayOrigin = r.intersection - invertedNormal * 0.01f;            
-                        glm::vec3 transmittedRayDir = (ray.direction + invertedNormal*cosTheta)*coeffRatio - invertedNormal*cosPhi;
-
-                        Ray tRay(transmittedRayOrigin, transmittedRayDir);
-                        tRay.mediumCoeffBefore = ray.mediumCoeffNow;
-                        tRay.mediumCoeffNow = 1;
-                        tRay.isRefracting = false;
-                        tRay.materialIdCurrentlyIn = -1;
-                        tRay.time = ray.time;
-                        tRay.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-
-                        Ray reflected(reflectedRayOrigin, reflectedRayDir);
-                        reflected.isRefracting = ray.isRefracting;
-                        reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
-                        reflected.mediumCoeffNow = ray.mediumCoeffNow;
-                        reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
-                        reflected.time = ray.time;
-                        reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-
-                        float rRpar = (1*cosTheta - tRay.mediumCoeffBefore*cosPhi)/
-                                    (1*cosTheta + tRay.mediumCoeffBefore*cosPhi);
-
-                        float rPpar = (tRay.mediumCoeffBefore*cosTheta - 1*cosPhi)/
-                                    (tRay.mediumCoeffBefore*cosTheta + 1*cosPhi);
-
-                        float reflectionRatio = (rPpar*rPpar + rRpar*rRpar)/2;
-                        float transmissionRatio = 1 - reflectionRatio;
-
-                        result.resultColor = reflectionRatio * PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor * attenuation
-                                                                                                                                 
-                                                                                            +
-                                                                 
-                                             transmissionRatio * PathTrace(tRay, backfaceCulling, recursionDepth + 1).resultColor * attenuation;
-                        result.resultColor /= rrProb;                                             
-                        result.hit = true;
+            // Reflection and transmission both occur
+            if(cosPhiSquared >= 0)
+            {
+                float cosPhi = std::sqrt(cosPhiSquared);
 
-                    }
-                    // Only reflection occurs
-                    else
-                    {
-                        Ray reflected(reflectedRayOrigin, reflectedRayDir);
-                        reflected.isRefracting = ray.isRefracting;
-                        reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
-                        reflected.mediumCoeffNow = ray.mediumCoeffNow;
-                        reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
-                        reflected.time = ray.time;
-                        reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-                            
-                        result.resultColor = (PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor) * attenuation;
-                        result.resultColor /= rrProb;                                                              
-
-                        result.hit = true;                       
-                           
-                    } 
-                }
+                // Building transmitted ray
+                glm::vec3 transmittedRayOrigin = r.intersection - invertedNormal * 0.01f;            
+                glm::vec3 transmittedRayDir = (ray.direction + invertedNormal*cosTheta)*coeffRatio - invertedNormal*cosPhi;
+
+                Ray tRay(transmittedRayOrigin, transmittedRayDir);
+                tRay.mediumCoeffBefore = ray.mediumCoeffNow;
+                tRay.mediumCoeffNow = 1;
+                tRay.isRefracting = false;
+                tRay.materialIdCurrentlyIn = -1;
+                tRay.time = ray.time;
+                tRay.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
 
+                float rRpar = (1*cosTheta - tRay.mediumCoeffBefore*cosPhi)/
+                            (1*cosTheta + tRay.mediumCoeffBefore*cosPhi);
 
-            }
+                float rPpar = (tRay.mediumCoeffBefore*cosTheta - 1*cosPhi)/
+                            (tRay.mediumCoeffBefore*cosTheta + 1*cosPhi);
 
-            // Conductor
-            else if(_materials[r.materialId].type == 2)
+                float reflectionRatio = (rPpar*rPpar + rRpar*rRpar)/2;
+                float transmissionRatio = 1 - reflectionRatio;
+
+                branches[0].ray    = reflected;
+                branches[0].weight = reflectionRatio * attenuation / rrProb;
+                branches[1].ray    = tRay;
+                branches[1].weight = transmissionRatio * attenuation / rrProb;
+
+                return 2;
+            }
+            // Only reflection occurs
+            else
             {
-                glm::vec3 reflectedRayOrigin = r.intersection + r.normal*_shadowRayEpsilon;
-                glm::vec3 reflectedRayDir    = glm::normalize(glm::reflect(ray.direction, r.normal));
-                float cosTheta = glm::dot(ray.direction, r.normal);
-                float aI = _materials[r.materialId].absorptionIndex;
-                float rI = _materials[r.materialId].refractionIndex;
+                branches[0].ray    = reflected;
+                branches[0].weight = attenuation / rrProb;
 
+                return 1;
+            } 
+        }
 
-                float rS = ((rI*rI + aI*aI) - 2*rI*cosTheta + (cosTheta*cosTheta))/
-                        ((rI*rI + aI*aI) + 2*rI*cosTheta + (cosTheta*cosTheta));
+        return 0;
+    }
 
-                float rP = ((rI*rI + aI*aI)*(cosTheta*cosTheta) - 2*rI*cosTheta + 1)/
-                        ((rI*rI + aI*aI)*(cosTheta*cosTheta) + 2*rI*cosTheta + 1);
+    // Conductor
+    else if(_materials[r.materialId].type == 2)
+    {
+        glm::vec3 reflectedRayOrigin = r.intersection + r.normal*_shadowRayEpsilon;
+        glm::vec3 reflectedRayDir    = glm::normalize(glm::reflect(ray.direction, r.normal));
+        float cosTheta = glm::dot(ray.direction, r.normal);
+        float aI = _materials[r.materialId].absorptionIndex;
+        float rI = _materials[r.materialId].refractionIndex;
 
-                float reflectionRatio = (rS + rP)/2;
 
-                OrthonormalBasis basis = GiveOrthonormalBasis(reflectedRayDir);
-                float randomOffsetU = glossyReflectionVarGenerator->Generate();
-                float randomOffsetV = glossyReflectionVarGenerator->Generate();
+        float rS = ((rI*rI + aI*aI) - 2*rI*cosTheta + (cosTheta*cosTheta))/
+                ((rI*rI + aI*aI) + 2*rI*cosTheta + (cosTheta*cosTheta));
 
-                reflectedRayDir = reflectedRayDir + _materials[r.materialId].roughness*(randomOffsetU*basis.u + randomOffsetV*basis.v);
-                
-                Ray reflected(reflectedRayOrigin, reflectedRayDir);
-                reflected.isRefracting = ray.isRefracting;
-                reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
-                reflected.mediumCoeffNow    = ray.mediumCoeffNow;
-                reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
-                reflected.time = ray.time;
+        float rP = ((rI*rI + aI*aI)*(cosTheta*cosTheta) - 2*rI*cosTheta + 1)/
+                ((rI*rI + aI*aI)*(cosTheta*cosTheta) + 2*rI*cosTheta + 1);
 
-                reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
-                bool directionSuitable = true;
+        float reflectionRatio = (rS + rP)/2;
 
-                if(_activeCamera.nextEventEstimation)
-                {
-                    IntersectionReport report;
+        OrthonormalBasis basis = GiveOrthonormalBasis(reflectedRayDir);
+        float randomOffsetU, randomOffsetV;
+        glossyReflectionVarGenerator->Generate2D(randomOffsetU, randomOffsetV);
 
-                    if(TestWorldIntersection(reflected, report, 0, 6000, _intersectionTestEpsilon, backfaceCulling))
-                    {
-                        Object* obj = (Object*) report.hitObject;
-                        for(auto element : _lightObjectPointerVector)
-                        {
-                            if(obj == element)
-                                directionSuitable = false;
-                        }
-                    }
+        reflectedRayDir = reflectedRayDir + _materials[r.materialId].roughness*(randomOffsetU*basis.u + randomOffsetV*basis.v);
+        
+        Ray reflected(reflectedRayOrigin, reflectedRayDir);
+        reflected.isRefracting = ray.isRefracting;
+        reflected.mediumCoeffBefore = ray.mediumCoeffBefore;
+        reflected.mediumCoeffNow    = ray.mediumCoeffNow;
+        reflected.materialIdCurrentlyIn = ray.materialIdCurrentlyIn;
+        reflected.time = ray.time;
 
-                    if(directionSuitable)
-                    {
-                        result.resultColor = reflectionRatio * _materials[r.materialId].mirrorReflectance * PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor * attenuation;
-                        result.resultColor += ComputeDiffuseSpecular(r, ray);
-                        result.resultColor /= rrProb;
-                        //std::cout << _materials[r.materialId].mirrorReflectance.x << " " << _materials[r.materialId].mirrorReflectance.y << " " << _materials[r.materialId].mirrorReflectance.z << " "<< reflectionRatio <<  std::endl;
-                        result.hit = true;
-                    }
-                    else
-                    {
-                        result.resultColor = ComputeDiffuseSpecular(r, ray);
-                        result.resultColor /= rrProb;                        
-                        result.hit = true;                        
-                    }
-                        
-                }
-                else
-                {
-                    result.resultColor += reflectionRatio * _materials[r.materialId].mirrorReflectance * PathTrace(reflected, backfaceCulling, recursionDepth + 1).resultColor * attenuation;
-                    result.resultColor /= rrProb;                   
-                    result.hit = true;                    
-                }          
-                    
-            }            
+        reflected.rayThroughput = ray.rayThroughput * rayEnergyLoseFactor;
 
+        branches[0].ray    = reflected;
+        branches[0].weight = reflectionRatio * _materials[r.materialId].mirrorReflectance * attenuation / rrProb;
+        if(_activeCamera.nextEventEstimation)
+        {
+            glm::vec3 direct = ComputeDiffuseSpecular(r, ray) / rrProb;
 
+            branches[0].nextEvent       = true;
+            branches[0].directIfLight   = direct;
+            branches[0].directOtherwise = direct;
         }
 
+        return 1;
     }
 
-    if(std::isnan(result.resultColor.x) || std::isnan(result.resultColor.y) || std::isnan(result.resultColor.z))
+    return 0;
+}
+
+glm::vec3 Scene::TraceAndFilter(std::vector<RayWithWeigth> rwwVector, int x, int y, const HitRecord* primaryHits)
+{
+    std::vector<RayTraceResult> results(rwwVector.size());
+    TraversalStats heatmapSum;
+
+    for(size_t i=0; i<rwwVector.size(); i++)
     {
-        result.resultColor = glm::vec3(0.0,0.0,0.0);
-    }    
+        // The primary ray is traced once more on its own, so bounces of the
+        // shading do not end up in the closest hit counts
+        if(_heatmap)
+        {
+            traversalCounters.Reset();
 
-    return result;
-    
+            HitRecord hit;
+            _topLevelBVH->Intersect(rwwVector[i].r, hit, 0, 2000, _intersectionTestEpsilon, false);
+
+            heatmapSum.nodesVisited     += traversalCounters.closestHit.nodesVisited;
+            heatmapSum.primitivesTested += traversalCounters.closestHit.primitivesTested;
+            traversalCounters.Reset();
+        }
+
+        CurrentRandomStream() = rwwVector[i].stream;
+
+        if(_activeCamera.lightingMode == LightingMode::DIRECT_LIGHTING)
+            results[i] = RayTrace(rwwVector[i].r, false, primaryHits ? &primaryHits[i] : nullptr);
+        else if(_activeCamera.lightingMode == LightingMode::PATH_TRACING)
+            results[i] = PathTrace(rwwVector[i].r, false, 0, primaryHits ? &primaryHits[i] : nullptr);
+
+        if(_heatmap && _heatmapShadowRays)
+        {
+            heatmapSum.nodesVisited     += traversalCounters.shadow.nodesVisited;
+            heatmapSum.primitivesTested += traversalCounters.shadow.primitivesTested;
+        }
+    }
+
+    if(_heatmap && !rwwVector.empty())
+    {
+        float sampleCount = rwwVector.size();
+        WriteHeatmapPixel(x, y, heatmapSum.nodesVisited / sampleCount, heatmapSum.primitivesTested / sampleCount);
+    }
+
+    return FilterSamples(rwwVector, results.data(), x, y);
 }
 
-glm::vec3 Scene::TraceAndFilter(std::vector<RayWithWeigth> rwwVector, int x, int y)
+glm::vec3 Scene::FilterSamples(const std::vector<RayWithWeigth>& rwwVector, const RayTraceResult* results, int x, int y)
 {
     float stdDev = 1.f/6.f;
     glm::vec3 result(0.0);
@@ -845,12 +940,7 @@ glm::vec3 Scene::TraceAndFilter(std::vector<RayWithWeigth> rwwVector, int x, int
 
     for(size_t i=0; i<rwwVector.size(); i++)
     {
-        RayTraceResult rtResult;
-
-        if(_activeCamera.lightingMode == LightingMode::DIRECT_LIGHTING)
-            rtResult = RayTrace(rwwVector[i].r, false);
-        else if(_activeCamera.lightingMode == LightingMode::PATH_TRACING)
-            rtResult = PathTrace(rwwVector[i].r, false, 0);
+        const RayTraceResult& rtResult = results[i];
 
         if(rtResult.hit)
         {
@@ -904,6 +994,228 @@ glm::vec3 Scene::TraceAndFilter(std::vector<RayWithWeigth> rwwVector, int x, int
 }
 
 
+void Scene::TraceTile(const Tile& tile, bool packets, bool wavefront, float* buffer)
+{
+    // Pixels are visited in PACKET_TILE_SIZE blocks, so the samples of a
+    // packet cover a small patch of the image plane
+    std::vector<std::pair<int, int>> pixels;
+    for(int blockY=tile.startY; blockY<tile.endY; blockY+=PACKET_TILE_SIZE)
+    {
+        for(int blockX=tile.startX; blockX<tile.endX; blockX+=PACKET_TILE_SIZE)
+        {
+            for(int y=blockY; y<std::min(blockY + PACKET_TILE_SIZE, tile.endY); y++)
+            {
+                for(int x=blockX; x<std::min(blockX + PACKET_TILE_SIZE, tile.endX); x++)
+                    pixels.push_back({x, y});
+            }
+        }
+    }
+
+    std::vector<std::vector<RayWithWeigth>> pixelRays;
+    for(const std::pair<int, int>& pixel : pixels)
+        pixelRays.push_back(ComputePrimaryRays(pixel.first, pixel.second));
+
+    std::vector<HitRecord> hits;
+    if(packets)
+    {
+        RayPacket packet;
+        for(size_t p=0; p<pixelRays.size(); p++)
+        {
+            for(size_t i=0; i<pixelRays[p].size(); i++)
+            {
+                packet.rays[packet.count++] = pixelRays[p][i].r;
+
+                bool last = p + 1 == pixelRays.size() && i + 1 == pixelRays[p].size();
+                if(packet.count == RAY_PACKET_SIZE || last)
+                {
+                    _topLevelBVH->IntersectPacket(packet, 0, 2000, _intersectionTestEpsilon, false);
+                    hits.insert(hits.end(), packet.hits, packet.hits + packet.count);
+                    packet.count = 0;
+                }
+            }
+        }
+    }
+    const HitRecord* primaryHits = packets ? hits.data() : nullptr;
+
+    std::vector<RayTraceResult> results;
+    if(wavefront)
+    {
+        std::vector<Ray> rays;
+        std::vector<RandomStream> streams;
+        for(const std::vector<RayWithWeigth>& rwwVector : pixelRays)
+        {
+            for(const RayWithWeigth& rww : rwwVector)
+            {
+                rays.push_back(rww.r);
+                streams.push_back(rww.stream);
+            }
+        }
+        WavefrontPathTrace(rays, streams, primaryHits, results);
+    }
+
+    size_t offset = 0;
+    for(size_t p=0; p<pixels.size(); p++)
+    {
+        int x = pixels[p].first;
+        int y = pixels[p].second;
+
+        glm::vec3 filteredColor = wavefront ? FilterSamples(pixelRays[p], results.data() + offset, x, y)
+                                            : TraceAndFilter(pixelRays[p], x, y, primaryHits ? primaryHits + offset : nullptr);
+        offset += pixelRays[p].size();
+
+        float* pixel = buffer + ((y - tile.startY) * tile.Width() + (x - tile.startX)) * 3;
+        pixel[0] = filteredColor.x;
+        pixel[1] = filteredColor.y;
+        pixel[2] = filteredColor.z;
+    }
+}
+
+void Scene::CommitTile(const Tile& tile, const float* buffer)
+{
+    for(int y=tile.startY; y<tile.endY; y++)
+    {
+        const float* row = buffer + (y - tile.startY) * tile.Width() * 3;
+        std::copy(row, row + tile.Width() * 3, _image + (y * _imageWidth + tile.startX) * 3);
+    }
+}
+
+// Same estimator as PathTrace, evaluated a bounce at a time for all paths of
+// the batch: intersect every live ray, drop the bounces that next event
+// estimation already covered, sort the hits by material and object, shade
+// them and collect the continuation rays for the next round.
+void Scene::WavefrontPathTrace(const std::vector<Ray>& rays, const std::vector<RandomStream>& streams, const HitRecord* primaryHits, std::vector<RayTraceResult>& results)
+{
+    results.assign(rays.size(), RayTraceResult{false, glm::vec3(0.0f)});
+
+    auto addRadiance = [&](int sample, const glm::vec3& radiance)
+    {
+        if(!std::isnan(radiance.x) && !std::isnan(radiance.y) && !std::isnan(radiance.z))
+            results[sample].resultColor += radiance;
+    };
+
+    std::vector<PathState> paths(rays.size());
+    for(size_t i=0; i<rays.size(); i++)
+    {
+        PathState& path = paths[i];
+        path.ray        = rays[i];
+        path.throughput = glm::vec3(1.0f);
+        path.sample     = i;
+        path.depth      = 0;
+        path.stream     = streams[i];
+        path.nextEvent  = false;
+    }
+
+    std::vector<PathState> nextPaths;
+    std::vector<int> order;
+
+    while(!paths.empty())
+    {
+        for(PathState& path : paths)
+        {
+            if(path.depth == 0 && primaryHits)
+            {
+                path.hit = primaryHits[path.sample];
+                continue;
+            }
+
+            // Past the depth limit only the light test of the parent is left
+            path.hit = HitRecord();
+            if(path.depth > _maxRecursionDepth && !_activeCamera.russianRoulette && !path.nextEvent)
+                continue;
+
+            _topLevelBVH->Intersect(path.ray, path.hit, 0, 2000, _intersectionTestEpsilon, false);
+        }
+
+        order.clear();
+        for(size_t i=0; i<paths.size(); i++)
+        {
+            PathState& path = paths[i];
+            if(path.nextEvent)
+            {
+                bool hitsLight = path.hit.object && path.hit.object->IsLight();
+                addRadiance(path.sample, hitsLight ? path.directIfLight : path.directOtherwise);
+                if(hitsLight)
+                    continue;
+            }
+
+            if(path.hit.object)
+                order.push_back(i);
+        }
+
+        // Hits on the same material and object are shaded together
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            const Object* objectA = paths[a].hit.object;
+            const Object* objectB = paths[b].hit.object;
+            if(objectA->materialId != objectB->materialId)
+                return objectA->materialId < objectB->materialId;
+            return objectA < objectB;
+        });
+
+        nextPaths.clear();
+        for(int i : order)
+        {
+            const PathState& path = paths[i];
+
+            // Draws continue the sequence of the path, as they would in
+            // PathTrace
+            CurrentRandomStream() = path.stream;
+            CurrentRandomStream().StartVertex(path.depth + 1);
+
+            float rrProb = 1.0f;
+            if(path.depth > _maxRecursionDepth)
+            {
+                if(!_activeCamera.russianRoulette)
+                    continue;
+
+                float randomNumber = randomVariableGenerator->Generate();
+                float q = 1 - path.ray.rayThroughput;
+                if(randomNumber <= q)
+                    continue;
+
+                rrProb = 1 - q;
+            }
+            CurrentRandomStream().Seek(SHADING_DIMENSION);
+
+            IntersectionReport r;
+            ExpandHit(path.ray, path.hit, r);
+            if(path.depth == 0)
+                results[path.sample].hit = true;
+
+            if(r.diffuseActive && r.replaceAll)
+            {
+                addRadiance(path.sample, path.throughput * r.texDiffuseReflectance);
+                continue;
+            }
+            if(r.isLight)
+            {
+                addRadiance(path.sample, path.throughput * r.radiance);
+                continue;
+            }
+
+            PathBranch branches[2];
+            int branchCount = ScatterPath(path.ray, r, rrProb, branches);
+            RandomStream stream = CurrentRandomStream();
+
+            for(int b=0; b<branchCount; b++)
+            {
+                PathState next;
+                next.ray             = branches[b].ray;
+                next.throughput      = path.throughput * branches[b].weight;
+                next.sample          = path.sample;
+                next.depth           = path.depth + 1;
+                next.stream          = stream.Branch(b);
+                next.nextEvent       = branches[b].nextEvent;
+                next.directIfLight   = path.throughput * branches[b].directIfLight;
+                next.directOtherwise = path.throughput * branches[b].directOtherwise;
+                nextPaths.push_back(next);
+            }
+        }
+
+        std::swap(paths, nextPaths);
+    }
+}
+
 glm::vec3 Scene::RecursiveTrace(const Ray& ray, const IntersectionReport& iR, int bounce, bool backfaceCulling)
 {
 
@@ -936,8 +1248,8 @@ glm::vec3 Scene::RecursiveTrace(const Ray& ray, const IntersectionReport& iR, in
         if(_materials[iR.materialId].roughness > 0)
         {
             OrthonormalBasis basis = GiveOrthonormalBasis(reflectedRayDir);
-            float randomOffsetU = glossyReflectionVarGenerator->Generate();
-            float randomOffsetV = glossyReflectionVarGenerator->Generate();
+            float randomOffsetU, randomOffsetV;
+            glossyReflectionVarGenerator->Generate2D(randomOffsetU, randomOffsetV);
 
             reflectedRayDir = reflectedRayDir + _materials[iR.materialId].roughness*(randomOffsetU*basis.u + randomOffsetV*basis.v);
         }
@@ -1254,8 +1566,8 @@ glm::vec3 Scene::RecursiveTrace(const Ray& ray, const IntersectionReport& iR, in
         float reflectionRatio = (rS + rP)/2;
 
         OrthonormalBasis basis = GiveOrthonormalBasis(reflectedRayDir);
-        float randomOffsetU = glossyReflectionVarGenerator->Generate();
-        float randomOffsetV = glossyReflectionVarGenerator->Generate();
+        float randomOffsetU, randomOffsetV;
+        glossyReflectionVarGenerator->Generate2D(randomOffsetU, randomOffsetV);
 
         reflectedRayDir = reflectedRayDir + _materials[iR.materialId].roughness*(randomOffsetU*basis.u + randomOffsetV*basis.v);
         
@@ -0,0 +1,66 @@
+#include <SobolSampler.h>
+#include <RandomGenerator.h>
+
+
+static uint32_t reverseBits(uint32_t x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+
+    return x;
+}
+
+// Laine and Karras hash, every output bit depends only on the input bits
+// below it
+static uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+
+    return x;
+}
+
+// Owen scrambling, each bit is flipped depending on the bits above it
+static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// First two Sobol dimensions, the van der Corput sequence and the one whose
+// generator matrix is Pascal's triangle modulo 2
+static uint32_t sobol(uint32_t index, uint32_t dimension)
+{
+    if(dimension == 0)
+        return reverseBits(index);
+
+    uint32_t result = 0;
+    for(uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+    {
+        if(index & 1)
+            result ^= v;
+    }
+
+    return result;
+}
+
+uint32_t SobolSampler::ScrambledSobol(uint32_t index, uint32_t dimension, uint32_t seed)
+{
+    // Both dimensions of a pair share the shuffle, so together they stay a
+    // Sobol point set
+    uint32_t shuffled = nestedUniformScramble(index, seed);
+
+    return nestedUniformScramble(sobol(shuffled, dimension & 1), RandomHash(seed ^ RandomHash((dimension & 1) + 1)));
+}
+
+float SobolSampler::Sample(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension, uint32_t key) const
+{
+    uint32_t seed = RandomHash(key ^ RandomHash(x ^ RandomHash(y ^ RandomHash(dimension / 2))));
+
+    return (ScrambledSobol(index, dimension, seed) >> 8) * (1.0f / 16777216.0f);
+}
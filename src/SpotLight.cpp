@@ -1,6 +1,6 @@
 #include <SpotLight.h>
 
-float SpotLight::GetFollowFactor(float theta)
+float SpotLight::GetFollowFactor(float theta) const
 {
     return std::pow((std::cos(theta) - std::cos(coverageAngle/2))/
            (std::cos(falloffAngle/2) - std::cos(coverageAngle/2)),exponent);
@@ -9,7 +9,7 @@ float SpotLight::GetFollowFactor(float theta)
 
 bool SpotLight::ShadowRayIntersection(float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon, 
                                       const IntersectionReport& report, bool backfaceCulling,
-                                      float time, std::vector<Object *>& objectPointerVector)
+                                      float time, TopLevelBVH& topLevelBVH) const
 {
     glm::vec3 direction = glm::normalize(position - report.intersection);
     glm::vec3 origin    = report.intersection + shadowRayEpsilon*report.normal;
@@ -19,26 +19,19 @@ bool SpotLight::ShadowRayIntersection(float tmin, float tmax, float intersection
 
     float dist = glm::length(position - report.intersection);
 
-    for(auto object : objectPointerVector)
-    {
-        IntersectionReport r;
-        if(object->Intersect(ray, r, tmin, tmax, intersectionTestEpsilon, backfaceCulling) && r.d < dist)
-            return true;
-    }
-
-    return false;
+    return topLevelBVH.Occluded(ray, tmin, std::min(tmax, dist), intersectionTestEpsilon, backfaceCulling);
 }
 
 
 glm::vec3 SpotLight::ComputeDiffuseSpecular(const Ray& ray, glm::vec3& diffuseReflectance, glm::vec3& specularReflectance,
                                             const float& phongExponent, const IntersectionReport& report,
                                             float tmin, float tmax, float intersectionTestEpsilon, float shadowRayEpsilon,
-                                            bool backfaceCulling, float time, std::vector<Object *>& objectPointerVector, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex)
+                                            bool backfaceCulling, float time, TopLevelBVH& topLevelBVH, bool degammaFlag, float gamma, bool hasBRDF, BRDF brdf, float refractiveIndex, float absorbtionIndex) const
 {
 
     glm::vec3 result = glm::vec3(0.0);
 
-    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, true, ray.time, objectPointerVector))
+    if(ShadowRayIntersection(tmin, tmax, intersectionTestEpsilon, shadowRayEpsilon, report, true, ray.time, topLevelBVH))
     {
         return glm::vec3(0.0);
     }
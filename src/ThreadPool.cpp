@@ -0,0 +1,177 @@
+#include <ThreadPool.h>
+
+
+// Pool and deque of the worker running on this thread, if any
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), pendingCount(0)
+{
+
+}
+
+TaskGroup::~TaskGroup()
+{
+    drain();
+}
+
+void TaskGroup::drain()
+{
+    while(pendingCount.load() > 0)
+    {
+        if(!pool.RunPendingTask())
+            std::this_thread::yield();
+    }
+}
+
+void TaskGroup::Run(std::function<void()> task)
+{
+    pendingCount++;
+    pool.Submit([this, task]()
+    {
+        try
+        {
+            task();
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(errorLock);
+            if(!error)
+                error = std::current_exception();
+        }
+        // The group may be gone once this reaches zero
+        pendingCount--;
+    });
+}
+
+void TaskGroup::Wait()
+{
+    drain();
+
+    if(error)
+    {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+ThreadPool::ThreadPool(int threadCount) : queuedCount(0), nextWorker(0), stopping(false)
+{
+    if(threadCount <= 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i=0; i<threadCount; i++)
+        workers.push_back(new Worker());
+
+    for(int i=0; i<threadCount; i++)
+        threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for(std::thread& thread : threads)
+        thread.join();
+
+    for(Worker* worker : workers)
+        delete worker;
+}
+
+int ThreadPool::Size() const
+{
+    return workers.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    int index = currentPool == this ? currentWorker : nextWorker++ % workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->lock);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    queuedCount++;
+
+    // Taking the lock orders this with a worker checking queuedCount before
+    // it sleeps, the wake up cannot be missed
+    {
+        std::lock_guard<std::mutex> lock(sleepLock);
+    }
+    wakeUp.notify_one();
+}
+
+// The own deque is used from the back, newest first, others are stolen from
+// at the front where the oldest and usually largest tasks are
+bool ThreadPool::takeTask(int worker, std::function<void()>& task)
+{
+    int count = workers.size();
+
+    if(worker >= 0)
+    {
+        Worker* own = workers[worker];
+        std::lock_guard<std::mutex> lock(own->lock);
+        if(!own->tasks.empty())
+        {
+            task = std::move(own->tasks.back());
+            own->tasks.pop_back();
+            queuedCount--;
+            return true;
+        }
+    }
+
+    int first = worker >= 0 ? worker + 1 : nextWorker.load();
+    for(int i=0; i<count; i++)
+    {
+        Worker* victim = workers[(first + i) % count];
+        std::lock_guard<std::mutex> lock(victim->lock);
+        if(!victim->tasks.empty())
+        {
+            task = std::move(victim->tasks.front());
+            victim->tasks.pop_front();
+            queuedCount--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    if(queuedCount.load() == 0)
+        return false;
+
+    std::function<void()> task;
+    if(!takeTask(currentPool == this ? currentWorker : -1, task))
+        return false;
+
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int index)
+{
+    currentPool   = this;
+    currentWorker = index;
+
+    while(true)
+    {
+        std::function<void()> task;
+        if(takeTask(index, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepLock);
+        wakeUp.wait(lock, [&]() { return stopping || queuedCount.load() > 0; });
+        if(stopping && queuedCount.load() == 0)
+            return;
+    }
+}
@@ -0,0 +1,87 @@
+#include <TileScheduler.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+// Interleaves the low 16 bits of x and y
+static uint32_t mortonCode(uint32_t x, uint32_t y)
+{
+    uint32_t code = 0;
+    for(int bit=0; bit<16; bit++)
+    {
+        code |= ((x >> bit) & 1u) << (2 * bit);
+        code |= ((y >> bit) & 1u) << (2 * bit + 1);
+    }
+
+    return code;
+}
+
+TileScheduler::TileScheduler(int width, int height, int tileSize, TileOrder order) : nextTile(0), finishedPixels(0), pixelCount(width * height)
+{
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    for(int ty=0; ty<tilesY; ty++)
+    {
+        for(int tx=0; tx<tilesX; tx++)
+        {
+            Tile tile;
+            tile.startX = tx * tileSize;
+            tile.startY = ty * tileSize;
+            tile.endX   = std::min(tile.startX + tileSize, width);
+            tile.endY   = std::min(tile.startY + tileSize, height);
+            tiles.push_back(tile);
+        }
+    }
+
+    if(order == TileOrder::MORTON)
+    {
+        std::stable_sort(tiles.begin(), tiles.end(), [tileSize](const Tile& a, const Tile& b)
+        {
+            return mortonCode(a.startX / tileSize, a.startY / tileSize) < mortonCode(b.startX / tileSize, b.startY / tileSize);
+        });
+    }
+    else if(order == TileOrder::SPIRAL)
+    {
+        // Ring index first, the angle around the center orders each ring
+        float centerX = (tilesX - 1) * 0.5f;
+        float centerY = (tilesY - 1) * 0.5f;
+        auto key = [=](const Tile& tile)
+        {
+            float dx = tile.startX / tileSize - centerX;
+            float dy = tile.startY / tileSize - centerY;
+            return std::make_pair(std::max(std::fabs(dx), std::fabs(dy)), std::atan2(dy, dx));
+        };
+
+        std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile& a, const Tile& b)
+        {
+            return key(a) < key(b);
+        });
+    }
+}
+
+bool TileScheduler::Next(Tile& tile)
+{
+    int index = nextTile++;
+    if(index >= (int)tiles.size())
+        return false;
+
+    tile = tiles[index];
+    return true;
+}
+
+void TileScheduler::Finish(const Tile& tile)
+{
+    finishedPixels += tile.Width() * tile.Height();
+}
+
+float TileScheduler::Progress() const
+{
+    return pixelCount > 0 ? finishedPixels / (float)pixelCount : 1.0f;
+}
+
+bool TileScheduler::Done() const
+{
+    return finishedPixels == pixelCount;
+}
@@ -0,0 +1,214 @@
+#include <TopLevelBVH.h>
+#include <cmath>
+
+
+TopLevelBVH::TopLevelBVH(const std::vector<Object*>& objects, const BVHSettings& settings, float intersectionTestEpsilon) : objects(objects), settings(settings)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<AABB> primitiveBounds(objects.size());
+    std::vector<glm::vec3> centroids(objects.size());
+
+    for(size_t i=0; i<objects.size(); i++)
+    {
+        AABB box = objects[i]->WorldBounds();
+
+        // Triangle tests accept barycentrics slightly outside the triangle,
+        // grow the bounds so those hits are not culled
+        if(box.bounds[0].x <= box.bounds[1].x)
+        {
+            glm::vec3 margin = glm::vec3(std::max(intersectionTestEpsilon, 1e-5f) * glm::length(box.bounds[1] - box.bounds[0]));
+            box.bounds[0] -= margin;
+            box.bounds[1] += margin;
+        }
+
+        primitiveBounds[i] = box;
+        centroids[i] = (box.bounds[0] + box.bounds[1]) * 0.5f;
+    }
+
+    BVHNodeBuilder builder(primitiveBounds, centroids, settings, nodes, primitiveIndices);
+    builder.Build();
+
+    buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+BVHStats TopLevelBVH::Stats() const
+{
+    return ComputeBVHStats(nodes, objects.size(), primitiveIndices.size(), settings);
+}
+
+bool TopLevelBVH::Intersect(const Ray& ray, HitRecord& hit, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling)
+{
+    hit.t = FLT_MAX;
+    bool result = false;
+
+    if(nodes.empty())
+        return false;
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    float closest = tmax;
+    int hitObject = -1;
+    TraversalCounter counter(traversalCounters.closestHit);
+
+    while(stackSize > 0)
+    {
+        const BVHNode& node = nodes[stack[--stackSize]];
+        counter.nodes++;
+
+        if(!node.box.Intersect2(ray, tmin - intersectionTestEpsilon, closest + intersectionTestEpsilon))
+            continue;
+
+        if(node.primitiveCount > 0)
+        {
+            counter.primitives += node.primitiveCount;
+            for(int i=node.primitiveOffset; i<node.primitiveOffset + node.primitiveCount; i++)
+            {
+                // Objects are visited front to back, not in scene order. A hit
+                // at exactly the closest distance still goes to the object
+                // listed first, as it did when every object was tested in turn.
+                int object = primitiveIndices[i];
+                float limit = result ? std::nextafter(closest, FLT_MAX) : closest;
+
+                HitRecord candidate;
+                if(objects[object]->Intersect(ray, candidate, tmin, limit, intersectionTestEpsilon, backfaceCulling) &&
+                   (candidate.t < hit.t || (candidate.t == hit.t && object < hitObject)))
+                {
+                    result    = true;
+                    hit       = candidate;
+                    hitObject = object;
+                    closest   = std::min(closest, candidate.t);
+                }
+            }
+        }
+        else if(ray.sign[node.axis])
+        {
+            stack[stackSize++] = &node - nodes.data() + 1;
+            stack[stackSize++] = node.secondChildOffset;
+        }
+        else
+        {
+            stack[stackSize++] = node.secondChildOffset;
+            stack[stackSize++] = &node - nodes.data() + 1;
+        }
+    }
+
+    return result;
+}
+
+// Same scheme as BVH::IntersectPacket, leaves hand the rays that are still
+// active to Object::IntersectPacket
+void TopLevelBVH::IntersectPacket(RayPacket& packet, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling)
+{
+    for(int i=0; i<packet.count; i++)
+        packet.hits[i] = HitRecord();
+
+    packet.Finalize();
+    if(!packet.coherent)
+    {
+        for(int i=0; i<packet.count; i++)
+            Intersect(packet.rays[i], packet.hits[i], tmin, tmax, intersectionTestEpsilon, backfaceCulling);
+        return;
+    }
+
+    if(nodes.empty())
+        return;
+
+    int stack[BVH_STACK_SIZE];
+    int firstActive[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize] = 0;
+    firstActive[stackSize++] = 0;
+
+    float farthest = tmax;
+    TraversalCounter counter(traversalCounters.closestHit);
+
+    while(stackSize > 0)
+    {
+        stackSize--;
+        const BVHNode& node = nodes[stack[stackSize]];
+        int active = firstActive[stackSize];
+        counter.nodes++;
+
+        if(packet.Misses(node.box, tmin - intersectionTestEpsilon, farthest + intersectionTestEpsilon))
+            continue;
+
+        while(active < packet.count &&
+              !node.box.Intersect2(packet.rays[active], tmin - intersectionTestEpsilon, std::min(tmax, packet.hits[active].t) + intersectionTestEpsilon))
+            active++;
+        if(active == packet.count)
+            continue;
+
+        if(node.primitiveCount > 0)
+        {
+            counter.primitives += node.primitiveCount;
+            for(int i=node.primitiveOffset; i<node.primitiveOffset + node.primitiveCount; i++)
+                objects[primitiveIndices[i]]->IntersectPacket(packet, active, tmin, tmax, intersectionTestEpsilon, backfaceCulling);
+
+            farthest = 0.0f;
+            for(int i=0; i<packet.count; i++)
+                farthest = std::max(farthest, std::min(tmax, packet.hits[i].t));
+            continue;
+        }
+
+        int nodeIndex = &node - nodes.data();
+        if(packet.sign[node.axis])
+        {
+            stack[stackSize] = nodeIndex + 1;
+            firstActive[stackSize++] = active;
+            stack[stackSize] = node.secondChildOffset;
+            firstActive[stackSize++] = active;
+        }
+        else
+        {
+            stack[stackSize] = node.secondChildOffset;
+            firstActive[stackSize++] = active;
+            stack[stackSize] = nodeIndex + 1;
+            firstActive[stackSize++] = active;
+        }
+    }
+}
+
+bool TopLevelBVH::Occluded(const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, bool backfaceCulling,
+                           const Object* ignoreObject, bool ignoreLights)
+{
+    if(nodes.empty())
+        return false;
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    TraversalCounter counter(traversalCounters.shadow);
+
+    while(stackSize > 0)
+    {
+        const BVHNode& node = nodes[stack[--stackSize]];
+        counter.nodes++;
+
+        if(!node.box.Intersect2(ray, tmin - intersectionTestEpsilon, tmax + intersectionTestEpsilon))
+            continue;
+
+        if(node.primitiveCount > 0)
+        {
+            for(int i=node.primitiveOffset; i<node.primitiveOffset + node.primitiveCount; i++)
+            {
+                Object* object = objects[primitiveIndices[i]];
+                if(object == ignoreObject || (ignoreLights && object->IsLight()))
+                    continue;
+
+                counter.primitives++;
+                if(object->Occluded(ray, tmin, tmax, intersectionTestEpsilon, backfaceCulling))
+                    return true;
+            }
+        }
+        else
+        {
+            stack[stackSize++] = node.secondChildOffset;
+            stack[stackSize++] = &node - nodes.data() + 1;
+        }
+    }
+
+    return false;
+}
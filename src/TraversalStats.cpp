@@ -0,0 +1,4 @@
+#include <TraversalStats.h>
+
+
+thread_local TraversalCounters traversalCounters;
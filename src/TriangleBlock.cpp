@@ -0,0 +1,288 @@
+#include <TriangleBlock.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+
+static glm::vec3 laneVertex(const float (&vertex)[3][TRIANGLE_BLOCK_WIDTH], int lane)
+{
+    return glm::vec3(vertex[0][lane], vertex[1][lane], vertex[2][lane]);
+}
+
+TriangleBlock::TriangleBlock()
+{
+    // Unused lanes are degenerate, their determinant is zero and the
+    // barycentric test fails on the resulting NaNs
+    for(int axis=0; axis<3; axis++)
+    {
+        for(int lane=0; lane<TRIANGLE_BLOCK_WIDTH; lane++)
+        {
+            v0[axis][lane] = 0.0f;
+            v1[axis][lane] = 0.0f;
+            v2[axis][lane] = 0.0f;
+        }
+    }
+
+    for(int lane=0; lane<TRIANGLE_BLOCK_WIDTH; lane++)
+        face[lane] = -1;
+
+    laneMask = 0;
+}
+
+void TriangleBlock::SetLane(int lane, const MeshGeometry& geometry, int face)
+{
+    const glm::vec3& a = geometry.vertices[geometry.faces[face].a];
+    const glm::vec3& b = geometry.vertices[geometry.faces[face].b];
+    const glm::vec3& c = geometry.vertices[geometry.faces[face].c];
+
+    for(int axis=0; axis<3; axis++)
+    {
+        v0[axis][lane] = a[axis];
+        v1[axis][lane] = b[axis];
+        v2[axis][lane] = c[axis];
+    }
+
+    this->face[lane] = face;
+    laneMask |= 1 << lane;
+}
+
+int TriangleBlock::Intersect(const Ray& ray, float tmin, float tmax, float intersectionTestEpsilon, float* t, float* beta, float* gamma) const
+{
+#if defined(__AVX__)
+    __m256 dx = _mm256_set1_ps(ray.direction.x);
+    __m256 dy = _mm256_set1_ps(ray.direction.y);
+    __m256 dz = _mm256_set1_ps(ray.direction.z);
+
+    __m256 v0x = _mm256_load_ps(v0[0]), v0y = _mm256_load_ps(v0[1]), v0z = _mm256_load_ps(v0[2]);
+
+    __m256 e1x = _mm256_sub_ps(_mm256_load_ps(v1[0]), v0x), e1y = _mm256_sub_ps(_mm256_load_ps(v1[1]), v0y), e1z = _mm256_sub_ps(_mm256_load_ps(v1[2]), v0z);
+    __m256 e2x = _mm256_sub_ps(_mm256_load_ps(v2[0]), v0x), e2y = _mm256_sub_ps(_mm256_load_ps(v2[1]), v0y), e2z = _mm256_sub_ps(_mm256_load_ps(v2[2]), v0z);
+
+    // p = d x e2
+    __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+
+    __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+    __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    // s = o - v0
+    __m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), v0x);
+    __m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), v0y);
+    __m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), v0z);
+
+    __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), invDet);
+
+    // q = s x e1
+    __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+
+    __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+    __m256 dist = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+
+    __m256 lowerBound = _mm256_set1_ps(-intersectionTestEpsilon);
+    __m256 upperBound = _mm256_set1_ps(1 + intersectionTestEpsilon);
+
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(u, lowerBound, _CMP_GE_OQ), _mm256_cmp_ps(v, lowerBound, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), upperBound, _CMP_LE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(dist, _mm256_set1_ps(tmin), _CMP_GT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(dist, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+
+    _mm256_storeu_ps(t, dist);
+    _mm256_storeu_ps(beta, u);
+    _mm256_storeu_ps(gamma, v);
+
+    return _mm256_movemask_ps(hit) & laneMask;
+#elif defined(__SSE__)
+    __m128 dx = _mm_set1_ps(ray.direction.x);
+    __m128 dy = _mm_set1_ps(ray.direction.y);
+    __m128 dz = _mm_set1_ps(ray.direction.z);
+
+    __m128 v0x = _mm_load_ps(v0[0]), v0y = _mm_load_ps(v0[1]), v0z = _mm_load_ps(v0[2]);
+
+    __m128 e1x = _mm_sub_ps(_mm_load_ps(v1[0]), v0x), e1y = _mm_sub_ps(_mm_load_ps(v1[1]), v0y), e1z = _mm_sub_ps(_mm_load_ps(v1[2]), v0z);
+    __m128 e2x = _mm_sub_ps(_mm_load_ps(v2[0]), v0x), e2y = _mm_sub_ps(_mm_load_ps(v2[1]), v0y), e2z = _mm_sub_ps(_mm_load_ps(v2[2]), v0z);
+
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    // s = o - v0
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), v0x);
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), v0y);
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), v0z);
+
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    __m128 dist = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+    __m128 lowerBound = _mm_set1_ps(-intersectionTestEpsilon);
+    __m128 upperBound = _mm_set1_ps(1 + intersectionTestEpsilon);
+
+    __m128 hit = _mm_and_ps(_mm_cmpge_ps(u, lowerBound), _mm_cmpge_ps(v, lowerBound));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), upperBound));
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(dist, _mm_set1_ps(tmin)));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(dist, _mm_set1_ps(tmax)));
+
+    _mm_storeu_ps(t, dist);
+    _mm_storeu_ps(beta, u);
+    _mm_storeu_ps(gamma, v);
+
+    return _mm_movemask_ps(hit) & laneMask;
+#else
+    int mask = 0;
+    for(int lane=0; lane<TRIANGLE_BLOCK_WIDTH; lane++)
+    {
+        glm::vec3 a = laneVertex(v0, lane);
+        glm::vec3 edge1 = laneVertex(v1, lane) - a;
+        glm::vec3 edge2 = laneVertex(v2, lane) - a;
+
+        glm::vec3 p = glm::cross(ray.direction, edge2);
+        float invDet = 1.0f / glm::dot(edge1, p);
+
+        glm::vec3 s = ray.origin - a;
+        glm::vec3 q = glm::cross(s, edge1);
+
+        beta[lane]  = glm::dot(s, p) * invDet;
+        gamma[lane] = glm::dot(ray.direction, q) * invDet;
+        t[lane]     = glm::dot(edge2, q) * invDet;
+
+        if(beta[lane] >= -intersectionTestEpsilon && gamma[lane] >= -intersectionTestEpsilon &&
+           beta[lane] + gamma[lane] <= 1 + intersectionTestEpsilon && t[lane] > tmin && t[lane] < tmax)
+            mask |= 1 << lane;
+    }
+
+    return mask & laneMask;
+#endif
+}
+
+// Lanes where an edge function comes out as exactly zero are redone with the
+// scalar test, which repeats the same float operations and falls back to
+// double precision
+int TriangleBlock::IntersectWatertight(const WatertightRay& ray, float tmin, float tmax, float* t, float* beta, float* gamma) const
+{
+#if defined(__AVX__)
+    int kx = ray.kx, ky = ray.ky, kz = ray.kz;
+
+    __m256 ox = _mm256_set1_ps(ray.origin[kx]);
+    __m256 oy = _mm256_set1_ps(ray.origin[ky]);
+    __m256 oz = _mm256_set1_ps(ray.origin[kz]);
+    __m256 shearX = _mm256_set1_ps(ray.shearX);
+    __m256 shearY = _mm256_set1_ps(ray.shearY);
+
+    // Vertices relative to the origin, sheared so the ray runs along +z
+    __m256 az = _mm256_sub_ps(_mm256_load_ps(v0[kz]), oz);
+    __m256 bz = _mm256_sub_ps(_mm256_load_ps(v1[kz]), oz);
+    __m256 cz = _mm256_sub_ps(_mm256_load_ps(v2[kz]), oz);
+
+    __m256 ax = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(v0[kx]), ox), _mm256_mul_ps(shearX, az));
+    __m256 ay = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(v0[ky]), oy), _mm256_mul_ps(shearY, az));
+    __m256 bx = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(v1[kx]), ox), _mm256_mul_ps(shearX, bz));
+    __m256 by = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(v1[ky]), oy), _mm256_mul_ps(shearY, bz));
+    __m256 cx = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(v2[kx]), ox), _mm256_mul_ps(shearX, cz));
+    __m256 cy = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(v2[ky]), oy), _mm256_mul_ps(shearY, cz));
+
+    __m256 u = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+    __m256 v = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+    __m256 w = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 onEdge = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_EQ_OQ), _mm256_cmp_ps(v, zero, _CMP_EQ_OQ)), _mm256_cmp_ps(w, zero, _CMP_EQ_OQ));
+
+    __m256 negative = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(v, zero, _CMP_LT_OQ)), _mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+    __m256 positive = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, zero, _CMP_GT_OQ)), _mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+
+    __m256 det = _mm256_add_ps(_mm256_add_ps(u, v), w);
+    __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    __m256 scaledT = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u, az), _mm256_mul_ps(v, bz)), _mm256_mul_ps(w, cz));
+    __m256 dist = _mm256_mul_ps(_mm256_mul_ps(scaledT, _mm256_set1_ps(ray.shearZ)), invDet);
+
+    __m256 hit = _mm256_andnot_ps(_mm256_and_ps(negative, positive), _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(dist, _mm256_set1_ps(tmin), _CMP_GT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(dist, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+
+    _mm256_storeu_ps(t, dist);
+    _mm256_storeu_ps(beta, _mm256_mul_ps(v, invDet));
+    _mm256_storeu_ps(gamma, _mm256_mul_ps(w, invDet));
+
+    int mask = _mm256_movemask_ps(hit) & laneMask;
+    int edgeMask = _mm256_movemask_ps(onEdge) & laneMask;
+#elif defined(__SSE__)
+    int kx = ray.kx, ky = ray.ky, kz = ray.kz;
+
+    __m128 ox = _mm_set1_ps(ray.origin[kx]);
+    __m128 oy = _mm_set1_ps(ray.origin[ky]);
+    __m128 oz = _mm_set1_ps(ray.origin[kz]);
+    __m128 shearX = _mm_set1_ps(ray.shearX);
+    __m128 shearY = _mm_set1_ps(ray.shearY);
+
+    // Vertices relative to the origin, sheared so the ray runs along +z
+    __m128 az = _mm_sub_ps(_mm_load_ps(v0[kz]), oz);
+    __m128 bz = _mm_sub_ps(_mm_load_ps(v1[kz]), oz);
+    __m128 cz = _mm_sub_ps(_mm_load_ps(v2[kz]), oz);
+
+    __m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(v0[kx]), ox), _mm_mul_ps(shearX, az));
+    __m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(v0[ky]), oy), _mm_mul_ps(shearY, az));
+    __m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(v1[kx]), ox), _mm_mul_ps(shearX, bz));
+    __m128 by = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(v1[ky]), oy), _mm_mul_ps(shearY, bz));
+    __m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(v2[kx]), ox), _mm_mul_ps(shearX, cz));
+    __m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(v2[ky]), oy), _mm_mul_ps(shearY, cz));
+
+    __m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+    __m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 onEdge = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(u, zero), _mm_cmpeq_ps(v, zero)), _mm_cmpeq_ps(w, zero));
+
+    __m128 negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+    __m128 positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(u, v), w);
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    __m128 scaledT = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, az), _mm_mul_ps(v, bz)), _mm_mul_ps(w, cz));
+    __m128 dist = _mm_mul_ps(_mm_mul_ps(scaledT, _mm_set1_ps(ray.shearZ)), invDet);
+
+    __m128 hit = _mm_andnot_ps(_mm_and_ps(negative, positive), _mm_cmpneq_ps(det, zero));
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(dist, _mm_set1_ps(tmin)));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(dist, _mm_set1_ps(tmax)));
+
+    _mm_storeu_ps(t, dist);
+    _mm_storeu_ps(beta, _mm_mul_ps(v, invDet));
+    _mm_storeu_ps(gamma, _mm_mul_ps(w, invDet));
+
+    int mask = _mm_movemask_ps(hit) & laneMask;
+    int edgeMask = _mm_movemask_ps(onEdge) & laneMask;
+#else
+    int mask = 0;
+    int edgeMask = laneMask;
+#endif
+
+    for(int lane=0; edgeMask; lane++, edgeMask >>= 1)
+    {
+        if(!(edgeMask & 1))
+            continue;
+
+        mask &= ~(1 << lane);
+        if(IntersectTriangleWatertight(ray, laneVertex(v0, lane), laneVertex(v1, lane), laneVertex(v2, lane), tmin, tmax, t[lane], beta[lane], gamma[lane]))
+            mask |= 1 << lane;
+    }
+
+    return mask;
+}
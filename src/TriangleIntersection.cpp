@@ -0,0 +1,87 @@
+#include <TriangleIntersection.h>
+#include <utility>
+
+
+WatertightRay::WatertightRay(const Ray& ray) : origin(ray.origin)
+{
+    glm::vec3 absDirection = glm::abs(ray.direction);
+
+    kz = 0;
+    if(absDirection.y > absDirection[kz])
+        kz = 1;
+    if(absDirection.z > absDirection[kz])
+        kz = 2;
+
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+
+    // Keeps the winding, so front faces give positive edge functions
+    if(ray.direction[kz] < 0.0f)
+        std::swap(kx, ky);
+
+    shearX = ray.direction[kx] / ray.direction[kz];
+    shearY = ray.direction[ky] / ray.direction[kz];
+    shearZ = 1.0f / ray.direction[kz];
+}
+
+bool IntersectTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& edge1, const glm::vec3& edge2,
+                       float tmin, float tmax, float intersectionTestEpsilon, float& t, float& beta, float& gamma)
+{
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float invDet = 1.0f / glm::dot(edge1, p);
+
+    glm::vec3 s = ray.origin - a;
+    beta = glm::dot(s, p) * invDet;
+    if(beta < -intersectionTestEpsilon || beta > 1 + intersectionTestEpsilon)
+        return false;
+
+    glm::vec3 q = glm::cross(s, edge1);
+    gamma = glm::dot(ray.direction, q) * invDet;
+    if(gamma < -intersectionTestEpsilon || beta + gamma > 1 + intersectionTestEpsilon)
+        return false;
+
+    t = glm::dot(edge2, q) * invDet;
+    return t > tmin && t < tmax;
+}
+
+bool IntersectTriangleWatertight(const WatertightRay& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                                 float tmin, float tmax, float& t, float& beta, float& gamma)
+{
+    glm::vec3 A = a - ray.origin;
+    glm::vec3 B = b - ray.origin;
+    glm::vec3 C = c - ray.origin;
+
+    float ax = A[ray.kx] - ray.shearX * A[ray.kz];
+    float ay = A[ray.ky] - ray.shearY * A[ray.kz];
+    float bx = B[ray.kx] - ray.shearX * B[ray.kz];
+    float by = B[ray.ky] - ray.shearY * B[ray.kz];
+    float cx = C[ray.kx] - ray.shearX * C[ray.kz];
+    float cy = C[ray.ky] - ray.shearY * C[ray.kz];
+
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+
+    if(u == 0.0f || v == 0.0f || w == 0.0f)
+    {
+        u = (float)((double)cx * by - (double)cy * bx);
+        v = (float)((double)ax * cy - (double)ay * cx);
+        w = (float)((double)bx * ay - (double)by * ax);
+    }
+
+    if((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+        return false;
+
+    float det = u + v + w;
+    if(det == 0.0f)
+        return false;
+
+    float invDet = 1.0f / det;
+    t = (u * A[ray.kz] + v * B[ray.kz] + w * C[ray.kz]) * ray.shearZ * invDet;
+    if(!(t > tmin && t < tmax))
+        return false;
+
+    beta  = v * invDet;
+    gamma = w * invDet;
+    return true;
+}
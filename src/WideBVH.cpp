@@ -0,0 +1,224 @@
+#include <WideBVH.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+
+template<int N>
+WideBVH<N>::WideBVH()
+{
+
+}
+
+template<int N>
+WideBVH<N>::WideBVH(const std::vector<BVHNode>& binaryNodes)
+{
+    if(!binaryNodes.empty())
+        collapse(binaryNodes, 0);
+}
+
+// Pulls the binary subtree below binaryIndex into one wide node by repeatedly
+// opening the interior child with the largest surface area until N children
+// are gathered, then collapses the interior children recursively.
+template<int N>
+int WideBVH<N>::collapse(const std::vector<BVHNode>& binaryNodes, int binaryIndex)
+{
+    int children[N];
+    int childCount = 0;
+
+    const BVHNode& node = binaryNodes[binaryIndex];
+    if(node.primitiveCount > 0)
+    {
+        // Only happens for a root that is a leaf
+        children[childCount++] = binaryIndex;
+    }
+    else
+    {
+        children[childCount++] = binaryIndex + 1;
+        children[childCount++] = node.secondChildOffset;
+    }
+
+    while(childCount < N)
+    {
+        int best = -1;
+        float bestArea = -1.0f;
+        for(int i=0; i<childCount; i++)
+        {
+            const BVHNode& child = binaryNodes[children[i]];
+            if(child.primitiveCount == 0 && child.box.SurfaceArea() > bestArea)
+            {
+                best = i;
+                bestArea = child.box.SurfaceArea();
+            }
+        }
+
+        if(best < 0)
+            break;
+
+        int opened = children[best];
+        children[best] = opened + 1;
+        children[childCount++] = binaryNodes[opened].secondChildOffset;
+    }
+
+    int nodeIndex = nodes.size();
+    nodes.push_back(WideBVHNode<N>());
+
+    // Recursion grows the node array, so fill a local copy first
+    WideBVHNode<N> wideNode;
+    wideNode.childCount = childCount;
+
+    for(int i=0; i<N; i++)
+    {
+        if(i < childCount)
+        {
+            const BVHNode& child = binaryNodes[children[i]];
+            for(int axis=0; axis<3; axis++)
+            {
+                wideNode.bounds[0][axis][i] = child.box.bounds[0][axis];
+                wideNode.bounds[1][axis][i] = child.box.bounds[1][axis];
+            }
+
+            if(child.primitiveCount > 0)
+            {
+                wideNode.child[i] = child.primitiveOffset;
+                wideNode.count[i] = child.primitiveCount;
+            }
+            else
+            {
+                wideNode.child[i] = collapse(binaryNodes, children[i]);
+                wideNode.count[i] = 0;
+            }
+        }
+        else
+        {
+            // Inverted box, never hit by the slab test
+            for(int axis=0; axis<3; axis++)
+            {
+                wideNode.bounds[0][axis][i] =  FLT_MAX;
+                wideNode.bounds[1][axis][i] = -FLT_MAX;
+            }
+            wideNode.child[i] = -1;
+            wideNode.count[i] = 0;
+        }
+    }
+
+    nodes[nodeIndex] = wideNode;
+    return nodeIndex;
+}
+
+// Same acceptance rule as AABB::Intersect2. The operand order of min/max
+// drops NaNs produced by rays lying in a slab plane.
+template<int N>
+int WideBVH<N>::IntersectChildren(const WideBVHNode<N>& node, const Ray& ray, float t0, float t1, float* distances)
+{
+#if defined(__AVX__)
+    if constexpr (N == 8)
+    {
+        __m256 tNear = _mm256_set1_ps(-FLT_MAX);
+        __m256 tFar  = _mm256_set1_ps( FLT_MAX);
+
+        for(int axis=0; axis<3; axis++)
+        {
+            __m256 origin       = _mm256_set1_ps(ray.origin[axis]);
+            __m256 invDirection = _mm256_set1_ps(ray.invDirection[axis]);
+            __m256 nearPlane    = _mm256_load_ps(node.bounds[ray.sign[axis]][axis]);
+            __m256 farPlane     = _mm256_load_ps(node.bounds[1 - ray.sign[axis]][axis]);
+
+            tNear = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(nearPlane, origin), invDirection), tNear);
+            tFar  = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(farPlane, origin), invDirection), tFar);
+        }
+
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ),
+                     _mm256_and_ps(_mm256_cmp_ps(tNear, _mm256_set1_ps(t1), _CMP_LT_OQ),
+                                   _mm256_cmp_ps(tFar, _mm256_set1_ps(t0), _CMP_GT_OQ)));
+
+        _mm256_storeu_ps(distances, tNear);
+        return _mm256_movemask_ps(hit);
+    }
+#endif
+
+    int mask = 0;
+
+#if defined(__SSE__)
+    for(int base=0; base<N; base+=4)
+    {
+        __m128 tNear = _mm_set1_ps(-FLT_MAX);
+        __m128 tFar  = _mm_set1_ps( FLT_MAX);
+
+        for(int axis=0; axis<3; axis++)
+        {
+            __m128 origin       = _mm_set1_ps(ray.origin[axis]);
+            __m128 invDirection = _mm_set1_ps(ray.invDirection[axis]);
+            __m128 nearPlane    = _mm_load_ps(node.bounds[ray.sign[axis]][axis] + base);
+            __m128 farPlane     = _mm_load_ps(node.bounds[1 - ray.sign[axis]][axis] + base);
+
+            tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(nearPlane, origin), invDirection), tNear);
+            tFar  = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(farPlane, origin), invDirection), tFar);
+        }
+
+        __m128 hit = _mm_and_ps(_mm_cmple_ps(tNear, tFar),
+                     _mm_and_ps(_mm_cmplt_ps(tNear, _mm_set1_ps(t1)),
+                                _mm_cmpgt_ps(tFar, _mm_set1_ps(t0))));
+
+        _mm_storeu_ps(distances + base, tNear);
+        mask |= _mm_movemask_ps(hit) << base;
+    }
+#else
+    for(int i=0; i<N; i++)
+    {
+        float tNear = -FLT_MAX;
+        float tFar  =  FLT_MAX;
+
+        for(int axis=0; axis<3; axis++)
+        {
+            float nearT = (node.bounds[ray.sign[axis]][axis][i] - ray.origin[axis]) * ray.invDirection[axis];
+            float farT  = (node.bounds[1 - ray.sign[axis]][axis][i] - ray.origin[axis]) * ray.invDirection[axis];
+
+            tNear = nearT > tNear ? nearT : tNear;
+            tFar  = farT  < tFar  ? farT  : tFar;
+        }
+
+        distances[i] = tNear;
+        if(tNear <= tFar && tNear < t1 && tFar > t0)
+            mask |= 1 << i;
+    }
+#endif
+
+    return mask;
+}
+
+template<int N>
+int WideBVH<N>::SortedHits(const WideBVHNode<N>& node, const Ray& ray, float t0, float t1, WideBVHStackEntry* hits)
+{
+    alignas(32) float distances[N];
+    int mask = IntersectChildren(node, ray, t0, t1, distances);
+
+    int hitCount = 0;
+    for(int i=0; i<N; i++)
+    {
+        if(!(mask & (1 << i)))
+            continue;
+
+        WideBVHStackEntry entry;
+        entry.index    = node.child[i];
+        entry.count    = node.count[i];
+        entry.distance = distances[i];
+
+        // Insertion sort, there are at most N entries
+        int j = hitCount++;
+        while(j > 0 && hits[j - 1].distance > entry.distance)
+        {
+            hits[j] = hits[j - 1];
+            j--;
+        }
+        hits[j] = entry;
+    }
+
+    return hitCount;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -1,12 +1,102 @@
 #include <iostream>
+#include <cstring>
 #include <Renderer.h>
+#include <IntersectionBenchmark.h>
 
 int main(int argc, char** argv)
 {
+    if(argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scene.xml> [--bvh-width 2|4|8] [--bvh-cache] [--bvh-cache-dir dir] [--bvh-stats] [--bvh-stats-json file] [--heatmap] [--heatmap-shadow-rays] [--watertight] [--bake-transforms] [--packets] [--wavefront] [--tile-size n] [--tile-order scanline|morton|spiral] [--threads n] [--seed n] [--sampler random|halton|sobol|bluenoise]" << '\n';
+        std::cerr << "       " << argv[0] << " --intersection-benchmark" << '\n';
+        return 1;
+    }
+
+    if(std::strcmp(argv[1], "--intersection-benchmark") == 0)
+    {
+        RunIntersectionBenchmark(std::cout);
+        return 0;
+    }
 
     std::string path = std::string(argv[1]);
 
-    Renderer RnDr(path);
+    RenderOptions options;
+    for(int i=2; i<argc; i++)
+    {
+        if(std::strcmp(argv[i], "--bvh-width") == 0 && i + 1 < argc)
+        {
+            options.bvhWidth = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--bvh-cache") == 0)
+        {
+            options.bvhCache = true;
+        }
+        else if(std::strcmp(argv[i], "--bvh-cache-dir") == 0 && i + 1 < argc)
+        {
+            options.bvhCache    = true;
+            options.bvhCacheDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--bvh-stats") == 0)
+        {
+            options.bvhStats = true;
+        }
+        else if(std::strcmp(argv[i], "--bvh-stats-json") == 0 && i + 1 < argc)
+        {
+            options.bvhStatsPath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--heatmap") == 0)
+        {
+            options.heatmap = true;
+        }
+        else if(std::strcmp(argv[i], "--heatmap-shadow-rays") == 0)
+        {
+            options.heatmap = true;
+            options.heatmapShadowRays = true;
+        }
+        else if(std::strcmp(argv[i], "--watertight") == 0)
+        {
+            options.watertight = true;
+        }
+        else if(std::strcmp(argv[i], "--bake-transforms") == 0)
+        {
+            options.bakeTransforms = true;
+        }
+        else if(std::strcmp(argv[i], "--packets") == 0)
+        {
+            options.packets = true;
+        }
+        else if(std::strcmp(argv[i], "--wavefront") == 0)
+        {
+            options.wavefront = true;
+        }
+        else if(std::strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc)
+        {
+            options.tileSize = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--tile-order") == 0 && i + 1 < argc)
+        {
+            options.tileOrder = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            options.threads = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if(std::strcmp(argv[i], "--sampler") == 0 && i + 1 < argc)
+        {
+            options.sampler = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown option " << argv[i] << '\n';
+            return 1;
+        }
+    }
+
+    Renderer RnDr(path, options);
 
     try
     {    